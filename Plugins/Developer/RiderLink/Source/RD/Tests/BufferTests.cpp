@@ -0,0 +1,149 @@
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "HAL/PlatformTime.h"
+
+#include "protocol/Buffer.h"
+#include "protocol/ByteArrayPool.h"
+
+#include <memory>
+#include <string>
+
+namespace BufferTestsImpl
+{
+static void WriteSmallMessage(rd::Buffer& Buffer, const int32_t Index)
+{
+	Buffer.write_integral<int64_t>(Index);
+	Buffer.write_integral<int32_t>(Index * 3);
+	Buffer.write_bool((Index & 1) != 0);
+	Buffer.write_wstring(std::wstring(L"Entity"));
+}
+
+// Runs [Body] [Iterations] times, returns nanoseconds per iteration.
+template <typename F>
+static double Measure(const int32 Iterations, F&& Body)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		Body(Iteration);
+	}
+	return (FPlatformTime::Seconds() - StartTime) * 1e9 / Iterations;
+}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdBufferArrayTest, "RiderLink.RD.Buffer.ArrayHoldsWrittenBytes",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FRdBufferArrayTest::RunTest(const FString& Parameters)
+{
+	// Inline, spilled to the heap and pooled storage all grow past what is written.
+	for (const size_t Size : {size_t{10}, size_t{1000}})
+	{
+		for (const bool bPooled : {false, true})
+		{
+			rd::Buffer Buffer = bPooled ? rd::Buffer::pooled() : rd::Buffer();
+			for (size_t Index = 0; Index < Size; ++Index)
+			{
+				Buffer.write_integral<uint8_t>(static_cast<uint8_t>(Index));
+			}
+			const FString Name = FString::Printf(TEXT("%d %s bytes"), static_cast<int32>(Size), bPooled ? TEXT("pooled") : TEXT("owned"));
+
+			// Rewound like a buffer handed over for reading, the array still holds everything written.
+			Buffer.rewind();
+			const rd::Buffer::ByteArray Array = Buffer.getArray();
+			TestTrue(FString::Printf(TEXT("%s: array is the bytes written"), *Name), Array.size() == Size);
+			bool bIntact = Array.size() == Size;
+			for (size_t Index = 0; bIntact && Index < Size; ++Index)
+			{
+				bIntact = Array[Index] == static_cast<uint8_t>(Index);
+			}
+			TestTrue(FString::Printf(TEXT("%s: array is intact"), *Name), bIntact);
+			TestTrue(FString::Printf(TEXT("%s: moved out array is the bytes written"), *Name), std::move(Buffer).getArray() == Array);
+		}
+	}
+
+	// An overwrite behind the end doesn't shorten it.
+	rd::Buffer Buffer;
+	Buffer.write_integral<int64_t>(1);
+	Buffer.rewind();
+	Buffer.write_integral<int32_t>(2);
+	TestTrue(TEXT("Array reaches the furthest write"), Buffer.getArray().size() == sizeof(int64_t));
+	TestTrue(TEXT("Real array stops at the position"), Buffer.getRealArray().size() == sizeof(int32_t));
+
+	const rd::Buffer::ByteArray Given{1, 2, 3};
+	TestTrue(TEXT("Array of a buffer read from is what it was given"), rd::Buffer(Given).getArray() == Given);
+	TestTrue(TEXT("Fresh buffer has an empty array"), rd::Buffer().getArray().empty());
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdBufferBenchmarkTest, "RiderLink.RD.Buffer.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FRdBufferBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace BufferTestsImpl;
+
+	constexpr int32 Iterations = 200000;
+	int64_t Checksum = 0;
+
+	// Short messages stay inline, no allocation.
+	const double SmallOwned = Measure(Iterations, [&](const int32 Index) {
+		rd::Buffer Buffer;
+		WriteSmallMessage(Buffer, Index);
+		Checksum += static_cast<int64_t>(Buffer.get_position());
+	});
+
+	// The way wires queue them, storage recycled through the pool.
+	const double SmallPooled = Measure(Iterations, [&](const int32 Index) {
+		rd::Buffer Buffer = rd::Buffer::pooled();
+		WriteSmallMessage(Buffer, Index);
+		rd::ByteArrayPool::release(std::move(Buffer).getRealArray());
+	});
+
+	// Growing past the inline area by doubling, grown bytes aren't zero filled.
+	constexpr int32 LargeSize = 64 * 1024;
+	const double LargeOwned = Measure(Iterations / 100, [&](const int32 Index) {
+		rd::Buffer Buffer;
+		for (int32 Offset = 0; Offset < LargeSize; Offset += sizeof(int64_t))
+		{
+			Buffer.write_integral<int64_t>(Offset);
+		}
+		Checksum += static_cast<int64_t>(Buffer.get_position());
+	});
+
+	const double LargePooled = Measure(Iterations / 100, [&](const int32 Index) {
+		rd::Buffer Buffer = rd::Buffer::pooled();
+		for (int32 Offset = 0; Offset < LargeSize; Offset += sizeof(int64_t))
+		{
+			Buffer.write_integral<int64_t>(Offset);
+		}
+		rd::ByteArrayPool::release(std::move(Buffer).getRealArray());
+	});
+
+	// Reading a received package through a view shares it, through an owned buffer copies it.
+	rd::Buffer Written;
+	for (int32 Index = 0; Index < 16; ++Index)
+	{
+		WriteSmallMessage(Written, Index);
+	}
+	const auto Slab = std::make_shared<const rd::Buffer::ByteArray>(Written.getRealArray());
+	const double ReadView = Measure(Iterations, [&](const int32 Index) {
+		rd::Buffer Buffer = rd::Buffer::view(Slab, 0, Slab->size());
+		Checksum += Buffer.read_integral<int64_t>();
+	});
+	const double ReadCopy = Measure(Iterations, [&](const int32 Index) {
+		rd::Buffer Buffer(*Slab);
+		Checksum += Buffer.read_integral<int64_t>();
+	});
+
+	TestTrue(TEXT("Benchmarks ran"), Checksum != 0);
+
+	AddInfo(FString::Printf(TEXT("Small message: owned %.0f ns, pooled %.0f ns"), SmallOwned, SmallPooled));
+	AddInfo(FString::Printf(TEXT("%d KB message: owned %.0f ns, pooled %.0f ns"), LargeSize / 1024, LargeOwned, LargePooled));
+	AddInfo(FString::Printf(TEXT("%d byte package read: view %.0f ns, copy %.0f ns"), static_cast<int32>(Slab->size()), ReadView, ReadCopy));
+	return true;
+}
+
+#endif
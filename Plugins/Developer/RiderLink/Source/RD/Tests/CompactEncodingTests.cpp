@@ -0,0 +1,258 @@
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "HAL/PlatformTime.h"
+
+#include "base/IUnknownInstance.h"
+#include "protocol/Buffer.h"
+#include "scheduler/SynchronousScheduler.h"
+#include "serialization/ISerializable.h"
+#include "serialization/SerializationCtx.h"
+#include "serialization/Serializers.h"
+#include "wire/QueuedWireBase.h"
+
+#include <string>
+#include <vector>
+
+namespace CompactEncodingTestsImpl
+{
+// A polymorphic type this side knows, its field is packed.
+class FKnownMessage : public rd::IPolymorphicSerializable
+{
+public:
+	int32_t Value = 0;
+
+	explicit FKnownMessage(const int32_t Value) : Value(Value)
+	{
+	}
+
+	virtual void write(rd::SerializationCtx& ctx, rd::Buffer& buffer) const override
+	{
+		buffer.write_packed<int32_t>(Value);
+	}
+
+	virtual std::string type_name() const override
+	{
+		return "FKnownMessage";
+	}
+
+	virtual std::string toString() const override
+	{
+		return type_name();
+	}
+
+	virtual bool equals(rd::ISerializable const& object) const override
+	{
+		return this == &object;
+	}
+};
+
+// Like the generated _Unknown types: an instance of a type this side doesn't know, written back as the bytes it was read with.
+class FUnknownMessage : public rd::IPolymorphicSerializable, public rd::IUnknownInstance
+{
+public:
+	rd::Buffer::ByteArray UnknownBytes;
+
+	FUnknownMessage(const rd::RdId& UnknownId, rd::Buffer::ByteArray UnknownBytes)
+		: IUnknownInstance(UnknownId), UnknownBytes(std::move(UnknownBytes))
+	{
+	}
+
+	virtual void write(rd::SerializationCtx& ctx, rd::Buffer& buffer) const override
+	{
+		buffer.write_byte_array_raw(UnknownBytes);
+	}
+
+	virtual std::string type_name() const override
+	{
+		return "FUnknownMessage";
+	}
+
+	virtual std::string toString() const override
+	{
+		return type_name();
+	}
+
+	virtual bool equals(rd::ISerializable const& object) const override
+	{
+		return this == &object;
+	}
+};
+
+// Exposes how packages are queued, never sends them.
+class FQueueingWire final : public rd::QueuedWireBase
+{
+public:
+	using QueuedWireBase::PACKED_LAYOUT_FLAG;
+	using QueuedWireBase::write_message;
+
+	explicit FQueueingWire(const bool bCompact) : QueuedWireBase("CompactEncodingTests", &rd::SynchronousScheduler::Instance())
+	{
+		compact_encoding_enabled = bCompact;
+	}
+
+	virtual bool send0(rd::ByteBufferAsyncProcessor::package_iterator first, rd::ByteBufferAsyncProcessor::package_iterator last,
+		rd::sequence_number_t first_seqn) const override
+	{
+		return true;
+	}
+};
+
+static int32_t PackageLength(const rd::Buffer::ByteArray& Package)
+{
+	return rd::Buffer(Package).read_integral<int32_t>();
+}
+
+// Roughly what model updates look like: an entity path, small counts and ids, a fixed width timestamp.
+static void WriteMessage(rd::Buffer& Buffer, const int32_t Index)
+{
+	Buffer.write_wstring(std::wstring(L"MassTest.Streaming.Cell"));
+	Buffer.write_packed<int32_t>(Index % 100);
+	Buffer.write_packed<int32_t>(-(Index % 7));
+	Buffer.write_packed<int64_t>(Index);
+	Buffer.write_integral<int64_t>(1700000000000LL + Index);
+	Buffer.write_packed<int32_t>(3);
+	for (int32_t Element = 0; Element < 3; ++Element)
+	{
+		Buffer.write_packed<int32_t>(Index + Element);
+	}
+}
+
+static int64_t ReadMessage(rd::Buffer& Buffer)
+{
+	int64_t Sum = static_cast<int64_t>(Buffer.read_wstring().size());
+	Sum += Buffer.read_packed<int32_t>();
+	Sum += Buffer.read_packed<int32_t>();
+	Sum += Buffer.read_packed<int64_t>();
+	Sum += Buffer.read_integral<int64_t>();
+	const int32_t Count = Buffer.read_packed<int32_t>();
+	for (int32_t Element = 0; Element < Count; ++Element)
+	{
+		Sum += Buffer.read_packed<int32_t>();
+	}
+	return Sum;
+}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdCompactEncodingUnknownInstanceTest, "RiderLink.RD.CompactEncoding.UnknownInstanceGoesOutPlain",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FRdCompactEncodingUnknownInstanceTest::RunTest(const FString& Parameters)
+{
+	using namespace CompactEncodingTestsImpl;
+
+	rd::Serializers Serializers;
+	rd::SerializationCtx Context(&Serializers);
+
+	const FKnownMessage Known(300);
+	// Packed as a compact counterpart would have, which this side can't tell from the bytes.
+	const FUnknownMessage Unknown(rd::RdId(77), rd::Buffer::ByteArray{0xAC, 0x02});
+
+	rd::Buffer Buffer;
+	rd::Buffer::packed_layout Layout;
+	Buffer.set_packed_layout(&Layout);
+	Serializers.writePolymorphicNullable<rd::IPolymorphicSerializable>(Context, Buffer, Known);
+	TestTrue(TEXT("Known instance keeps the layout usable"), !Layout.opaque);
+	Serializers.writePolymorphicNullable<rd::IPolymorphicSerializable>(Context, Buffer, Unknown);
+	TestTrue(TEXT("Unknown instance makes the layout opaque"), Layout.opaque);
+	Buffer.set_packed_layout(nullptr);
+
+	rd::Buffer::packed_layout Replayed;
+	Replayed.append(Layout, 16);
+	TestTrue(TEXT("Appended layout stays opaque"), Replayed.opaque);
+	Replayed.clear();
+	TestTrue(TEXT("Cleared layout isn't opaque"), !Replayed.opaque);
+
+	const FQueueingWire Wire(true);
+	const auto WriteKnown = [&](rd::Buffer& Message) {
+		Serializers.writePolymorphicNullable<rd::IPolymorphicSerializable>(Context, Message, Known);
+	};
+	const auto WriteUnknown = [&](rd::Buffer& Message) {
+		Serializers.writePolymorphicNullable<rd::IPolymorphicSerializable>(Context, Message, Unknown);
+	};
+	TestTrue(TEXT("Known instance is queued with its layout"),
+		(PackageLength(Wire.write_message(rd::RdId(1), WriteKnown)) & FQueueingWire::PACKED_LAYOUT_FLAG) != 0);
+
+	const rd::Buffer::ByteArray Package = Wire.write_message(rd::RdId(1), WriteUnknown);
+	TestTrue(TEXT("Unknown instance is queued plain"), (PackageLength(Package) & FQueueingWire::PACKED_LAYOUT_FLAG) == 0);
+	TestEqual(TEXT("Plain package holds the message only"), PackageLength(Package) + 4, static_cast<int32_t>(Package.size()));
+
+	const FQueueingWire PlainWire(false);
+	TestTrue(TEXT("Unknown instance is queued as without compact encoding"),
+		Package == PlainWire.write_message(rd::RdId(1), WriteUnknown));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdCompactEncodingBenchmarkTest, "RiderLink.RD.CompactEncoding.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FRdCompactEncodingBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace CompactEncodingTestsImpl;
+
+	constexpr int32 NumMessages = 200000;
+
+	// Plain, as written without compact encoding.
+	size_t PlainBytes = 0;
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < NumMessages; ++Index)
+	{
+		rd::Buffer Buffer;
+		WriteMessage(Buffer, Index);
+		PlainBytes += Buffer.get_position();
+	}
+	const double PlainSeconds = FPlatformTime::Seconds() - StartTime;
+
+	// Written plain with the layout, then packed, as a queued message goes out on a compact connection.
+	size_t CompactBytes = 0;
+	rd::Buffer::ByteArray Packed;
+	std::vector<rd::Buffer::ByteArray> Samples;
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < NumMessages; ++Index)
+	{
+		rd::Buffer Buffer;
+		rd::Buffer::packed_layout Layout;
+		Buffer.set_packed_layout(&Layout);
+		WriteMessage(Buffer, Index);
+		Buffer.set_packed_layout(nullptr);
+		Layout.compact(Buffer.data(), Buffer.get_position(), Packed);
+		CompactBytes += Packed.size();
+		if (Index % 1000 == 0)
+		{
+			Samples.push_back(Packed);
+		}
+	}
+	const double EncodeSeconds = FPlatformTime::Seconds() - StartTime;
+
+	// Read back on a compact buffer.
+	int64_t Checksum = 0;
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < NumMessages / static_cast<int32>(Samples.size()); ++Iteration)
+	{
+		for (const rd::Buffer::ByteArray& Sample : Samples)
+		{
+			rd::Buffer Buffer(Sample);
+			Buffer.set_compact(true);
+			Checksum += ReadMessage(Buffer);
+		}
+	}
+	const double DecodeSeconds = FPlatformTime::Seconds() - StartTime;
+
+	rd::Buffer Expected;
+	WriteMessage(Expected, 0);
+	Expected.rewind();
+	rd::Buffer First(Samples.front());
+	First.set_compact(true);
+	TestEqual(TEXT("Packed message reads back"), ReadMessage(First), ReadMessage(Expected));
+	TestTrue(TEXT("Packed messages are smaller"), CompactBytes < PlainBytes);
+
+	const auto NanosecondsPerMessage = [&](const double Seconds) { return Seconds * 1e9 / NumMessages; };
+	AddInfo(FString::Printf(TEXT("%d messages: plain %d bytes, compact %d bytes (%.1f%%), checksum %lld"), NumMessages,
+		static_cast<int32>(PlainBytes), static_cast<int32>(CompactBytes), 100.0 * CompactBytes / PlainBytes, Checksum));
+	AddInfo(FString::Printf(TEXT("Plain write %.0f ns/message, write and pack %.0f ns/message, compact read %.0f ns/message"),
+		NanosecondsPerMessage(PlainSeconds), NanosecondsPerMessage(EncodeSeconds), NanosecondsPerMessage(DecodeSeconds)));
+	return true;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "ext/ExtWire.h"
+#include "protocol/Buffer.h"
+
+namespace ExtWireTestsImpl
+{
+// Takes messages like SocketWire does with compact encoding enabled: written plain while recording where their packed
+// fields are, then packed as they go out to a counterpart reading compact messages.
+class FCompactRecordingWire final : public rd::IWire
+{
+public:
+	mutable rd::Buffer::ByteArray Plain;
+	mutable rd::Buffer::ByteArray Packed;
+
+	virtual void send(rd::RdId const& id, std::function<void(rd::Buffer& buffer)> writer) const override
+	{
+		rd::Buffer Buffer;
+		rd::Buffer::packed_layout Layout;
+		Buffer.set_packed_layout(&Layout);
+		writer(Buffer);
+		Buffer.set_packed_layout(nullptr);
+		Plain = std::move(Buffer).getRealArray();
+		Layout.compact(Plain.data(), Plain.size(), Packed);
+	}
+
+	virtual void advise(rd::Lifetime lifetime, rd::RdReactiveBase const* entity) const override
+	{
+	}
+};
+
+static void WriteMessage(rd::Buffer& Buffer)
+{
+	Buffer.write_wstring(std::wstring(L"queued"));
+	Buffer.write_packed<int32_t>(-42);
+	Buffer.write_integral<int64_t>(7);
+	Buffer.write_packed<int64_t>(300);
+}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdExtWireQueuedCompactTest, "RiderLink.RD.ExtWire.QueuedMessageOnCompactWire",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FRdExtWireQueuedCompactTest::RunTest(const FString& Parameters)
+{
+	using namespace ExtWireTestsImpl;
+
+	FCompactRecordingWire RealWire;
+	rd::ExtWire Wire;
+	Wire.realWire = &RealWire;
+
+	Wire.send(rd::RdId(1), WriteMessage);
+	TestTrue(TEXT("Message is queued until the ext wire connects"), RealWire.Plain.empty());
+	Wire.connected.set(true);
+
+	FCompactRecordingWire DirectWire;
+	DirectWire.send(rd::RdId(1), WriteMessage);
+	TestTrue(TEXT("Replayed message is plain as sent"), RealWire.Plain == DirectWire.Plain);
+	TestTrue(TEXT("Replayed message packs like one sent directly"), RealWire.Packed == DirectWire.Packed);
+	TestTrue(TEXT("Replayed message is packed"), RealWire.Packed.size() < RealWire.Plain.size());
+
+	rd::Buffer Reader(RealWire.Packed);
+	Reader.set_compact(true);
+	TestTrue(TEXT("String reads back"), Reader.read_wstring() == L"queued");
+	TestEqual(TEXT("Packed int32 reads back"), Reader.read_packed<int32_t>(), -42);
+	TestEqual(TEXT("Fixed width int64 reads back"), Reader.read_integral<int64_t>(), int64_t{7});
+	TestEqual(TEXT("Packed int64 reads back"), Reader.read_packed<int64_t>(), int64_t{300});
+	return true;
+}
+
+#endif
@@ -0,0 +1,263 @@
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "HAL/PlatformTime.h"
+
+#include "util/lz_codec.h"
+
+#include <cstring>
+#include <vector>
+
+namespace LzCodecTestsImpl
+{
+using FBytes = std::vector<uint8_t>;
+
+// Bytes written around the decompression output, which malformed input must never touch.
+static constexpr size_t GUARD_SIZE = 64;
+static constexpr uint8_t GUARD_BYTE = 0xA5;
+
+// Deterministic so failures reproduce.
+struct FRandom
+{
+	uint32_t State = 0x9E3779B9u;
+
+	uint32_t Next()
+	{
+		State ^= State << 13;
+		State ^= State >> 17;
+		State ^= State << 5;
+		return State;
+	}
+};
+
+static FBytes Incompressible(const size_t Size, const uint32_t Seed = 1)
+{
+	FRandom Random{Seed};
+	FBytes Bytes(Size);
+	for (uint8_t& Byte : Bytes)
+	{
+		Byte = static_cast<uint8_t>(Random.Next());
+	}
+	return Bytes;
+}
+
+static FBytes Repetitive(const size_t Size)
+{
+	static const char Pattern[] = "MassTest.Streaming: cell streamed in, ";
+	FBytes Bytes(Size);
+	for (size_t i = 0; i < Size; ++i)
+	{
+		Bytes[i] = static_cast<uint8_t>(Pattern[i % (sizeof(Pattern) - 1)]);
+	}
+	return Bytes;
+}
+
+// Mostly small integers and repeated identifiers with some noise, roughly what a serialized model message looks like.
+static FBytes MessageLike(const size_t Size)
+{
+	FRandom Random;
+	FBytes Bytes;
+	Bytes.reserve(Size);
+	while (Bytes.size() < Size)
+	{
+		const uint32_t Value = Random.Next();
+		const uint8_t Record[] = {0x2A, 0, 0, 0, static_cast<uint8_t>(Value & 7), 0, 0, 0, 'i', 'd', '_',
+			static_cast<uint8_t>('0' + Value % 10), static_cast<uint8_t>(Value >> 24), 1, 0, 0};
+		Bytes.insert(Bytes.end(), Record, Record + sizeof(Record));
+	}
+	Bytes.resize(Size);
+	return Bytes;
+}
+
+static size_t CompressBound(const size_t Size)
+{
+	return Size + Size / 255 + 16;
+}
+
+static FBytes Compress(const FBytes& Raw)
+{
+	FBytes Compressed(CompressBound(Raw.size()));
+	Compressed.resize(rd::util::lz_compress(Raw.data(), Raw.size(), Compressed.data(), Compressed.size()));
+	return Compressed;
+}
+
+// Decompresses into a buffer fenced by guard bytes, OutGuardsIntact tells whether they were left alone.
+static bool Decompress(const uint8_t* Src, const size_t Size, const size_t RawSize, FBytes& OutRaw, bool& OutGuardsIntact)
+{
+	FBytes Fenced(RawSize + 2 * GUARD_SIZE, GUARD_BYTE);
+	const bool bDecompressed = rd::util::lz_decompress(Src, Size, Fenced.data() + GUARD_SIZE, RawSize);
+
+	OutGuardsIntact = true;
+	for (size_t i = 0; i < GUARD_SIZE; ++i)
+	{
+		OutGuardsIntact &= Fenced[i] == GUARD_BYTE && Fenced[Fenced.size() - 1 - i] == GUARD_BYTE;
+	}
+	OutRaw.assign(Fenced.begin() + GUARD_SIZE, Fenced.end() - GUARD_SIZE);
+	return bDecompressed;
+}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdLzCodecRoundTripTest, "RiderLink.RD.LzCodec.RoundTrip",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FRdLzCodecRoundTripTest::RunTest(const FString& Parameters)
+{
+	using namespace LzCodecTestsImpl;
+
+	// Shorter than the format's 12 byte match limit, only literals.
+	const FBytes Short{'a', 'b', 'c', 'a', 'b', 'c', 'a', 'b', 'c', 'a', 'b'};
+
+	// A block repeated further back than the 64 KB a match offset can reach, then again within reach.
+	FBytes FarRepeat = Incompressible(70000, 7);
+	FarRepeat.insert(FarRepeat.end(), FarRepeat.begin(), FarRepeat.begin() + 70000);
+	FarRepeat.insert(FarRepeat.end(), FarRepeat.end() - 1000, FarRepeat.end());
+
+	const struct
+	{
+		const TCHAR* Name;
+		FBytes Raw;
+	} Cases[] = {
+		{TEXT("Empty"), FBytes{}},
+		{TEXT("Short"), Short},
+		{TEXT("Incompressible"), Incompressible(100000)},
+		{TEXT("Repetitive"), Repetitive(1 << 20)},
+		{TEXT("Past the 64 KB offset"), FarRepeat},
+		{TEXT("Message like"), MessageLike(1 << 16)},
+	};
+
+	for (const auto& Case : Cases)
+	{
+		const FBytes Compressed = Compress(Case.Raw);
+		TestTrue(FString::Printf(TEXT("%s compresses"), Case.Name), !Compressed.empty());
+
+		FBytes Raw;
+		bool bGuardsIntact;
+		TestTrue(FString::Printf(TEXT("%s decompresses"), Case.Name),
+			Decompress(Compressed.data(), Compressed.size(), Case.Raw.size(), Raw, bGuardsIntact));
+		TestTrue(FString::Printf(TEXT("%s round trips"), Case.Name), Raw == Case.Raw);
+		TestTrue(FString::Printf(TEXT("%s stays in bounds"), Case.Name), bGuardsIntact);
+	}
+
+	const FBytes Repeated = Repetitive(1 << 20);
+	TestTrue(TEXT("Repetitive input compresses over 100 times"), Compress(Repeated).size() * 100 < Repeated.size());
+
+	const FBytes Random = Incompressible(100000);
+	TestTrue(TEXT("Incompressible input stays within the bound"), Compress(Random).size() <= CompressBound(Random.size()));
+
+	FBytes TooSmall(16);
+	TestTrue(TEXT("Output that doesn't fit is reported"),
+		rd::util::lz_compress(Random.data(), Random.size(), TooSmall.data(), TooSmall.size()) == 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdLzCodecMalformedTest, "RiderLink.RD.LzCodec.Malformed",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FRdLzCodecMalformedTest::RunTest(const FString& Parameters)
+{
+	using namespace LzCodecTestsImpl;
+
+	const FBytes Raw = MessageLike(1 << 14);
+	const FBytes Compressed = Compress(Raw);
+
+	FBytes Output;
+	bool bGuardsIntact;
+
+	// Every truncation either cuts a sequence short or leaves the output incomplete.
+	bool bAllTruncationsRefused = true;
+	bool bAllTruncationsInBounds = true;
+	for (size_t Size = 0; Size < Compressed.size(); Size += 1 + Size / 16)
+	{
+		bAllTruncationsRefused &= !Decompress(Compressed.data(), Size, Raw.size(), Output, bGuardsIntact);
+		bAllTruncationsInBounds &= bGuardsIntact;
+	}
+	TestTrue(TEXT("Truncated streams are refused"), bAllTruncationsRefused);
+	TestTrue(TEXT("Truncated streams stay in bounds"), bAllTruncationsInBounds);
+
+	TestTrue(TEXT("Too short an output is refused"), !Decompress(Compressed.data(), Compressed.size(), Raw.size() - 1, Output, bGuardsIntact));
+	TestTrue(TEXT("Too long an output is refused"), !Decompress(Compressed.data(), Compressed.size(), Raw.size() + 1, Output, bGuardsIntact));
+
+	// 4 literals then a match reaching further back than the output written so far.
+	const uint8_t FarOffset[] = {0x40, 'a', 'b', 'c', 'd', 0x05, 0x00, 0x00};
+	TestTrue(TEXT("Offset past the start of the output is refused"), !Decompress(FarOffset, sizeof(FarOffset), 8, Output, bGuardsIntact));
+	const uint8_t ZeroOffset[] = {0x40, 'a', 'b', 'c', 'd', 0x00, 0x00, 0x00};
+	TestTrue(TEXT("Zero offset is refused"), !Decompress(ZeroOffset, sizeof(ZeroOffset), 8, Output, bGuardsIntact));
+
+	// Length extensions claiming more than is there.
+	const uint8_t LongLiterals[] = {0xF0, 0xFF, 0xFF, 0x10, 'a'};
+	TestTrue(TEXT("Literal run past the input is refused"), !Decompress(LongLiterals, sizeof(LongLiterals), 600, Output, bGuardsIntact));
+	const uint8_t UnterminatedLength[] = {0xF0, 0xFF, 0xFF};
+	TestTrue(TEXT("Unterminated length is refused"), !Decompress(UnterminatedLength, sizeof(UnterminatedLength), 600, Output, bGuardsIntact));
+	const uint8_t LongMatch[] = {0x4F, 'a', 'b', 'c', 'd', 0x04, 0x00, 0xFF, 0x00, 0x00};
+	TestTrue(TEXT("Match past the output is refused"), !Decompress(LongMatch, sizeof(LongMatch), 64, Output, bGuardsIntact));
+	TestTrue(TEXT("Refused match stays in bounds"), bGuardsIntact);
+
+	// Whatever a corrupted stream decodes to, it's never outside of the output.
+	FRandom Random;
+	bool bAllCorruptionsInBounds = true;
+	for (int32 Iteration = 0; Iteration < 2000; ++Iteration)
+	{
+		FBytes Corrupted = Compressed;
+		for (int32 Flip = 0; Flip < 4; ++Flip)
+		{
+			Corrupted[Random.Next() % Corrupted.size()] ^= static_cast<uint8_t>(1 + Random.Next() % 255);
+		}
+		Decompress(Corrupted.data(), Corrupted.size(), Raw.size(), Output, bGuardsIntact);
+		bAllCorruptionsInBounds &= bGuardsIntact;
+	}
+	TestTrue(TEXT("Corrupted streams stay in bounds"), bAllCorruptionsInBounds);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdLzCodecBenchmarkTest, "RiderLink.RD.LzCodec.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FRdLzCodecBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace LzCodecTestsImpl;
+
+	constexpr int32 Iterations = 20;
+
+	const struct
+	{
+		const TCHAR* Name;
+		FBytes Raw;
+	} Cases[] = {
+		{TEXT("Message like"), MessageLike(1 << 20)},
+		{TEXT("Repetitive"), Repetitive(1 << 20)},
+		{TEXT("Incompressible"), Incompressible(1 << 20)},
+	};
+
+	for (const auto& Case : Cases)
+	{
+		FBytes Compressed(CompressBound(Case.Raw.size()));
+		size_t CompressedSize = 0;
+
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			CompressedSize = rd::util::lz_compress(Case.Raw.data(), Case.Raw.size(), Compressed.data(), Compressed.size());
+		}
+		const double CompressSeconds = FPlatformTime::Seconds() - StartTime;
+
+		FBytes Raw(Case.Raw.size());
+		bool bDecompressed = true;
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			bDecompressed &= rd::util::lz_decompress(Compressed.data(), CompressedSize, Raw.data(), Raw.size());
+		}
+		const double DecompressSeconds = FPlatformTime::Seconds() - StartTime;
+
+		TestTrue(FString::Printf(TEXT("%s round trips"), Case.Name), bDecompressed && Raw == Case.Raw);
+
+		const double Megabytes = static_cast<double>(Case.Raw.size()) * Iterations / (1 << 20);
+		AddInfo(FString::Printf(TEXT("%s: %d -> %d bytes (%.1f%%), compress %.0f MB/s, decompress %.0f MB/s"), Case.Name,
+			static_cast<int32>(Case.Raw.size()), static_cast<int32>(CompressedSize), 100.0 * CompressedSize / Case.Raw.size(),
+			Megabytes / CompressSeconds, Megabytes / DecompressSeconds));
+	}
+	return true;
+}
+
+#endif
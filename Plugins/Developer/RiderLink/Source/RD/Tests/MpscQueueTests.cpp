@@ -0,0 +1,161 @@
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "HAL/PlatformTime.h"
+
+#include "util/mpsc_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MpscQueueTestsImpl
+{
+// Producer in the high bits, its own count in the low ones, so the consumer can check each producer's order.
+static uint64_t MakeItem(const uint32_t Producer, const uint32_t Index)
+{
+	return (static_cast<uint64_t>(Producer) << 32) | Index;
+}
+
+// What ByteBufferAsyncProcessor queued behind before: a deque under a mutex.
+template <typename T>
+class FLockedQueue
+{
+	std::mutex Lock;
+	std::deque<T> Items;
+
+public:
+	explicit FLockedQueue(size_t)
+	{
+	}
+
+	void push(T Value)
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		Items.push_back(std::move(Value));
+	}
+
+	bool try_pop(T& Out)
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		if (Items.empty())
+		{
+			return false;
+		}
+		Out = std::move(Items.front());
+		Items.pop_front();
+		return true;
+	}
+};
+
+// [NumProducers] threads push [PerProducer] items each while the calling thread pops them all.
+// Returns the seconds it took, OutOrdered tells whether every producer's items came out in order.
+template <typename Q>
+static double Run(Q& Queue, const uint32_t NumProducers, const uint32_t PerProducer, bool& OutOrdered)
+{
+	std::atomic<uint32_t> Ready{0};
+	std::atomic<bool> Go{false};
+	std::vector<std::thread> Producers;
+	for (uint32_t Producer = 0; Producer < NumProducers; ++Producer)
+	{
+		Producers.emplace_back([&, Producer]() {
+			++Ready;
+			while (!Go.load())
+			{
+				std::this_thread::yield();
+			}
+			for (uint32_t Index = 0; Index < PerProducer; ++Index)
+			{
+				Queue.push(MakeItem(Producer, Index));
+			}
+		});
+	}
+	while (Ready.load() != NumProducers)
+	{
+		std::this_thread::yield();
+	}
+
+	std::vector<uint32_t> Next(NumProducers, 0);
+	OutOrdered = true;
+	const uint64_t Total = static_cast<uint64_t>(NumProducers) * PerProducer;
+
+	const double StartTime = FPlatformTime::Seconds();
+	Go.store(true);
+	for (uint64_t Popped = 0; Popped < Total;)
+	{
+		uint64_t Item;
+		if (Queue.try_pop(Item))
+		{
+			const auto Producer = static_cast<uint32_t>(Item >> 32);
+			OutOrdered &= Producer < NumProducers && static_cast<uint32_t>(Item) == Next[Producer]++;
+			++Popped;
+		}
+	}
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+	for (std::thread& Producer : Producers)
+	{
+		Producer.join();
+	}
+	return Seconds;
+}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdMpscQueueOrderTest, "RiderLink.RD.MpscQueue.ProducerOrder",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FRdMpscQueueOrderTest::RunTest(const FString& Parameters)
+{
+	using namespace MpscQueueTestsImpl;
+
+	// A ring far smaller than what is in flight keeps spilling to the overflow list and back.
+	for (const size_t Capacity : {size_t{4}, size_t{1024}})
+	{
+		rd::util::mpsc_queue<uint64_t> Queue(Capacity);
+		bool bOrdered;
+		Run(Queue, 4, 20000, bOrdered);
+		TestTrue(FString::Printf(TEXT("Each producer's items come out in order with a ring of %d"), static_cast<int32>(Capacity)), bOrdered);
+
+		uint64_t Item;
+		TestTrue(FString::Printf(TEXT("Nothing is left with a ring of %d"), static_cast<int32>(Capacity)),
+			Queue.empty() && !Queue.try_pop(Item));
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdMpscQueueBenchmarkTest, "RiderLink.RD.MpscQueue.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FRdMpscQueueBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace MpscQueueTestsImpl;
+
+	constexpr uint32_t PerProducer = 200000;
+	// Same as ByteBufferAsyncProcessor's, and small enough to overflow while producers outpace the consumer.
+	constexpr size_t Capacity = 1024;
+
+	const uint32_t MaxProducers = (std::max)(2u, std::thread::hardware_concurrency());
+	for (uint32_t NumProducers = 1; NumProducers <= MaxProducers; NumProducers *= 2)
+	{
+		bool bRingOrdered;
+		rd::util::mpsc_queue<uint64_t> Ring(Capacity);
+		const double RingSeconds = Run(Ring, NumProducers, PerProducer, bRingOrdered);
+
+		bool bLockedOrdered;
+		FLockedQueue<uint64_t> Locked(Capacity);
+		const double LockedSeconds = Run(Locked, NumProducers, PerProducer, bLockedOrdered);
+
+		TestTrue(FString::Printf(TEXT("%d producers keep their order"), static_cast<int32>(NumProducers)), bRingOrdered && bLockedOrdered);
+
+		const double Items = static_cast<double>(NumProducers) * PerProducer / 1e6;
+		AddInfo(FString::Printf(TEXT("%d producers: mpsc_queue %.1f M items/s, locked deque %.1f M items/s"),
+			static_cast<int32>(NumProducers), Items / RingSeconds, Items / LockedSeconds));
+	}
+	return true;
+}
+
+#endif
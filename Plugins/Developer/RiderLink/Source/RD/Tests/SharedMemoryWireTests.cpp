@@ -0,0 +1,279 @@
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "base/RdReactiveBase.h"
+#include "lifetime/LifetimeDefinition.h"
+#include "scheduler/SynchronousScheduler.h"
+#include "wire/SharedMemoryWire.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace SharedMemoryWireTestsImpl
+{
+static constexpr int64_t ENTITY_ID = 42;
+// Rings are at least this large, messages go well past it.
+static constexpr size_t RING_CAPACITY = 4096;
+static constexpr auto WAIT_TIMEOUT = std::chrono::seconds(10);
+
+static rd::IScheduler* Scheduler()
+{
+	return &rd::SynchronousScheduler::Instance();
+}
+
+static uint8_t PayloadByte(const int32_t Index, const int32_t Offset)
+{
+	return static_cast<uint8_t>(Index * 31 + Offset);
+}
+
+// Messages are an index, a size and that many bytes derived from both, so each one can be checked on its own.
+static void WriteMessage(rd::Buffer& Buffer, const int32_t Index, const int32_t Size)
+{
+	rd::Buffer::ByteArray Payload(Size);
+	for (int32_t Offset = 0; Offset < Size; ++Offset)
+	{
+		Payload[Offset] = PayloadByte(Index, Offset);
+	}
+	Buffer.write_integral<int32_t>(Index);
+	Buffer.write_integral<int32_t>(Size);
+	Buffer.write_byte_array_raw(Payload);
+}
+
+// Records the index of every intact message received, from the wire's receiving thread.
+class FRecordingEntity final : public rd::RdReactiveBase
+{
+public:
+	mutable std::mutex Lock;
+	mutable std::condition_variable Received;
+	mutable std::multiset<int32_t> Indices;
+	mutable int32_t NumCorrupted = 0;
+
+	FRecordingEntity()
+	{
+		set_id(rd::RdId(ENTITY_ID));
+	}
+
+	virtual rd::IScheduler* get_wire_scheduler() const override
+	{
+		return Scheduler();
+	}
+
+	virtual void on_wire_received(rd::Buffer Buffer) const override
+	{
+		const int32_t Index = Buffer.read_integral<int32_t>();
+		rd::Buffer::ByteArray Payload(Buffer.read_integral<int32_t>());
+		Buffer.read_byte_array_raw(Payload);
+
+		bool bIntact = true;
+		for (size_t Offset = 0; Offset < Payload.size(); ++Offset)
+		{
+			bIntact &= Payload[Offset] == PayloadByte(Index, static_cast<int32_t>(Offset));
+		}
+
+		std::lock_guard<std::mutex> Guard(Lock);
+		if (bIntact)
+		{
+			Indices.insert(Index);
+		}
+		else
+		{
+			++NumCorrupted;
+		}
+		Received.notify_all();
+	}
+
+	bool WaitFor(const size_t Count) const
+	{
+		std::unique_lock<std::mutex> Guard(Lock);
+		return Received.wait_for(Guard, WAIT_TIMEOUT, [this, Count] { return Indices.size() >= Count; });
+	}
+
+	std::multiset<int32_t> GetIndices() const
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		return Indices;
+	}
+};
+
+static bool WaitUntil(const std::function<bool()>& Condition)
+{
+	const auto Deadline = std::chrono::steady_clock::now() + WAIT_TIMEOUT;
+	while (!Condition())
+	{
+		if (std::chrono::steady_clock::now() > Deadline)
+		{
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	return true;
+}
+
+static void Advise(rd::Lifetime Lifetime, const rd::IWire& Wire, const FRecordingEntity& Entity)
+{
+	// The broker wants subscriptions made on its scheduler.
+	Scheduler()->queue([&]() { Wire.advise(Lifetime, &Entity); });
+}
+
+static void Send(const rd::IWire& Wire, const int32_t Index, const int32_t Size)
+{
+	Wire.send(rd::RdId(ENTITY_ID), [Index, Size](rd::Buffer& Buffer) { WriteMessage(Buffer, Index, Size); });
+}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdSharedMemoryWireLargeMessagesTest, "RiderLink.RD.SharedMemoryWire.LargeMessages",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FRdSharedMemoryWireLargeMessagesTest::RunTest(const FString& Parameters)
+{
+	using namespace SharedMemoryWireTestsImpl;
+
+	rd::LifetimeDefinition Definition;
+	const rd::Lifetime& Lifetime = Definition.lifetime;
+
+	FRecordingEntity ServerEntity;
+	FRecordingEntity ClientEntity;
+
+	const auto Server = std::make_shared<rd::SharedMemoryWire::Server>(Lifetime, Scheduler(), std::string{}, RING_CAPACITY);
+	const auto Client = std::make_shared<rd::SharedMemoryWire::Client>(Lifetime, Scheduler(), Server->name);
+	Advise(Lifetime, *Server, ServerEntity);
+	Advise(Lifetime, *Client, ClientEntity);
+
+	TestTrue(TEXT("Client attaches"), WaitUntil([&]() { return Server->connected.get() && Client->connected.get(); }));
+
+	// Small and ring sized messages interleaved with ones several times the ring capacity, both ways at once.
+	constexpr int32_t NumMessages = 24;
+	const auto SizeOf = [](const int32_t Index) { return Index % 3 == 0 ? static_cast<int32_t>(RING_CAPACITY) * 5 + Index : Index * 100; };
+	std::thread ServerSender([&]() {
+		for (int32_t Index = 0; Index < NumMessages; ++Index)
+		{
+			Send(*Server, Index, SizeOf(Index));
+		}
+	});
+	for (int32_t Index = 0; Index < NumMessages; ++Index)
+	{
+		Send(*Client, Index, SizeOf(Index));
+	}
+	ServerSender.join();
+
+	TestTrue(TEXT("Client receives every message"), ClientEntity.WaitFor(NumMessages));
+	TestTrue(TEXT("Server receives every message"), ServerEntity.WaitFor(NumMessages));
+
+	std::multiset<int32_t> Expected;
+	for (int32_t Index = 0; Index < NumMessages; ++Index)
+	{
+		Expected.insert(Index);
+	}
+	TestTrue(TEXT("Client receives each message once"), ClientEntity.GetIndices() == Expected);
+	TestTrue(TEXT("Server receives each message once"), ServerEntity.GetIndices() == Expected);
+	TestEqual(TEXT("Nothing arrives corrupted"), ClientEntity.NumCorrupted + ServerEntity.NumCorrupted, 0);
+
+	Definition.terminate();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdSharedMemoryWireReattachTest, "RiderLink.RD.SharedMemoryWire.Reattach",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FRdSharedMemoryWireReattachTest::RunTest(const FString& Parameters)
+{
+	using namespace SharedMemoryWireTestsImpl;
+
+	rd::LifetimeDefinition ServerDefinition;
+	FRecordingEntity ServerEntity;
+	const auto Server =
+		std::make_shared<rd::SharedMemoryWire::Server>(ServerDefinition.lifetime, Scheduler(), std::string{}, RING_CAPACITY);
+	Advise(ServerDefinition.lifetime, *Server, ServerEntity);
+
+	FRecordingEntity FirstEntity;
+	FRecordingEntity SecondEntity;
+
+	constexpr int32_t NumMessages = 200;
+	constexpr int32_t MessageSize = 1000;
+	{
+		rd::LifetimeDefinition ClientDefinition;
+		const auto Client = std::make_shared<rd::SharedMemoryWire::Client>(ClientDefinition.lifetime, Scheduler(), Server->name);
+		Advise(ClientDefinition.lifetime, *Client, FirstEntity);
+		TestTrue(TEXT("First client attaches"), WaitUntil([&]() { return Server->connected.get() && Client->connected.get(); }));
+
+		// Far more than the ring holds: when the client detaches some are read, some are in the ring, some still queued.
+		for (int32_t Index = 0; Index < NumMessages / 2; ++Index)
+		{
+			Send(*Server, Index, MessageSize);
+		}
+		ClientDefinition.terminate();
+	}
+	TestTrue(TEXT("Server notices the client detached"), WaitUntil([&]() { return !Server->connected.get(); }));
+
+	// Queued while nobody is attached.
+	for (int32_t Index = NumMessages / 2; Index < NumMessages; ++Index)
+	{
+		Send(*Server, Index, MessageSize);
+	}
+
+	rd::LifetimeDefinition ClientDefinition;
+	const auto Client = std::make_shared<rd::SharedMemoryWire::Client>(ClientDefinition.lifetime, Scheduler(), Server->name);
+	Advise(ClientDefinition.lifetime, *Client, SecondEntity);
+	TestTrue(TEXT("Second client attaches"), WaitUntil([&]() { return Server->connected.get() && Client->connected.get(); }));
+
+	// Whatever the first client didn't read is sent again to the second one.
+	const auto Covered = [&]() {
+		std::set<int32_t> Indices;
+		for (const int32_t Index : FirstEntity.GetIndices())
+		{
+			Indices.insert(Index);
+		}
+		for (const int32_t Index : SecondEntity.GetIndices())
+		{
+			Indices.insert(Index);
+		}
+		return static_cast<int32_t>(Indices.size()) == NumMessages;
+	};
+	TestTrue(TEXT("Every message reaches one of the clients"), WaitUntil(Covered));
+	TestTrue(TEXT("Messages queued while detached reach the second client"),
+		SecondEntity.GetIndices().count(NumMessages - 1) == 1);
+	TestEqual(TEXT("Nothing arrives corrupted"), FirstEntity.NumCorrupted + SecondEntity.NumCorrupted, 0);
+
+	// And the other way around over the new attachment.
+	Send(*Client, NumMessages, MessageSize);
+	TestTrue(TEXT("Server receives from the second client"), ServerEntity.WaitFor(1));
+
+	ClientDefinition.terminate();
+	ServerDefinition.terminate();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRdSharedMemoryWireHeartbeatTimeoutTest, "RiderLink.RD.SharedMemoryWire.HeartbeatTimeout",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FRdSharedMemoryWireHeartbeatTimeoutTest::RunTest(const FString& Parameters)
+{
+	using namespace SharedMemoryWireTestsImpl;
+
+	rd::LifetimeDefinition Definition;
+	const rd::Lifetime& Lifetime = Definition.lifetime;
+
+	// A client whose heartbeat stalls without it detaching, like a hung process. It's created first so it only
+	// reads its interval once the server it waits for is up.
+	const std::string Name = "rd-test-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count() & 0xFFFFFF);
+	const auto Client = std::make_shared<rd::SharedMemoryWire::Client>(Lifetime, Scheduler(), Name);
+	Client->heartBeatInterval = std::chrono::milliseconds(1500);
+
+	const auto Server = std::make_shared<rd::SharedMemoryWire::Server>(Lifetime, Scheduler(), Name, RING_CAPACITY);
+	Server->heartBeatInterval = std::chrono::milliseconds(10);
+
+	TestTrue(TEXT("Client attaches"), WaitUntil([&]() { return Server->connected.get(); }));
+	TestTrue(TEXT("Stalled heartbeat is noticed"), WaitUntil([&]() { return !Server->heartbeatAlive.get(); }));
+	TestTrue(TEXT("Server disconnects the stalled client"), WaitUntil([&]() { return !Server->connected.get(); }));
+
+	Definition.terminate();
+	return true;
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "ExtWire.h"
 
 #include "protocol/Buffer.h"
+#include "util/shared_function.h"
 
 namespace rd
 {
@@ -20,8 +21,15 @@ ExtWire::ExtWire()
 					// auto[id, payload] = std::move(sendQ.front());
 					auto it = std::move(sendQ.front());
 					sendQ.pop();
-					realWire->send(
-						it.first, [payload = std::move(it.second)](Buffer& buffer) { buffer.write_byte_array_raw(payload); });
+					realWire->send(it.id,
+						util::make_shared_function(
+							[payload = std::move(it.payload), layout = std::move(it.layout)](Buffer& buffer) {
+								if (Buffer::packed_layout* buffer_layout = buffer.get_packed_layout())
+								{
+									buffer_layout->append(layout, buffer.get_position());
+								}
+								buffer.write_byte_array_raw(payload);
+							}));
 				}
 			}
 		}
@@ -39,9 +47,13 @@ void ExtWire::send(RdId const& id, std::function<void(Buffer& buffer)> writer) c
 		std::lock_guard<decltype(lock)> guard(lock);
 		if (!sendQ.empty() || !connected.get())
 		{
+			// Serialized plain, the layout lets the real wire pack it later like a message written straight into it.
 			Buffer buffer;
+			Buffer::packed_layout layout;
+			buffer.set_packed_layout(&layout);
 			writer(buffer);
-			sendQ.emplace(id, buffer.getRealArray());
+			buffer.set_packed_layout(nullptr);
+			sendQ.push({id, std::move(buffer).getRealArray(), std::move(layout)});
 			return;
 		}
 	}
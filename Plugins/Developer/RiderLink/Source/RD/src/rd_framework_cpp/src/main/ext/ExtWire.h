@@ -22,7 +22,15 @@ class RD_FRAMEWORK_API ExtWire final : public IWire
 {
 	mutable std::mutex lock;
 
-	mutable std::queue<std::pair<RdId, Buffer::ByteArray> > sendQ;
+	struct queued_message
+	{
+		RdId id;
+		Buffer::ByteArray payload;
+		// Where the packed fields of [payload] are, for a real wire packing messages when it sends them.
+		Buffer::packed_layout layout;
+	};
+
+	mutable std::queue<queued_message> sendQ;
 
 public:
 	ExtWire();
@@ -195,8 +195,12 @@ public:
 		}
 		else
 		{
+			// The key is copied into the ACK as is, so a wire packing messages on send needs to know where its packed fields are.
 			Buffer serialized_key;
+			Buffer::packed_layout key_layout;
+			serialized_key.set_packed_layout(&key_layout);
 			KS::write(this->get_serialization_context(), serialized_key, wrapper::get<K>(key));
+			serialized_key.set_packed_layout(nullptr);
 
 			bool is_put = (op == Op::ADD || op == Op::UPDATE);
 			optional<WV> value;
@@ -225,11 +229,16 @@ public:
 			if (msg_versioned)
 			{
 				auto writer =
-					util::make_shared_function([version, serialized_key = std::move(serialized_key)](Buffer& innerBuffer) mutable {
+					util::make_shared_function([version, serialized_key = std::move(serialized_key),
+												   key_layout = std::move(key_layout)](Buffer& innerBuffer) mutable {
 						innerBuffer.write_integral<int32_t>((1u << versionedFlagShift) | static_cast<int32_t>(Op::ACK));
 						innerBuffer.write_integral<int64_t>(version);
 						// KS::write(this->get_serialization_context(), innerBuffer, wrapper::get<K>(key));
-						innerBuffer.write_byte_array_raw(serialized_key.getArray());
+						if (Buffer::packed_layout* layout = innerBuffer.get_packed_layout())
+						{
+							layout->append(key_layout, innerBuffer.get_position());
+						}
+						innerBuffer.write_byte_array_raw(serialized_key.getRealArray());
 						// logSend.trace(logmsg(Op::ACK, version, serialized_key));
 					});
 				get_wire()->send(rdid, std::move(writer));
@@ -2,21 +2,216 @@
 
 #include "protocol/Buffer.h"
 
+#include "protocol/ByteArrayPool.h"
+
+#include <cstring>
 #include <string>
 #include <algorithm>
 
 namespace rd
 {
+constexpr size_t Buffer::INLINE_CAPACITY;
+constexpr size_t Buffer::MAX_VARINT_SIZE;
+
 Buffer::Buffer() : Buffer(16)
 {
 }
 
-Buffer::Buffer(size_t initialSize) : data_(initialSize)
+Buffer::Buffer(size_t initialSize)
+{
+	if (initialSize <= INLINE_CAPACITY)
+	{
+		inline_ = true;
+		inline_size_ = initialSize;
+	}
+	else
+	{
+		data_.resize(initialSize);
+	}
+}
+
+Buffer::Buffer(ByteArray array, size_t offset) : data_(std::move(array)), offset(offset), written_(data_.size())
+{
+}
+
+Buffer Buffer::view(std::shared_ptr<const ByteArray> slab, size_t begin, size_t length)
+{
+	Buffer result(0);
+	result.view_data_ = slab->data() + begin;
+	result.view_size_ = length;
+	result.written_ = length;
+	result.slab_ = std::move(slab);
+	return result;
+}
+
+Buffer Buffer::pooled(size_t initial_size)
+{
+	Buffer result(ByteArrayPool::acquire(initial_size));
+	result.pooled_ = true;
+	result.written_ = 0;
+	return result;
+}
+
+bool Buffer::is_view() const
 {
+	return slab_ != nullptr;
 }
 
-Buffer::Buffer(ByteArray array, size_t offset) : data_(std::move(array)), offset(offset)
+void Buffer::set_compact(bool value)
 {
+	compact_ = value;
+}
+
+bool Buffer::is_compact() const
+{
+	return compact_;
+}
+
+void Buffer::set_packed_layout(packed_layout* layout)
+{
+	layout_ = layout;
+}
+
+Buffer::packed_layout* Buffer::get_packed_layout() const
+{
+	return layout_;
+}
+
+void Buffer::packed_layout::clear()
+{
+	fields.clear();
+	length_tags.clear();
+	opaque = false;
+}
+
+void Buffer::packed_layout::append(packed_layout const& other, size_t offset)
+{
+	const auto shift = static_cast<uint32_t>(offset);
+	opaque |= other.opaque;
+	for (auto const& it : other.fields)
+	{
+		fields.push_back({it.position + shift, it.size, it.is_signed});
+	}
+	for (auto const& it : other.length_tags)
+	{
+		length_tags.push_back({it.position + shift, it.end + shift});
+	}
+}
+
+void Buffer::packed_layout::compact(word_t const* data, size_t size, ByteArray& out) const
+{
+	// Bytes saved by packing fields [0, i], to move positions recorded in the plain payload.
+	static thread_local std::vector<uint32_t> saved;
+	saved.clear();
+
+	out.clear();
+	out.reserve(size);
+	size_t cursor = 0;
+	uint32_t total_saved = 0;
+	for (auto const& it : fields)
+	{
+		out.insert(out.end(), data + cursor, data + it.position);
+
+		uint64_t value = 0;
+		std::memcpy(&value, data + it.position, it.size);
+		if (it.is_signed)
+		{
+			// Sign extended from the field width, as write_packed does.
+			const int shift = 64 - 8 * it.size;
+			value = zigzag_encode(static_cast<int64_t>(value << shift) >> shift);
+		}
+
+		word_t bytes[MAX_VARINT_SIZE];
+		const auto count = static_cast<uint32_t>(encode_varint(value, bytes));
+		out.insert(out.end(), bytes, bytes + count);
+
+		// A 2 byte field can take 3 packed, the unsigned sum wraps around and still adds up.
+		total_saved += it.size - count;
+		saved.push_back(total_saved);
+		cursor = it.position + it.size;
+	}
+	out.insert(out.end(), data + cursor, data + size);
+
+	const auto packed_position = [this](uint32_t position) -> uint32_t {
+		const auto after = std::lower_bound(fields.begin(), fields.end(), position,
+			[](field const& it, uint32_t value) { return it.position < value; });
+		return after == fields.begin() ? position : position - saved[after - fields.begin() - 1];
+	};
+	for (auto const& it : length_tags)
+	{
+		const uint32_t tag_position = packed_position(it.position);
+		const auto length = static_cast<int32_t>(packed_position(it.end) - packed_position(it.position + sizeof(int32_t)));
+		std::memcpy(out.data() + tag_position, &length, sizeof(int32_t));
+	}
+}
+
+size_t Buffer::encode_varint(uint64_t value, word_t (&bytes)[MAX_VARINT_SIZE])
+{
+	size_t count = 0;
+	do
+	{
+		bytes[count] = static_cast<word_t>(value & 0x7F);
+		value >>= 7;
+		if (value != 0)
+		{
+			bytes[count] |= 0x80;
+		}
+		++count;
+	} while (value != 0);
+	return count;
+}
+
+void Buffer::write_varint(uint64_t value)
+{
+	word_t bytes[MAX_VARINT_SIZE];
+	write(bytes, encode_varint(value, bytes));
+}
+
+uint64_t Buffer::read_varint()
+{
+	uint64_t result = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		const auto byte = read_integral<word_t>();
+		result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return result;
+		}
+	}
+	throw std::out_of_range("Malformed varint, longer than 10 bytes");
+}
+
+void Buffer::detach()
+{
+	if (!slab_)
+		return;
+	inline_ = view_size_ <= INLINE_CAPACITY;
+	if (inline_)
+	{
+		std::copy(view_data_, view_data_ + view_size_, inline_data_.begin());
+		inline_size_ = view_size_;
+	}
+	else
+	{
+		data_.assign(view_data_, view_data_ + view_size_);
+	}
+	slab_.reset();
+	view_data_ = nullptr;
+	view_size_ = 0;
+}
+
+void Buffer::spill(size_t new_size)
+{
+	data_.resize((std::max)(new_size, inline_size_));
+	std::copy(inline_data_.begin(), inline_data_.begin() + inline_size_, data_.begin());
+	inline_ = false;
+	inline_size_ = 0;
+}
+
+Buffer::word_t const* Buffer::storage() const
+{
+	return slab_ ? view_data_ : inline_ ? inline_data_.data() : data_.data();
 }
 
 size_t Buffer::get_position() const
@@ -43,7 +238,8 @@ void Buffer::read(word_t* dst, size_t size)
 	if (size == 0)
 		return;
 	check_available(size);
-	std::copy(&data_[offset], &data_[offset] + size, dst);
+	const word_t* src = storage() + offset;
+	std::copy(src, src + size, dst);
 	offset += size;
 }
 
@@ -52,16 +248,40 @@ void Buffer::write(const word_t* src, size_t size)
 	if (size == 0)
 		return;
 	require_available(size);
-	std::copy(src, src + size, &data_[offset]);
+	std::copy(src, src + size, data() + offset);
 	offset += size;
 }
 
 void Buffer::require_available(size_t moreSize)
 {
-	if (offset + moreSize >= size())
+	detach();
+	written_ = (std::max)(written_, offset + moreSize);
+	if (offset + moreSize > size())
 	{
 		const size_t new_size = (std::max)(size() * 2, offset + moreSize);
-		data_.resize(new_size);
+		if (inline_)
+		{
+			// Growing within the inline area is free, leaving it is the only allocation a short buffer makes.
+			if (offset + moreSize <= INLINE_CAPACITY)
+			{
+				inline_size_ = INLINE_CAPACITY;
+			}
+			else
+			{
+				spill(new_size);
+			}
+		}
+		else if (pooled_)
+		{
+			ByteArray grown = ByteArrayPool::acquire(new_size);
+			std::copy(data_.begin(), data_.end(), grown.begin());
+			ByteArrayPool::release(std::move(data_));
+			data_ = std::move(grown);
+		}
+		else
+		{
+			data_.resize(new_size);
+		}
 	}
 }
 
@@ -72,12 +292,16 @@ void Buffer::rewind()
 
 Buffer::ByteArray Buffer::getArray() const&
 {
-	return data_;
+	return ByteArray(storage(), storage() + written_);
 }
 
 Buffer::ByteArray Buffer::getArray() &&
 {
+	detach();
 	rewind();
+	if (inline_)
+		return ByteArray(inline_data_.begin(), inline_data_.begin() + written_);
+	data_.resize(written_);
 	return std::move(data_);
 }
 
@@ -90,6 +314,13 @@ Buffer::ByteArray Buffer::getRealArray() const&
 
 Buffer::ByteArray Buffer::getRealArray() &&
 {
+	detach();
+	if (inline_)
+	{
+		ByteArray res(inline_data_.begin(), inline_data_.begin() + offset);
+		rewind();
+		return res;
+	}
 	auto res = std::move(data_);
 	res.resize(offset);
 	rewind();
@@ -98,12 +329,13 @@ Buffer::ByteArray Buffer::getRealArray() &&
 
 Buffer::word_t const* Buffer::data() const
 {
-	return data_.data();
+	return storage();
 }
 
 Buffer::word_t* Buffer::data()
 {
-	return data_.data();
+	detach();
+	return inline_ ? inline_data_.data() : data_.data();
 }
 
 Buffer::word_t const* Buffer::current_pointer() const
@@ -118,7 +350,7 @@ Buffer::word_t* Buffer::current_pointer()
 
 size_t Buffer::size() const
 {
-	return data_.size();
+	return slab_ ? view_size_ : inline_ ? inline_size_ : data_.size();
 }
 
 /*std::string Buffer::readString() const {
@@ -141,7 +373,7 @@ std::wstring read_wstring_spec(Buffer& buffer)
 template <>
 std::wstring read_wstring_spec<2>(Buffer& buffer)
 {
-	const int32_t len = buffer.read_integral<int32_t>();
+	const int32_t len = buffer.read_packed<int32_t>();
 	RD_ASSERT_MSG(len >= 0, "read null string(length =" + std::to_string(len) + ")");
 	std::wstring result;
 	result.resize(len);
@@ -164,7 +396,7 @@ void write_wstring_spec(Buffer& buffer, wstring_view value)
 template <>
 void write_wstring_spec<2>(Buffer& buffer, wstring_view value)
 {
-	buffer.write_integral<int32_t>(static_cast<int32_t>(value.size()));
+	buffer.write_packed<int32_t>(static_cast<int32_t>(value.size()));
 	buffer.write(reinterpret_cast<Buffer::word_t const*>(value.data()), sizeof(wchar_t) * value.size());
 }
 
@@ -175,13 +407,13 @@ void Buffer::write_wstring(std::wstring const& value)
 
 void Buffer::write_char16_string(const uint16_t* data, size_t len)
 {
-	write_integral<int32_t>(static_cast<int32_t>(len));
+	write_packed<int32_t>(static_cast<int32_t>(len));
 	write(reinterpret_cast<word_t const*>(data), sizeof(uint16_t) * len);
 }
 
 uint16_t* Buffer::read_char16_string()
 {	
-	const int32_t len = read_integral<int32_t>();
+	const int32_t len = read_packed<int32_t>();
 	RD_ASSERT_MSG(len >= 0, "read null string(length =" + std::to_string(len) + ")");
 	uint16_t * result = new uint16_t[len+1];
 	read(reinterpret_cast<Buffer::word_t*>(&result[0]), sizeof(uint16_t) * len);
@@ -256,6 +488,9 @@ void Buffer::write_byte_array_raw(const ByteArray& array)
 
 Buffer::ByteArray& Buffer::get_data()
 {
+	detach();
+	if (inline_)
+		spill(inline_size_);
 	return data_;
 }
 }	 // namespace rd
@@ -12,6 +12,7 @@
 #include "std/allocator.h"
 #include "std/list.h"
 
+#include <array>
 #include <vector>
 #include <type_traits>
 #include <functional>
@@ -31,7 +32,8 @@ public:
 
 	using word_t = uint8_t;
 
-	using Allocator = std::allocator<word_t>;
+	// Grown bytes aren't zero filled: past what was written the storage holds garbage, getArray() and getRealArray() leave it out.
+	using Allocator = default_init_allocator<word_t>;
 
 	using ByteArray = std::vector<word_t, Allocator>;
 
@@ -42,10 +44,86 @@ private:
 	template <int>
 	friend void write_wstring_spec(Buffer&, wstring_view);
 
+	// Short buffers live inline and only move to data_ once they outgrow INLINE_CAPACITY, see spill().
+	static constexpr size_t INLINE_CAPACITY = 64;
+	std::array<word_t, INLINE_CAPACITY> inline_data_;
+	size_t inline_size_ = 0;
+	bool inline_ = false;
+
 	ByteArray data_;
 
 	size_t offset = 0;
 
+	// End of the bytes written, or reserved for writing through require_available(). Storage past it is uninitialized.
+	size_t written_ = 0;
+
+	// Set while the buffer is a read-only view into a shared slab, see view(). data_ stays empty until a write detaches it.
+	std::shared_ptr<const ByteArray> slab_;
+	const word_t* view_data_ = nullptr;
+	size_t view_size_ = 0;
+
+	// Storage comes from and grows through ByteArrayPool, see pooled().
+	bool pooled_ = false;
+
+	// Packed integers are LEB128 instead of fixed width, see write_packed().
+	bool compact_ = false;
+
+public:
+	/**
+	 * \brief Where write_packed put fixed width integers in a plain buffer, and which polymorphic length tags cover them.
+	 * Lets a wire queue payloads plain and only pack them once it knows the connection they go out on.
+	 */
+	struct RD_FRAMEWORK_API packed_layout
+	{
+		struct field
+		{
+			uint32_t position;
+			uint8_t size;
+			bool is_signed;
+		};
+
+		// int32 at [position] counting the bytes from right after it up to [end].
+		struct length_tag
+		{
+			uint32_t position;
+			uint32_t end;
+		};
+
+		// In write order, which is position order.
+		std::vector<field> fields;
+		std::vector<length_tag> length_tags;
+
+		// Set when raw bytes of unknown encoding were written, such as those of an unknown polymorphic instance: which of
+		// them are packed fields isn't known, so the payload can only go out as written.
+		bool opaque = false;
+
+		void clear();
+
+		// Adds [other], recorded in a buffer whose bytes are now copied at [offset].
+		void append(packed_layout const& other, size_t offset);
+
+		/**
+		 * \brief Writes the plain payload [data] of [size] bytes to [out] with the recorded fields as write_packed writes
+		 * them on compact buffers, and the length tags adjusted to match.
+		 */
+		void compact(word_t const* data, size_t size, ByteArray& out) const;
+	};
+
+private:
+	// Receives the packed fields written while the buffer is plain, see set_packed_layout().
+	packed_layout* layout_ = nullptr;
+
+	static constexpr size_t MAX_VARINT_SIZE = 10;
+
+	// LEB128 of [value] into [bytes], returns how many it took.
+	static size_t encode_varint(uint64_t value, word_t (&bytes)[MAX_VARINT_SIZE]);
+
+	void detach();
+
+	void spill(size_t new_size);
+
+	word_t const* storage() const;
+
 	// read
 	void read(word_t* dst, size_t size);
 
@@ -71,8 +149,36 @@ public:
 
 	Buffer& operator=(Buffer&&) noexcept = default;
 
+	/**
+	 * \brief Read-only window of [length] bytes at [begin] of [slab], sharing its storage instead of copying it.
+	 * Anything writing to the buffer or taking its array copies the window out first.
+	 */
+	static Buffer view(std::shared_ptr<const ByteArray> slab, size_t begin, size_t length);
+
+	/**
+	 * \brief Buffer of at least [initial_size] bytes taking its storage from ByteArrayPool, and growing through it.
+	 * Its array is meant to be handed back with ByteArrayPool::release once consumed.
+	 */
+	static Buffer pooled(size_t initial_size = 16);
+
 	// endregion
 
+	bool is_view() const;
+
+	/**
+	 * \brief Whether packed integers are LEB128 rather than fixed width. Set by the wire for protocols that negotiated it.
+	 */
+	void set_compact(bool value);
+
+	bool is_compact() const;
+
+	/**
+	 * \brief Records where the packed fields written from now on are into [layout], until reset to null.
+	 */
+	void set_packed_layout(packed_layout* layout);
+
+	packed_layout* get_packed_layout() const;
+
 	size_t get_position() const;
 
 	void set_position(size_t value);
@@ -97,6 +203,53 @@ public:
 		write(reinterpret_cast<word_t const*>(&value), sizeof(T));
 	}
 
+	/**
+	 * \brief Used for lengths, enums, interned indices and integral values: fixed width like write_integral by default,
+	 * LEB128 on compact buffers, zigzag encoded first for signed types so that small negative values stay short.
+	 * Placeholders patched after the fact must keep using write_integral.
+	 */
+	template <typename T, typename = typename std::enable_if_t<std::is_integral<T>::value>>
+	void write_packed(T const& value)
+	{
+		if (compact_ && sizeof(T) > 1)
+		{
+			write_varint(std::is_signed<T>::value ? zigzag_encode(static_cast<int64_t>(value)) : static_cast<uint64_t>(value));
+		}
+		else
+		{
+			if (layout_ != nullptr && sizeof(T) > 1)
+			{
+				layout_->fields.push_back({static_cast<uint32_t>(offset), static_cast<uint8_t>(sizeof(T)), std::is_signed<T>::value});
+			}
+			write_integral<T>(value);
+		}
+	}
+
+	template <typename T, typename = typename std::enable_if_t<std::is_integral<T>::value, T>>
+	T read_packed()
+	{
+		if (compact_ && sizeof(T) > 1)
+		{
+			const uint64_t value = read_varint();
+			return static_cast<T>(std::is_signed<T>::value ? static_cast<uint64_t>(zigzag_decode(value)) : value);
+		}
+		return read_integral<T>();
+	}
+
+	void write_varint(uint64_t value);
+
+	uint64_t read_varint();
+
+	static constexpr uint64_t zigzag_encode(int64_t value)
+	{
+		return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+	}
+
+	static constexpr int64_t zigzag_decode(uint64_t value)
+	{
+		return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+	}
+
 	template <typename T, typename = typename std::enable_if_t<std::is_floating_point<T>::value, T>>
 	T read_floating_point()
 	{
@@ -115,7 +268,7 @@ public:
 		typename = typename std::enable_if_t<util::is_pod_v<T>>>
 	C<T, A> read_array()
 	{
-		int32_t len = read_integral<int32_t>();
+		int32_t len = read_packed<int32_t>();
 		RD_ASSERT_MSG(len >= 0, "read null array(length = " + std::to_string(len) + ")");
 		C<T, A> result;
 		using rd::resize;
@@ -130,7 +283,7 @@ public:
 	template <template <class, class> class C, typename T, typename A = allocator<value_or_wrapper<T>>>
 	C<value_or_wrapper<T>, A> read_array(std::function<value_or_wrapper<T>()> reader)
 	{
-		int32_t len = read_integral<int32_t>();
+		int32_t len = read_packed<int32_t>();
 		C<value_or_wrapper<T>, A> result;
 		using rd::resize;
 		resize(result, len);
@@ -147,7 +300,7 @@ public:
 	{
 		using rd::size;
 		const int32_t& len = rd::size(container);
-		write_integral<int32_t>(static_cast<int32_t>(len));
+		write_packed<int32_t>(static_cast<int32_t>(len));
 		if (len > 0)
 		{
 			write(reinterpret_cast<word_t const*>(&container[0]), sizeof(T) * len);
@@ -159,7 +312,7 @@ public:
 	void write_array(C<T, A> const& container, std::function<void(T const&)> writer)
 	{
 		using rd::size;
-		write_integral<int32_t>(size(container));
+		write_packed<int32_t>(size(container));
 		for (auto const& e : container)
 		{
 			writer(e);
@@ -170,7 +323,7 @@ public:
 	void write_array(C<Wrapper<T>, A> const& container, std::function<void(T const&)> writer)
 	{
 		using rd::size;
-		write_integral<int32_t>(size(container));
+		write_packed<int32_t>(size(container));
 		for (auto const& e : container)
 		{
 			writer(*e);
@@ -214,27 +367,27 @@ public:
 	template <typename T, typename = typename std::enable_if_t<util::is_enum_v<T>>>
 	T read_enum()
 	{
-		int32_t x = read_integral<int32_t>();
+		int32_t x = read_packed<int32_t>();
 		return static_cast<T>(x);
 	}
 
 	template <typename T, typename = typename std::enable_if_t<util::is_enum_v<T>>>
 	void write_enum(T const& x)
 	{
-		write_integral<int32_t>(static_cast<int32_t>(x));
+		write_packed<int32_t>(static_cast<int32_t>(x));
 	}
 
 	template <typename T, typename = typename std::enable_if_t<util::is_enum_v<T>>>
 	T read_enum_set()
 	{
-		int32_t x = read_integral<int32_t>();
+		int32_t x = read_packed<int32_t>();
 		return static_cast<T>(x);
 	}
 
 	template <typename T, typename = typename std::enable_if_t<util::is_enum_v<T>>>
 	void write_enum_set(T const& x)
 	{
-		write_integral<int32_t>(static_cast<int32_t>(x));
+		write_packed<int32_t>(static_cast<int32_t>(x));
 	}
 
 	template <typename T, typename F, typename = typename std::enable_if_t<util::is_same_v<typename util::result_of_t<F()>, T>>>
@@ -303,6 +456,9 @@ public:
 		}
 	}
 
+	/**
+	 * \brief Every byte written, or given on construction, whatever the current position. getRealArray() stops at the position.
+	 */
 	ByteArray getArray() const&;
 
 	ByteArray getArray() &&;
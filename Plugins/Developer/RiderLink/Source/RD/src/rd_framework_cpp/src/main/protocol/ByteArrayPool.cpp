@@ -0,0 +1,142 @@
+#include "protocol/ByteArrayPool.h"
+
+#include <mutex>
+
+namespace rd
+{
+constexpr size_t ByteArrayPool::MIN_CLASS_SIZE;
+constexpr size_t ByteArrayPool::MAX_CLASS_SIZE;
+constexpr size_t ByteArrayPool::CLASS_COUNT;
+constexpr size_t ByteArrayPool::LOCAL_CACHE_SIZE;
+constexpr size_t ByteArrayPool::SHARED_STASH_SIZE;
+
+namespace
+{
+using ByteArray = Buffer::ByteArray;
+
+using Classes = std::vector<ByteArray>[ByteArrayPool::CLASS_COUNT];
+
+struct SharedStash
+{
+	std::mutex lock;
+	Classes classes;
+
+	SharedStash()
+	{
+		for (auto& arrays : classes)
+		{
+			arrays.reserve(ByteArrayPool::SHARED_STASH_SIZE);
+		}
+	}
+};
+
+struct LocalCache
+{
+	Classes classes;
+
+	LocalCache()
+	{
+		for (auto& arrays : classes)
+		{
+			arrays.reserve(ByteArrayPool::LOCAL_CACHE_SIZE);
+		}
+	}
+};
+
+SharedStash& shared_stash()
+{
+	static SharedStash stash;
+	return stash;
+}
+
+// Whatever a thread still caches when it exits is freed.
+thread_local LocalCache local_cache;
+
+size_t class_size(size_t size_class)
+{
+	return ByteArrayPool::MIN_CLASS_SIZE << size_class;
+}
+
+// Smallest class holding [size] bytes.
+size_t class_for_size(size_t size)
+{
+	size_t size_class = 0;
+	while (class_size(size_class) < size)
+	{
+		++size_class;
+	}
+	return size_class;
+}
+
+// Largest class [capacity] bytes can serve.
+size_t class_for_capacity(size_t capacity)
+{
+	size_t size_class = 0;
+	while (size_class + 1 < ByteArrayPool::CLASS_COUNT && class_size(size_class + 1) <= capacity)
+	{
+		++size_class;
+	}
+	return size_class;
+}
+
+// Moves arrays from the back of [from] to [to] until [from] is down to [keep] or [to] is up to [limit].
+void transfer(std::vector<ByteArray>& from, std::vector<ByteArray>& to, size_t keep, size_t limit)
+{
+	while (from.size() > keep && to.size() < limit)
+	{
+		to.push_back(std::move(from.back()));
+		from.pop_back();
+	}
+}
+}	 // namespace
+
+ByteArray ByteArrayPool::acquire(size_t size)
+{
+	if (size > MAX_CLASS_SIZE)
+	{
+		return ByteArray(size);
+	}
+
+	const size_t size_class = class_for_size(size);
+	auto& local = local_cache.classes[size_class];
+	if (local.empty())
+	{
+		auto& stash = shared_stash();
+		std::lock_guard<decltype(stash.lock)> guard(stash.lock);
+		transfer(stash.classes[size_class], local, 0, LOCAL_CACHE_SIZE / 2);
+	}
+
+	if (local.empty())
+	{
+		return ByteArray(class_size(size_class));
+	}
+
+	ByteArray result = std::move(local.back());
+	local.pop_back();
+	result.resize(class_size(size_class));
+	return result;
+}
+
+void ByteArrayPool::release(ByteArray array)
+{
+	const size_t capacity = array.capacity();
+	if (capacity < MIN_CLASS_SIZE || capacity >= 2 * MAX_CLASS_SIZE)
+	{
+		return;
+	}
+
+	const size_t size_class = class_for_capacity(capacity);
+	auto& local = local_cache.classes[size_class];
+	if (local.size() == LOCAL_CACHE_SIZE)
+	{
+		// Half goes to the stash for threads acquiring more than they release, anything over the stash limit is freed.
+		auto& stash = shared_stash();
+		std::lock_guard<decltype(stash.lock)> guard(stash.lock);
+		transfer(local, stash.classes[size_class], LOCAL_CACHE_SIZE / 2, SHARED_STASH_SIZE);
+		local.resize(LOCAL_CACHE_SIZE / 2);
+	}
+
+	array.clear();
+	local.push_back(std::move(array));
+}
+}	 // namespace rd
@@ -0,0 +1,47 @@
+#ifndef RD_CPP_BYTEARRAYPOOL_H
+#define RD_CPP_BYTEARRAYPOOL_H
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable:4251)
+#endif
+
+#include "protocol/Buffer.h"
+
+#include <rd_framework_export.h>
+
+namespace rd
+{
+/**
+ * \brief Recycles the storage of byte arrays in power of two size classes, so that buffers built and dropped all the time
+ * (e.g. outgoing packages) stop hitting the heap once warmed up.
+ * Each thread keeps a small cache per class and trades with a shared stash when it runs empty or full,
+ * which lets storage acquired on one thread be released on another.
+ */
+class RD_FRAMEWORK_API ByteArrayPool
+{
+public:
+	static constexpr size_t MIN_CLASS_SIZE = 1u << 8;
+	static constexpr size_t MAX_CLASS_SIZE = 1u << 16;
+	static constexpr size_t CLASS_COUNT = 9;
+
+	static constexpr size_t LOCAL_CACHE_SIZE = 16;
+	static constexpr size_t SHARED_STASH_SIZE = 256;
+
+	/**
+	 * \brief Array of at least [size] bytes, sized up to its class. Arrays larger than MAX_CLASS_SIZE are not pooled.
+	 */
+	static Buffer::ByteArray acquire(size_t size);
+
+	/**
+	 * \brief Takes back the storage of [array], whatever its content. Storage too small or too large for any class is freed.
+	 */
+	static void release(Buffer::ByteArray array);
+};
+}	 // namespace rd
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+
+#endif	  // RD_CPP_BYTEARRAYPOOL_H
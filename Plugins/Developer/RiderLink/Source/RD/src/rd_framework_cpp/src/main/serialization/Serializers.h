@@ -16,6 +16,7 @@
 
 #include "std/unordered_map.h"
 
+#include <type_traits>
 #include <utility>
 #include <iostream>
 #include <unordered_set>
@@ -130,6 +131,15 @@ void Serializers::writePolymorphicNullable(SerializationCtx& ctx, Buffer& buffer
 	buffer.set_position(static_cast<size_t>(length_tag_position));
 	buffer.write_integral<int32_t>(object_end_position - object_start_position);
 	buffer.set_position(static_cast<size_t>(object_end_position));
+	if (Buffer::packed_layout* layout = buffer.get_packed_layout())
+	{
+		layout->length_tags.push_back({static_cast<uint32_t>(length_tag_position), static_cast<uint32_t>(object_end_position)});
+		// Unknown instances write back the raw bytes they were read with, where their packed fields are isn't known.
+		if constexpr (std::is_polymorphic<T>::value)
+		{
+			layout->opaque |= dynamic_cast<IUnknownInstance const*>(&value) != nullptr;
+		}
+	}
 }
 
 template <typename T>
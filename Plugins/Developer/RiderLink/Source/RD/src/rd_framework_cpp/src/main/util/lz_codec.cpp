@@ -0,0 +1,179 @@
+#include "lz_codec.h"
+
+#include <cstring>
+
+namespace rd
+{
+namespace util
+{
+namespace
+{
+constexpr size_t MIN_MATCH = 4;
+// The format requires the last match to start this far from the end, and the last bytes to be literals.
+constexpr size_t MF_LIMIT = 12;
+constexpr size_t LAST_LITERALS = 5;
+constexpr size_t MAX_OFFSET = 65535;
+
+constexpr int HASH_LOG = 12;
+
+uint32_t read32(const uint8_t* p)
+{
+	uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+uint32_t hash(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+// Writes the 15+ remainder of a token field.
+bool write_length(uint8_t*& op, const uint8_t* end, size_t length)
+{
+	for (; length >= 255; length -= 255)
+	{
+		if (op == end)
+			return false;
+		*op++ = 255;
+	}
+	if (op == end)
+		return false;
+	*op++ = static_cast<uint8_t>(length);
+	return true;
+}
+
+bool read_length(const uint8_t*& ip, const uint8_t* end, size_t& length)
+{
+	uint8_t byte;
+	do
+	{
+		if (ip == end)
+			return false;
+		byte = *ip++;
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+bool write_sequence(uint8_t*& op, const uint8_t* end, const uint8_t* literals, size_t literal_count, size_t offset, size_t match_length)
+{
+	if (op == end)
+		return false;
+	uint8_t* token = op++;
+
+	*token = static_cast<uint8_t>((literal_count >= 15 ? 15 : literal_count) << 4);
+	if (literal_count >= 15 && !write_length(op, end, literal_count - 15))
+		return false;
+	if (static_cast<size_t>(end - op) < literal_count)
+		return false;
+	std::memcpy(op, literals, literal_count);
+	op += literal_count;
+
+	// The last sequence only has literals.
+	if (match_length == 0)
+		return true;
+
+	if (end - op < 2)
+		return false;
+	*op++ = static_cast<uint8_t>(offset);
+	*op++ = static_cast<uint8_t>(offset >> 8);
+
+	const size_t match_code = match_length - MIN_MATCH;
+	*token |= static_cast<uint8_t>(match_code >= 15 ? 15 : match_code);
+	return match_code < 15 || write_length(op, end, match_code - 15);
+}
+}	 // namespace
+
+size_t lz_compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity)
+{
+	uint8_t* op = dst;
+	const uint8_t* const end = dst + capacity;
+	size_t anchor = 0;
+
+	if (size > MF_LIMIT)
+	{
+		uint32_t table[1u << HASH_LOG] = {};
+		const size_t match_start_limit = size - MF_LIMIT;
+		const size_t match_end_limit = size - LAST_LITERALS;
+
+		size_t ip = 0;
+		while (ip < match_start_limit)
+		{
+			const uint32_t sequence = read32(src + ip);
+			uint32_t& slot = table[hash(sequence)];
+			const size_t ref = slot;
+			slot = static_cast<uint32_t>(ip);
+
+			if (ref >= ip || ip - ref > MAX_OFFSET || read32(src + ref) != sequence)
+			{
+				++ip;
+				continue;
+			}
+
+			size_t length = MIN_MATCH;
+			while (ip + length < match_end_limit && src[ref + length] == src[ip + length])
+			{
+				++length;
+			}
+
+			if (!write_sequence(op, end, src + anchor, ip - anchor, ip - ref, length))
+				return 0;
+			ip += length;
+			anchor = ip;
+		}
+	}
+
+	if (!write_sequence(op, end, src + anchor, size - anchor, 0, 0))
+		return 0;
+	return static_cast<size_t>(op - dst);
+}
+
+bool lz_decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t raw_size)
+{
+	const uint8_t* ip = src;
+	const uint8_t* const ip_end = src + size;
+	uint8_t* op = dst;
+	uint8_t* const op_end = dst + raw_size;
+
+	while (ip < ip_end)
+	{
+		const uint8_t token = *ip++;
+
+		size_t literal_count = token >> 4;
+		if (literal_count == 15 && !read_length(ip, ip_end, literal_count))
+			return false;
+		if (static_cast<size_t>(ip_end - ip) < literal_count || static_cast<size_t>(op_end - op) < literal_count)
+			return false;
+		std::memcpy(op, ip, literal_count);
+		ip += literal_count;
+		op += literal_count;
+
+		if (ip == ip_end)
+			break;
+
+		if (ip_end - ip < 2)
+			return false;
+		const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+		ip += 2;
+		if (offset == 0 || offset > static_cast<size_t>(op - dst))
+			return false;
+
+		size_t match_length = token & 15;
+		if (match_length == 15 && !read_length(ip, ip_end, match_length))
+			return false;
+		match_length += MIN_MATCH;
+		if (static_cast<size_t>(op_end - op) < match_length)
+			return false;
+
+		// Matches may overlap their own output, copy byte by byte.
+		const uint8_t* match = op - offset;
+		for (size_t i = 0; i < match_length; ++i)
+		{
+			*op++ = match[i];
+		}
+	}
+	return op == op_end;
+}
+}	 // namespace util
+}	 // namespace rd
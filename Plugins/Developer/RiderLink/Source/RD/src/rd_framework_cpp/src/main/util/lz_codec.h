@@ -0,0 +1,25 @@
+#ifndef RD_CPP_LZ_CODEC_H
+#define RD_CPP_LZ_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rd
+{
+namespace util
+{
+/**
+ * \brief Greedy single pass compressor producing the LZ4 block format, tuned for speed rather than ratio.
+ * Writes at most [capacity] bytes to [dst] and returns how many, or 0 if the result doesn't fit.
+ */
+size_t lz_compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+
+/**
+ * \brief Decompresses the LZ4 block [src] into exactly [raw_size] bytes at [dst].
+ * Returns false on malformed input, never reading or writing out of bounds.
+ */
+bool lz_decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t raw_size);
+}	 // namespace util
+}	 // namespace rd
+
+#endif	  // RD_CPP_LZ_CODEC_H
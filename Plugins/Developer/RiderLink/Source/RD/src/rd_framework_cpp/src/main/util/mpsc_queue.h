@@ -0,0 +1,174 @@
+#ifndef RD_CPP_MPSC_QUEUE_H
+#define RD_CPP_MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace rd
+{
+namespace util
+{
+/**
+ * \brief Multi producer, single consumer FIFO. Pushes go to a bounded lock-free ring (Vyukov's bounded queue),
+ * and only spill to a mutex protected overflow list while the ring is full, so steady state pushes neither lock nor allocate.
+ * Items pushed by one thread are popped in the order they were pushed.
+ */
+template <typename T>
+class mpsc_queue
+{
+	struct cell
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	std::unique_ptr<cell[]> cells;
+	const size_t mask;
+
+	alignas(64) std::atomic<size_t> enqueue_pos{0};
+	alignas(64) size_t dequeue_pos = 0;
+
+	// Set while overflow holds items: pushes go there too until the consumer drained it, to keep each producer's order.
+	std::atomic<bool> overflowing{false};
+	std::mutex overflow_lock;
+	std::deque<T> overflow;
+
+	bool try_push_ring(T& value)
+	{
+		size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+		while (true)
+		{
+			cell& c = cells[pos & mask];
+			const size_t sequence = c.sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+			if (diff == 0)
+			{
+				if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					c.value = std::move(value);
+					c.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool try_pop_ring(T& out)
+	{
+		cell& c = cells[dequeue_pos & mask];
+		if (c.sequence.load(std::memory_order_acquire) != dequeue_pos + 1)
+		{
+			return false;
+		}
+		out = std::move(c.value);
+		c.sequence.store(dequeue_pos + mask + 1, std::memory_order_release);
+		++dequeue_pos;
+		return true;
+	}
+
+public:
+	/**
+	 * \brief [capacity] of the ring, rounded up to a power of two.
+	 */
+	explicit mpsc_queue(size_t capacity) : mask(round_up(capacity) - 1)
+	{
+		cells.reset(new cell[mask + 1]);
+		for (size_t i = 0; i <= mask; ++i)
+		{
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	mpsc_queue(mpsc_queue const&) = delete;
+
+	mpsc_queue& operator=(mpsc_queue const&) = delete;
+
+	/**
+	 * \brief Any thread.
+	 */
+	void push(T value)
+	{
+		if (!overflowing.load(std::memory_order_acquire) && try_push_ring(value))
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> guard(overflow_lock);
+		if (!overflowing.load(std::memory_order_relaxed) && try_push_ring(value))
+		{
+			return;
+		}
+		overflow.push_back(std::move(value));
+		overflowing.store(true, std::memory_order_release);
+	}
+
+	/**
+	 * \brief Consumer thread only.
+	 */
+	bool try_pop(T& out)
+	{
+		if (try_pop_ring(out))
+		{
+			return true;
+		}
+
+		if (!overflowing.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> guard(overflow_lock);
+		// Whatever producers put in the ring before spilling goes first. The ring may have been filled since it was found
+		// empty above, or still have a push in progress, whose producer signals it.
+		if (enqueue_pos.load(std::memory_order_relaxed) != dequeue_pos)
+		{
+			return try_pop_ring(out);
+		}
+		if (overflow.empty())
+		{
+			return false;
+		}
+		out = std::move(overflow.front());
+		overflow.pop_front();
+		if (overflow.empty())
+		{
+			overflowing.store(false, std::memory_order_release);
+		}
+		return true;
+	}
+
+	/**
+	 * \brief Consumer thread only. May miss an item whose push is still in progress, its producer is expected to signal it.
+	 */
+	bool empty() const
+	{
+		return cells[dequeue_pos & mask].sequence.load(std::memory_order_acquire) != dequeue_pos + 1 &&
+			   !overflowing.load(std::memory_order_acquire);
+	}
+
+private:
+	static size_t round_up(size_t capacity)
+	{
+		size_t result = 2;
+		while (result < capacity)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+};
+}	 // namespace util
+}	 // namespace rd
+
+#endif	  // RD_CPP_MPSC_QUEUE_H
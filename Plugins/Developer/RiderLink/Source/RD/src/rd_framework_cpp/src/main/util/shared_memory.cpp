@@ -0,0 +1,310 @@
+#include "shared_memory.h"
+
+#include "util/core_util.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <ctime>
+#endif
+
+namespace rd
+{
+namespace util
+{
+namespace
+{
+#ifdef _WIN32
+std::string system_name(std::string const& name)
+{
+	return "Local\\" + name;
+}
+#else
+std::string system_name(std::string const& name)
+{
+	return "/" + name;
+}
+#endif
+}	 // namespace
+
+shared_memory_segment::shared_memory_segment(shared_memory_segment&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+shared_memory_segment& shared_memory_segment::operator=(shared_memory_segment&& other) noexcept
+{
+	if (this != &other)
+	{
+		reset();
+		name = std::move(other.name);
+		address = std::exchange(other.address, nullptr);
+		size = std::exchange(other.size, 0);
+		owner = std::exchange(other.owner, false);
+#ifdef _WIN32
+		mapping = std::exchange(other.mapping, nullptr);
+#endif
+	}
+	return *this;
+}
+
+shared_memory_segment::~shared_memory_segment()
+{
+	reset();
+}
+
+#ifdef _WIN32
+
+void shared_memory_segment::reset()
+{
+	if (address != nullptr)
+	{
+		UnmapViewOfFile(address);
+		address = nullptr;
+	}
+	if (mapping != nullptr)
+	{
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+	// The mapping goes away with its last handle.
+	owner = false;
+	size = 0;
+}
+
+shared_memory_segment shared_memory_segment::create(std::string const& name, size_t size, bool replace)
+{
+	shared_memory_segment result;
+	result.name = name;
+	result.owner = true;
+	result.mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(uint64_t(size) >> 32),
+		static_cast<DWORD>(size & 0xFFFFFFFFu), system_name(name).c_str());
+	// Still open by a counterpart of a crashed process when replacing: it's reused, cleared.
+	const bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+	RD_ASSERT_THROW_MSG(result.mapping != nullptr, "failed to create shared memory segment " + name + ", error " + std::to_string(GetLastError()))
+	if (existed && !replace)
+	{
+		result.reset();
+		return result;
+	}
+
+	result.address = MapViewOfFile(result.mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	RD_ASSERT_THROW_MSG(result.address != nullptr, "failed to map shared memory segment " + name + ", error " + std::to_string(GetLastError()))
+	result.size = size;
+	if (existed)
+	{
+		std::memset(result.address, 0, size);
+	}
+	return result;
+}
+
+shared_memory_segment shared_memory_segment::open(std::string const& name)
+{
+	shared_memory_segment result;
+	result.name = name;
+	result.mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, system_name(name).c_str());
+	if (result.mapping == nullptr)
+	{
+		return result;
+	}
+	result.address = MapViewOfFile(result.mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (result.address == nullptr)
+	{
+		result.reset();
+		return result;
+	}
+	MEMORY_BASIC_INFORMATION info{};
+	VirtualQuery(result.address, &info, sizeof(info));
+	result.size = info.RegionSize;
+	return result;
+}
+
+shared_memory_signal::shared_memory_signal(std::atomic<uint32_t>* word, std::string const& name)
+	: word(word), event(CreateEventA(nullptr, FALSE, FALSE, system_name(name).c_str()))
+{
+	RD_ASSERT_THROW_MSG(event != nullptr, "failed to create event " + name + ", error " + std::to_string(GetLastError()))
+}
+
+shared_memory_signal::~shared_memory_signal()
+{
+	if (event != nullptr)
+	{
+		CloseHandle(event);
+	}
+}
+
+void shared_memory_signal::wait(uint32_t expected, std::chrono::milliseconds timeout) const
+{
+	if (word->load(std::memory_order_acquire) == expected)
+	{
+		WaitForSingleObject(event, static_cast<DWORD>(timeout.count()));
+	}
+}
+
+void shared_memory_signal::notify() const
+{
+	word->fetch_add(1, std::memory_order_acq_rel);
+	SetEvent(event);
+}
+
+#else
+
+void shared_memory_segment::reset()
+{
+	if (address != nullptr)
+	{
+		munmap(address, size);
+		address = nullptr;
+	}
+	// Mappings outlive the name, a counterpart still attached keeps working.
+	if (owner)
+	{
+		shm_unlink(system_name(name).c_str());
+		owner = false;
+	}
+	size = 0;
+}
+
+shared_memory_segment shared_memory_segment::create(std::string const& name, size_t size, bool replace)
+{
+	const std::string path = system_name(name);
+	if (replace)
+	{
+		// Mappings outlive the name: whoever still has the old one mapped keeps it, apart from this one.
+		shm_unlink(path.c_str());
+	}
+
+	shared_memory_segment result;
+	const int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+	if (fd == -1 && errno == EEXIST)
+	{
+		return result;
+	}
+	RD_ASSERT_THROW_MSG(fd != -1, "failed to create shared memory segment " + name + ": " + std::strerror(errno))
+
+	result.name = name;
+	result.owner = true;
+	// Extending the file zero fills it.
+	if (ftruncate(fd, static_cast<off_t>(size)) == 0)
+	{
+		void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (address != MAP_FAILED)
+		{
+			result.address = address;
+			result.size = size;
+		}
+	}
+	const int error = errno;
+	close(fd);
+	RD_ASSERT_THROW_MSG(result.is_valid(), "failed to map shared memory segment " + name + ": " + std::strerror(error))
+	return result;
+}
+
+shared_memory_segment shared_memory_segment::open(std::string const& name)
+{
+	shared_memory_segment result;
+	result.name = name;
+
+	const int fd = shm_open(system_name(name).c_str(), O_RDWR, 0);
+	if (fd == -1)
+	{
+		return result;
+	}
+	struct stat info
+	{
+	};
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+	{
+		void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (address != MAP_FAILED)
+		{
+			result.address = address;
+			result.size = static_cast<size_t>(info.st_size);
+		}
+	}
+	close(fd);
+	return result;
+}
+
+shared_memory_signal::shared_memory_signal(std::atomic<uint32_t>* word, std::string const&) : word(word)
+{
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && ATOMIC_INT_LOCK_FREE == 2,
+		"shared memory words must be plain lock free integers");
+}
+
+shared_memory_signal::~shared_memory_signal() = default;
+
+#ifdef __linux__
+
+void shared_memory_signal::wait(uint32_t expected, std::chrono::milliseconds timeout) const
+{
+	timespec ts{};
+	ts.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+	ts.tv_nsec = static_cast<long>(timeout.count() % 1000 * 1000000);
+	// Not FUTEX_PRIVATE: the word is shared with another process.
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+void shared_memory_signal::notify() const
+{
+	word->fetch_add(1, std::memory_order_acq_rel);
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+void shared_memory_signal::wait(uint32_t expected, std::chrono::milliseconds timeout) const
+{
+	// No cross process futex here: a short nap, callers check their condition again anyway.
+	if (word->load(std::memory_order_acquire) == expected)
+	{
+		std::this_thread::sleep_for((std::min)(std::chrono::microseconds(timeout), std::chrono::microseconds(200)));
+	}
+}
+
+void shared_memory_signal::notify() const
+{
+	word->fetch_add(1, std::memory_order_acq_rel);
+}
+
+#endif
+
+#endif
+
+shared_memory_signal::shared_memory_signal(shared_memory_signal&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+shared_memory_signal& shared_memory_signal::operator=(shared_memory_signal&& other) noexcept
+{
+	if (this != &other)
+	{
+		word = std::exchange(other.word, nullptr);
+#ifdef _WIN32
+		if (event != nullptr)
+		{
+			CloseHandle(event);
+		}
+		event = std::exchange(other.event, nullptr);
+#endif
+	}
+	return *this;
+}
+}	 // namespace util
+}	 // namespace rd
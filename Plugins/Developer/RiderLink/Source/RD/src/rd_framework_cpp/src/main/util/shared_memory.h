@@ -0,0 +1,122 @@
+#ifndef RD_CPP_SHARED_MEMORY_H
+#define RD_CPP_SHARED_MEMORY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rd
+{
+namespace util
+{
+/**
+ * \brief Named memory segment shared by the processes of this host, unmapped on destruction.
+ * Names are kept short: macOS limits them to 31 characters.
+ */
+class shared_memory_segment
+{
+	std::string name;
+	void* address = nullptr;
+	size_t size = 0;
+	// The creator removes the name on destruction.
+	bool owner = false;
+#ifdef _WIN32
+	void* mapping = nullptr;
+#endif
+
+	void reset();
+
+public:
+	// region ctor/dtor
+
+	shared_memory_segment() = default;
+
+	shared_memory_segment(shared_memory_segment const&) = delete;
+
+	shared_memory_segment(shared_memory_segment&& other) noexcept;
+
+	shared_memory_segment& operator=(shared_memory_segment&& other) noexcept;
+
+	~shared_memory_segment();
+
+	// endregion
+
+	/**
+	 * \brief Creates the zero filled segment [name] of [size] bytes. The result isn't valid if [name] is taken, unless
+	 * [replace]: it's up to the caller to tell the existing segment was left by a crashed process. Throws if it can't.
+	 */
+	static shared_memory_segment create(std::string const& name, size_t size, bool replace = false);
+
+	/**
+	 * \brief Maps the whole existing segment [name], the result isn't valid if there is none.
+	 */
+	static shared_memory_segment open(std::string const& name);
+
+	bool is_valid() const
+	{
+		return address != nullptr;
+	}
+
+	void* data() const
+	{
+		return address;
+	}
+
+	size_t get_size() const
+	{
+		return size;
+	}
+};
+
+/**
+ * \brief Cross process wait and notify on a 32 bit word of a shared memory segment.
+ * A futex on Linux, a named auto reset event on Windows and short sleeps elsewhere, meant for a single waiter.
+ */
+class shared_memory_signal
+{
+	std::atomic<uint32_t>* word = nullptr;
+#ifdef _WIN32
+	void* event = nullptr;
+#endif
+
+public:
+	// region ctor/dtor
+
+	shared_memory_signal() = default;
+
+	/**
+	 * \brief [name] identifies the signal across processes where the word alone can't.
+	 */
+	shared_memory_signal(std::atomic<uint32_t>* word, std::string const& name);
+
+	shared_memory_signal(shared_memory_signal const&) = delete;
+
+	shared_memory_signal(shared_memory_signal&& other) noexcept;
+
+	shared_memory_signal& operator=(shared_memory_signal&& other) noexcept;
+
+	~shared_memory_signal();
+
+	// endregion
+
+	/**
+	 * \brief Waits for a notify while the word is still [expected], at most [timeout]. May return spuriously.
+	 */
+	void wait(uint32_t expected, std::chrono::milliseconds timeout) const;
+
+	/**
+	 * \brief Bumps the word and wakes the waiter.
+	 */
+	void notify() const;
+
+	uint32_t load() const
+	{
+		return word->load(std::memory_order_acquire);
+	}
+};
+}	 // namespace util
+}	 // namespace rd
+
+#endif	  // RD_CPP_SHARED_MEMORY_H
@@ -1,22 +1,28 @@
 #include "ByteBufferAsyncProcessor.h"
 
-#include "util/guards.h"
+#include "protocol/ByteArrayPool.h"
+
 #include <util/thread_util.h>
 
+#include <algorithm>
+
 #include "spdlog/sinks/stdout_color_sinks.h"
 
 namespace rd
 {
-size_t ByteBufferAsyncProcessor::INITIAL_CAPACITY = 1024 * 1024;
+size_t ByteBufferAsyncProcessor::INITIAL_CAPACITY = 4096;
+
+constexpr size_t ByteBufferAsyncProcessor::DEFAULT_MAX_BATCH_SIZE;
+constexpr size_t ByteBufferAsyncProcessor::DEFAULT_MAX_WINDOW_BYTES;
+constexpr size_t ByteBufferAsyncProcessor::DEFAULT_MAX_WINDOW_PACKAGES;
+constexpr int64_t ByteBufferAsyncProcessor::DEFAULT_BLOCK_TIMEOUT_MS;
 
 std::shared_ptr<spdlog::logger> ByteBufferAsyncProcessor::logger =
 	spdlog::stderr_color_mt<spdlog::synchronous_factory>("byteBufferLog", spdlog::color_mode::automatic);
 
-ByteBufferAsyncProcessor::ByteBufferAsyncProcessor(
-	std::string id, std::function<bool(Buffer::ByteArray const&, sequence_number_t)> processor)
+ByteBufferAsyncProcessor::ByteBufferAsyncProcessor(std::string id, processor_t processor)
 	: id(std::move(id)), processor(std::move(processor))
 {
-	data.reserve(INITIAL_CAPACITY);
 }
 
 void ByteBufferAsyncProcessor::cleanup0()
@@ -28,7 +34,9 @@ void ByteBufferAsyncProcessor::cleanup0()
 	}
 	// TO-DO clean data
 
-	cv.notify_all();
+	wake();
+	std::lock_guard<decltype(window_lock)> guard(window_lock);
+	window_cv.notify_all();
 }
 
 bool ByteBufferAsyncProcessor::terminate0(time_t timeout, StateKind state_to_set, string_view action)
@@ -50,7 +58,11 @@ bool ByteBufferAsyncProcessor::terminate0(time_t timeout, StateKind state_to_set
 
 		state = state_to_set;
 	}
-	cv.notify_all();
+	wake();
+	{
+		std::lock_guard<decltype(window_lock)> guard(window_lock);
+		window_cv.notify_all();
+	}
 
 	std::future_status status = async_future.wait_for(timeout);
 
@@ -67,63 +79,212 @@ bool ByteBufferAsyncProcessor::terminate0(time_t timeout, StateKind state_to_set
 	return success;
 }
 
-void ByteBufferAsyncProcessor::add_data(std::vector<Buffer::ByteArray>&& new_data)
+void ByteBufferAsyncProcessor::wake()
 {
-	std::lock_guard<decltype(queue_lock)> guard(queue_lock);
-	std::move(new_data.begin(), new_data.end(), std::back_inserter(queue));
-	//		for (auto &&item : new_data) {
-	//			queue.emplace(std::move(item));
-	//		}
+	std::lock_guard<decltype(wake_lock)> guard(wake_lock);
+	wake_cv.notify_all();
 }
 
-bool ByteBufferAsyncProcessor::reprocess()
+bool ByteBufferAsyncProcessor::park()
 {
+	std::unique_lock<decltype(wake_lock)> ul(wake_lock);
+	parked.store(true);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// Anything happening from here on is signaled, anything that happened before has to be checked for.
+	if (state >= StateKind::Stopping)
+	{
+		parked.store(false);
+		return false;
+	}
+	bool resumed;
+	{
+		std::lock_guard<decltype(processing_lock)> guard(processing_lock);
+		resumed = reprocess_requested && interrupt_balance == 0;
+	}
+	// Acknowledged packages are released right away, blocked producers may be waiting for the room.
+	const bool acknowledged = !pending_queue.empty() && current_seqn <= acknowledged_seqn;
+	if (!resumed && !acknowledged && incoming.empty())
 	{
-		std::lock_guard<decltype(queue_lock)> guard(queue_lock);
+		wake_cv.wait(ul);
+		logger->debug("{}'s ThreadProc waited for notify", id);
+	}
+	parked.store(false);
 
-		logger->debug("{}: reprocessing started", id);
+	return state < StateKind::Terminating;
+}
 
-		std::unique_lock<decltype(processing_lock)> ul(processing_lock);
-		processing_cv.wait(ul, [this]() -> bool { return !in_processing; });
+void ByteBufferAsyncProcessor::drop_acknowledged()
+{
+	const sequence_number_t acknowledged = acknowledged_seqn;
+	size_t bytes = 0;
+	size_t packages = 0;
+	while (current_seqn <= acknowledged && !pending_queue.empty())
+	{
+		bytes += pending_queue.front().size();
+		++packages;
+		ByteArrayPool::release(std::move(pending_queue.front()));
+		pending_queue.pop_front();
+		++current_seqn;
+	}
+	if (packages == 0)
+	{
+		return;
+	}
+
+	window_bytes -= bytes;
+	window_packages -= packages;
+	std::lock_guard<decltype(window_lock)> guard(window_lock);
+	if (window_waiters > 0)
+	{
+		window_cv.notify_all();
+	}
+}
 
-		logger->debug("{}: reprocessing waited for main processing", id);
+bool ByteBufferAsyncProcessor::fits(size_t size) const
+{
+	const size_t packages = window_packages;
+	return packages == 0 || (packages < max_window_packages && window_bytes + size <= max_window_bytes);
+}
 
-		while (current_seqn <= acknowledged_seqn)
+bool ByteBufferAsyncProcessor::fits_overflow(size_t size) const
+{
+	return window_packages / 2 < max_window_packages && (window_bytes + size) / 2 <= max_window_bytes;
+}
+
+void ByteBufferAsyncProcessor::overflow()
+{
+	{
+		std::lock_guard<decltype(lock)> guard(lock);
+		if (state >= StateKind::Stopping)
 		{
-			pending_queue.pop_front();
-			++current_seqn;
+			return;
 		}
-		for (int i = 0; i < pending_queue.size(); ++i)
+		state = StateKind::Stopping;
+		overflowed = true;
+	}
+	logger->error("{}: send window overflowed twice over, stopping, {} packages, {} bytes not acknowledged", id,
+		window_packages.load(), window_bytes.load());
+
+	wake();
+	{
+		std::lock_guard<decltype(window_lock)> guard(window_lock);
+		window_cv.notify_all();
+	}
+	if (overflow_handler)
+	{
+		overflow_handler();
+	}
+}
+
+bool ByteBufferAsyncProcessor::wait_for_room(size_t size)
+{
+	// Acknowledgements come through the receiving thread and are released by the async one, neither may wait for them.
+	const auto current_thread_id = std::this_thread::get_id();
+	if (overflow_policy == OverflowPolicy::Fail || current_thread_id == async_thread_id ||
+		current_thread_id == receiver_thread_id.load())
+	{
+		return false;
+	}
+
+	++blocked_puts;
+	std::unique_lock<decltype(window_lock)> ul(window_lock);
+	++window_waiters;
+	const bool admitted = window_cv.wait_for(ul, time_t(block_timeout_ms.load()),
+		[this, size]() -> bool { return state >= StateKind::Stopping || fits(size); });
+	--window_waiters;
+	return admitted && state < StateKind::Stopping;
+}
+
+bool ByteBufferAsyncProcessor::admit(size_t size, Priority priority)
+{
+	if (priority == Priority::Droppable)
+	{
+		return !congested && fits(size);
+	}
+	return fits(size) || wait_for_room(size);
+}
+
+void ByteBufferAsyncProcessor::update_congestion()
+{
+	const size_t bytes = window_bytes;
+	const size_t packages = window_packages;
+	const size_t max_bytes = max_window_bytes;
+	const size_t max_packages = max_window_packages;
+
+	const bool was_congested = congested;
+	const bool now_congested = was_congested ? bytes > max_bytes / 2 || packages > max_packages / 2
+											 : bytes > max_bytes / 4 * 3 || packages > max_packages / 4 * 3;
+	if (now_congested == was_congested)
+	{
+		return;
+	}
+
+	congested = now_congested;
+	if (now_congested)
+	{
+		logger->warn("{}: send window congested, {} packages, {} bytes not acknowledged", id, packages, bytes);
+	}
+	else
+	{
+		rejecting = false;
+		overflowing = false;
+		logger->info("{}: send window no longer congested", id);
+	}
+	if (congestion_handler)
+	{
+		congestion_handler(now_congested);
+	}
+}
+
+ByteBufferAsyncProcessor::package_iterator ByteBufferAsyncProcessor::batch_end(package_iterator first, package_iterator last) const
+{
+	const size_t limit = max_batch_size;
+	size_t size = first->size();
+	while (++first != last && size + first->size() <= limit)
+	{
+		size += first->size();
+	}
+	return first;
+}
+
+bool ByteBufferAsyncProcessor::reprocess()
+{
+	logger->debug("{}: reprocessing started", id);
+
+	drop_acknowledged();
+	auto first = pending_queue.cbegin();
+	while (first != pending_queue.cend())
+	{
+		const auto last = batch_end(first, pending_queue.cend());
+		if (!processor(first, last, current_seqn + std::distance(pending_queue.cbegin(), first)))
 		{
-			auto const& item = pending_queue[i];
-			if (!processor(item, current_seqn + i))
-			{
-				return false;
-			}
+			return false;
 		}
+		first = last;
 	}
 	return true;
 }
 
 void ByteBufferAsyncProcessor::process()
 {
-	{
-		std::lock_guard<decltype(queue_lock)> guard(queue_lock);
-		std::unique_lock<decltype(processing_lock)> ul(processing_lock);
-		util::bool_guard bool_guard(in_processing);
+	logger->debug("{}: processing started", id);
 
-		logger->debug("{}: processing started", id);
+	drop_acknowledged();
 
-		while (!queue.empty() && processor(queue.front(), max_sent_seqn + 1))
+	while (!queue.empty())
+	{
+		const auto last = batch_end(queue.cbegin(), queue.cend());
+		if (!processor(queue.cbegin(), last, max_sent_seqn + 1))
 		{
-			++max_sent_seqn;
-			pending_queue.push_back(std::move(queue.front()));
-			queue.pop_front();
+			break;
 		}
-	}
-	processing_cv.notify_all();
 
-	cv.notify_all();
+		const auto count = std::distance(queue.cbegin(), last);
+		max_sent_seqn += count;
+		std::move(queue.begin(), queue.begin() + count, std::back_inserter(pending_queue));
+		queue.erase(queue.begin(), queue.begin() + count);
+	}
 }
 
 void ByteBufferAsyncProcessor::ThreadProc()
@@ -131,42 +292,56 @@ void ByteBufferAsyncProcessor::ThreadProc()
 	rd::util::set_thread_name(id.empty() ? "ByteBufferAsyncProcessor Thread" : id.c_str());
 	async_thread_id = std::this_thread::get_id();
 
-	while (true)
+	while (state < StateKind::Terminated)
 	{
+		drop_acknowledged();
+
+		Buffer::ByteArray item;
+		bool received = false;
+		while (incoming.try_pop(item))
 		{
-			std::lock_guard<decltype(lock)> guard(lock);
+			queue.push_back(std::move(item));
+			received = true;
+		}
 
-			if (state >= StateKind::Terminated)
+		bool reprocessing = false;
+		{
+			std::lock_guard<decltype(processing_lock)> guard(processing_lock);
+			in_processing = interrupt_balance == 0 && (received || reprocess_requested);
+			if (in_processing)
 			{
-				return;
+				reprocessing = reprocess_requested;
+				reprocess_requested = false;
 			}
+		}
 
-			while (data.empty() || interrupt_balance != 0)
+		if (in_processing)
+		{
+			try
 			{
-				if (state >= StateKind::Stopping)
+				if (!reprocessing || reprocess())
 				{
-					return;
+					process();
 				}
-				cv.wait(lock);
-
-				logger->debug("{}'s ThreadProc waited for notify", id);
+			}
+			catch (std::exception const& e)
+			{
+				logger->error("Exception while processing byte queue | {}", e.what());
+			}
 
-				if (state >= StateKind::Terminating)
-				{
-					return;
-				}
+			{
+				std::lock_guard<decltype(processing_lock)> guard(processing_lock);
+				in_processing = false;
 			}
-			add_data(std::move(data));
-			data.clear();
+			processing_cv.notify_all();
 		}
 
-		try
-		{
-			process();
-		}
-		catch (std::exception const& e)
+		update_congestion();
+
+		// Packages that failed to go out stay queued until more arrive or the wire resumes, rather than being retried in a loop.
+		if (!park())
 		{
-			logger->error("Exception while processing byte queue | {}", e.what());
+			return;
 		}
 	}
 }
@@ -198,23 +373,86 @@ bool ByteBufferAsyncProcessor::terminate(time_t timeout)
 	return terminate0(timeout, StateKind::Terminating, "TERMINATE");
 }
 
-void ByteBufferAsyncProcessor::put(Buffer::ByteArray new_data)
+bool ByteBufferAsyncProcessor::put(Buffer::ByteArray new_data)
 {
+	if (state >= StateKind::Stopping)
 	{
-		std::lock_guard<decltype(lock)> guard(lock);
+		return false;
+	}
 
-		if (state >= StateKind::Stopping)
+	const size_t size = new_data.size();
+	if (!fits(size) && !wait_for_room(size))
+	{
+		// Even the room past the window is used up: the counterpart isn't acknowledging anymore, nothing is queued further.
+		if (!fits_overflow(size))
 		{
-			return;
+			++rejected_packages;
+			ByteArrayPool::release(std::move(new_data));
+			overflow();
+			return false;
+		}
+		if (!overflowing.exchange(true))
+		{
+			logger->warn("{}: send window full, queueing past it until it drains, {} packages, {} bytes not acknowledged", id,
+				window_packages.load(), window_bytes.load());
+		}
+	}
+	return enqueue(std::move(new_data));
+}
+
+bool ByteBufferAsyncProcessor::try_put(Buffer::ByteArray new_data, Priority priority)
+{
+	if (state >= StateKind::Stopping)
+	{
+		return false;
+	}
+
+	const size_t size = new_data.size();
+	if (!admit(size, priority))
+	{
+		if (priority == Priority::Droppable)
+		{
+			++dropped_packages;
 		}
-		data.emplace_back(std::move(new_data));
+		else
+		{
+			++rejected_packages;
+		}
+		if (priority == Priority::Normal && !rejecting.exchange(true))
+		{
+			logger->error("{}: send window full, refusing packages until it drains, {} packages, {} bytes not acknowledged", id,
+				window_packages.load(), window_bytes.load());
+		}
+		ByteArrayPool::release(std::move(new_data));
+		return false;
+	}
+	return enqueue(std::move(new_data));
+}
+
+bool ByteBufferAsyncProcessor::enqueue(Buffer::ByteArray new_data)
+{
+	const size_t size = new_data.size();
+	window_packages += 1;
+	const size_t bytes = window_bytes += size;
+	size_t peak = peak_window_bytes;
+	while (bytes > peak && !peak_window_bytes.compare_exchange_weak(peak, bytes))
+	{
+	}
+
+	incoming.push(std::move(new_data));
+
+	// Pairs with the fence in park(): either the async thread sees the package, or this sees it parked.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (parked.load(std::memory_order_relaxed))
+	{
+		wake();
 	}
-	cv.notify_all();
+	return true;
 }
 
 void ByteBufferAsyncProcessor::pause(const std::string& reason)
 {
-	std::lock_guard<decltype(lock)> guard(lock);
+	std::unique_lock<decltype(processing_lock)> ul(processing_lock);
 
 	++interrupt_balance;
 
@@ -224,7 +462,6 @@ void ByteBufferAsyncProcessor::pause(const std::string& reason)
 	if (current_thread_id != async_thread_id)
 	{
 		logger->debug("{} paused from another thread : {}", id, to_string(current_thread_id));
-		std::unique_lock<decltype(processing_lock)> ul(processing_lock);
 		processing_cv.wait(ul, [this]() -> bool { return !in_processing; });
 		logger->debug("{}: pausing waited for main processing", id);
 	}
@@ -233,31 +470,128 @@ void ByteBufferAsyncProcessor::pause(const std::string& reason)
 void ByteBufferAsyncProcessor::resume()
 {
 	{
-		std::lock_guard<decltype(lock)> guard(lock);
+		std::lock_guard<decltype(processing_lock)> guard(processing_lock);
 
-		reprocess();
+		// Unacknowledged packages are sent again by the async thread, e.g. over a new connection.
+		reprocess_requested = true;
 
 		--interrupt_balance;
 
 		logger->debug("{} resumed", id);
 	}
 
-	cv.notify_all();
+	wake();
 }
 
 void ByteBufferAsyncProcessor::acknowledge(sequence_number_t seqn)
 {
-	std::lock_guard<decltype(lock)> guard(lock);
-
+	// Only called from the receiving thread.
 	if (seqn > acknowledged_seqn)
 	{
 		logger->trace("{}: new acknowledged seqn: {}", this->id, seqn);
 		acknowledged_seqn = seqn;
+
+		// Pairs with the fence in park(), the async thread releases acknowledged packages from the window.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (parked.load(std::memory_order_relaxed))
+		{
+			wake();
+		}
 	}
 	else
 	{
-		logger->error("Acknowledge {} called, while next seqn MUST BE greater than {}", seqn, acknowledged_seqn);
+		logger->error("Acknowledge {} called, while next seqn MUST BE greater than {}", seqn, acknowledged_seqn.load());
+	}
+}
+
+void ByteBufferAsyncProcessor::set_max_batch_size(size_t size)
+{
+	max_batch_size = size;
+}
+
+void ByteBufferAsyncProcessor::set_receiver_thread(std::thread::id thread_id)
+{
+	receiver_thread_id = thread_id;
+}
+
+void ByteBufferAsyncProcessor::set_window(size_t max_bytes, size_t max_packages, OverflowPolicy policy, time_t block_timeout)
+{
+	max_window_bytes = max_bytes;
+	max_window_packages = (std::max)(max_packages, size_t{1});
+	overflow_policy = policy;
+	block_timeout_ms = block_timeout.count();
+	wake();
+}
+
+void ByteBufferAsyncProcessor::set_congestion_handler(std::function<void(bool)> handler)
+{
+	congestion_handler = std::move(handler);
+}
+
+void ByteBufferAsyncProcessor::set_overflow_handler(std::function<void()> handler)
+{
+	overflow_handler = std::move(handler);
+}
+
+bool ByteBufferAsyncProcessor::recover()
+{
+	std::lock_guard<decltype(lock)> guard(lock);
+	if (!overflowed || state != StateKind::Stopping)
+	{
+		return false;
+	}
+
+	// The async thread exits as soon as it sees the processor stopping, its region is ours once it did.
+	async_future.wait();
+
+	size_t bytes = 0;
+	size_t packages = 0;
+	const auto drop = [&bytes, &packages](Buffer::ByteArray& data) {
+		bytes += data.size();
+		++packages;
+		ByteArrayPool::release(std::move(data));
+	};
+	Buffer::ByteArray item;
+	while (incoming.try_pop(item))
+	{
+		drop(item);
 	}
+	std::for_each(queue.begin(), queue.end(), drop);
+	std::for_each(pending_queue.begin(), pending_queue.end(), drop);
+	queue.clear();
+	pending_queue.clear();
+
+	// Acknowledgements of the dropped packages are behind us, the counterpart only ever sees seqns going up.
+	acknowledged_seqn = max_sent_seqn;
+	current_seqn = max_sent_seqn + 1;
+
+	// Subtracted rather than zeroed: a producer that got past put()'s state check may still be enqueueing.
+	window_bytes -= bytes;
+	window_packages -= packages;
+	dropped_packages += packages;
+	rejecting = false;
+	overflowing = false;
+	overflowed = false;
+	logger->warn("{}: recovering from an overflow, {} packages, {} bytes dropped", id, packages, bytes);
+
+	state = StateKind::AsyncProcessing;
+	async_future = std::async(std::launch::async, &ByteBufferAsyncProcessor::ThreadProc, this);
+	return true;
+}
+
+ByteBufferAsyncProcessor::StateKind ByteBufferAsyncProcessor::get_state() const
+{
+	return state;
+}
+
+bool ByteBufferAsyncProcessor::is_congested() const
+{
+	return congested;
+}
+
+ByteBufferAsyncProcessor::Metrics ByteBufferAsyncProcessor::get_metrics() const
+{
+	return Metrics{window_packages, window_bytes, peak_window_bytes, dropped_packages, rejected_packages, blocked_puts, congested};
 }
 
 std::string to_string(ByteBufferAsyncProcessor::StateKind state)
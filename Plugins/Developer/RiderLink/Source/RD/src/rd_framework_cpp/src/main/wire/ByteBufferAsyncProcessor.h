@@ -7,14 +7,18 @@
 #endif
 
 #include "protocol/Buffer.h"
+#include "util/mpsc_queue.h"
 #include "spdlog/spdlog.h"
 
+#include <atomic>
 #include <chrono>
 #include <string>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
 #include <future>
 #include <list>
+#include <thread>
 
 #include <rd_framework_export.h>
 
@@ -34,42 +38,143 @@ public:
 		Terminated
 	};
 
+	using package_iterator = std::deque<Buffer::ByteArray>::const_iterator;
+
+	/**
+	 * \brief Sends packages [first, last), numbered from [first_seqn] on, returns whether all of them went through.
+	 */
+	using processor_t = std::function<bool(package_iterator first, package_iterator last, sequence_number_t first_seqn)>;
+
+	static constexpr size_t DEFAULT_MAX_BATCH_SIZE = 1u << 16;
+
+	enum class Priority
+	{
+		Normal,
+		// Refused as soon as the window is congested, leaving the room left to normal packages.
+		Droppable
+	};
+
+	/**
+	 * \brief What a normal package that doesn't fit in the window does. put() queues it past the window when it can't wait,
+	 * up to as much again as the window holds, only try_put() refuses it right away.
+	 */
+	enum class OverflowPolicy
+	{
+		// Doesn't wait, the default: producers such as the game thread never stall on the counterpart.
+		Fail,
+		// Waits up to the block timeout for acknowledgements to make room, except on the async and receiving threads,
+		// which are the ones making it. Only for producers that can afford to stall.
+		Block
+	};
+
+	static constexpr int64_t DEFAULT_BLOCK_TIMEOUT_MS = 1000;
+
+	static constexpr size_t DEFAULT_MAX_WINDOW_BYTES = 1u << 27;
+	static constexpr size_t DEFAULT_MAX_WINDOW_PACKAGES = 1u << 20;
+
+	struct Metrics
+	{
+		// Packages put but not acknowledged yet, whether sent or not.
+		size_t window_packages;
+		size_t window_bytes;
+		size_t peak_window_bytes;
+		uint64_t dropped_packages;
+		uint64_t rejected_packages;
+		uint64_t blocked_puts;
+		bool congested;
+	};
+
 private:
 	using time_t = std::chrono::milliseconds;
 
 	static size_t INITIAL_CAPACITY;
 
+	// Guards state transitions, never held by put() nor while sending.
 	std::recursive_mutex lock;
-	std::condition_variable_any cv;
 
 	std::string id;
 
-	std::function<bool(Buffer::ByteArray const&, sequence_number_t seqn)> processor;
+	processor_t processor;
+
+	// Packages are handed to the processor in batches of at most this many bytes, or a single package if it's larger.
+	std::atomic<size_t> max_batch_size{DEFAULT_MAX_BATCH_SIZE};
 
-	StateKind state{StateKind::Initialized};
+	std::atomic<StateKind> state{StateKind::Initialized};
 	static std::shared_ptr<spdlog::logger> logger;
 
 	std::thread::id async_thread_id;
+	// The thread reading acknowledgements, set by the wire.
+	std::atomic<std::thread::id> receiver_thread_id{};
 	std::future<void> async_future;
 
-	std::vector<Buffer::ByteArray> data;
-	std::mutex queue_lock;
+	// Producers hand packages to the async thread through here.
+	util::mpsc_queue<Buffer::ByteArray> incoming{INITIAL_CAPACITY};
+
+	// The async thread parks on wake_cv when it has nothing to do, producers only notify if it's parked.
+	std::mutex wake_lock;
+	std::condition_variable wake_cv;
+	std::atomic<bool> parked{false};
+
+	//  region only touched by the async thread
+
 	std::deque<Buffer::ByteArray> queue{};
 	std::deque<Buffer::ByteArray> pending_queue{};
 
 	sequence_number_t max_sent_seqn = 0;
 	sequence_number_t current_seqn = 1;
-	sequence_number_t acknowledged_seqn = 0;
 
+	// endregion
+
+	// Written by the receiving thread, acknowledged packages are dropped from pending_queue by the async one.
+	std::atomic<sequence_number_t> acknowledged_seqn{0};
+
+	//  region send window
+
+	std::atomic<size_t> max_window_bytes{DEFAULT_MAX_WINDOW_BYTES};
+	std::atomic<size_t> max_window_packages{DEFAULT_MAX_WINDOW_PACKAGES};
+	std::atomic<OverflowPolicy> overflow_policy{OverflowPolicy::Fail};
+	std::atomic<int64_t> block_timeout_ms{DEFAULT_BLOCK_TIMEOUT_MS};
+
+	// Added to by put(), released by the async thread once packages are acknowledged.
+	std::atomic<size_t> window_bytes{0};
+	std::atomic<size_t> window_packages{0};
+	std::atomic<size_t> peak_window_bytes{0};
+
+	std::atomic<uint64_t> dropped_packages{0};
+	std::atomic<uint64_t> rejected_packages{0};
+	std::atomic<uint64_t> blocked_puts{0};
+
+	// Raised by the async thread above 3/4 of the window, cleared below 1/2.
+	std::atomic<bool> congested{false};
+	// Set on the first refused package of a congestion, so it's only logged once.
+	std::atomic<bool> rejecting{false};
+	std::function<void(bool)> congestion_handler;
+
+	// Set on the first package queued past a full window, so it's only logged once.
+	std::atomic<bool> overflowing{false};
+	// Set when an overflow stopped the processor, cleared by recover().
+	std::atomic<bool> overflowed{false};
+	// Called once when put() overflows the window twice over and the processor stops.
+	std::function<void()> overflow_handler;
+
+	// Producers blocked by OverflowPolicy::Block wait on window_cv.
+	std::mutex window_lock;
+	std::condition_variable window_cv;
+	int32_t window_waiters = 0;
+
+	// endregion
+
+	// Pausing waits for the batch being sent, if any, without any lock held while sending.
 	int32_t interrupt_balance = 0;
 	bool in_processing = false;
+	bool reprocess_requested = false;
 	std::mutex processing_lock;
 	std::condition_variable processing_cv;
 
 public:
 	// region ctor/dtor
 
-	explicit ByteBufferAsyncProcessor(std::string id, std::function<bool(Buffer::ByteArray const&, sequence_number_t)> processor);
+	explicit ByteBufferAsyncProcessor(std::string id, processor_t processor);
 
 	// endregion
 private:
@@ -77,7 +182,31 @@ private:
 
 	bool terminate0(time_t timeout, StateKind state_to_set, string_view action);
 
-	void add_data(std::vector<Buffer::ByteArray>&& new_data);
+	void wake();
+
+	// Parks the async thread until woken, unless work arrived meanwhile. Returns false once it should exit.
+	bool park();
+
+	void drop_acknowledged();
+
+	bool fits(size_t size) const;
+
+	// Whether [size] more bytes still fit in the room put() has past the full window, as much again as the window.
+	bool fits_overflow(size_t size) const;
+
+	// Stops the processor because the counterpart stopped acknowledging, put() and try_put() refuse everything from now on.
+	void overflow();
+
+	// Waits for room in the window if the overflow policy and the calling thread allow it.
+	bool wait_for_room(size_t size);
+
+	bool admit(size_t size, Priority priority);
+
+	bool enqueue(Buffer::ByteArray new_data);
+
+	void update_congestion();
+
+	package_iterator batch_end(package_iterator first, package_iterator last) const;
 
 	bool reprocess();
 
@@ -92,13 +221,63 @@ public:
 
 	bool terminate(time_t timeout = time_t(0) /*InfiniteDuration*/);
 
-	void put(Buffer::ByteArray new_data);
+	/**
+	 * \brief Queues [new_data] for sending, past the window if it's still full once the overflow policy gave up waiting.
+	 * Past twice the window the counterpart is considered gone: the processor stops, see set_overflow_handler.
+	 * Returns false if the processor stopped.
+	 */
+	bool put(Buffer::ByteArray new_data);
+
+	/**
+	 * \brief Same as put, returns false if [new_data] was refused because the window is full, or congested for a
+	 * droppable package.
+	 */
+	bool try_put(Buffer::ByteArray new_data, Priority priority = Priority::Normal);
 
 	void pause(const std::string& reason);
 
 	void resume();
 
 	void acknowledge(int64_t seqn);
+
+	void set_max_batch_size(size_t size);
+
+	/**
+	 * \brief Tells which thread reads acknowledgements, put() never blocks it.
+	 */
+	void set_receiver_thread(std::thread::id thread_id);
+
+	/**
+	 * \brief Bounds the packages put but not acknowledged yet to [max_bytes] and [max_packages].
+	 * A single package larger than the window is still accepted when the window is empty.
+	 */
+	void set_window(size_t max_bytes, size_t max_packages, OverflowPolicy policy = OverflowPolicy::Fail,
+		time_t block_timeout = time_t(DEFAULT_BLOCK_TIMEOUT_MS));
+
+	/**
+	 * \brief [handler] is called from the async thread whenever the window becomes congested or stops being so.
+	 * To be set before start().
+	 */
+	void set_congestion_handler(std::function<void(bool)> handler);
+
+	/**
+	 * \brief [handler] is called from the thread calling put() when the processor stops because of an overflow.
+	 * To be set before start().
+	 */
+	void set_overflow_handler(std::function<void()> handler);
+
+	/**
+	 * \brief Restarts a processor an overflow stopped, e.g. once the wire has a new connection. Every package it still
+	 * held is dropped, the ones put from now on are numbered past the dropped ones. Returns false if it wasn't stopped
+	 * by an overflow.
+	 */
+	bool recover();
+
+	StateKind get_state() const;
+
+	bool is_congested() const;
+
+	Metrics get_metrics() const;
 };
 
 std::string to_string(ByteBufferAsyncProcessor::StateKind state);
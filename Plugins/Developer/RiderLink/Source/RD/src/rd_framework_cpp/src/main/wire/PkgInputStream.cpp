@@ -6,34 +6,73 @@
 
 namespace rd
 {
+constexpr size_t PkgInputStream::DEFAULT_MAX_POOLED_SLABS;
+
 void PkgInputStream::rewind()
 {
-	buffer.rewind();
+	position = 0;
+}
+
+std::shared_ptr<Buffer::ByteArray> PkgInputStream::lease(std::shared_ptr<pooled_slab> pooled)
+{
+	pooled->leased.store(true, std::memory_order_relaxed);
+	Buffer::ByteArray* bytes = &pooled->bytes;
+	// One control block per package rather than per view, the views only copy it.
+	return std::shared_ptr<Buffer::ByteArray>(
+		bytes, [pooled = std::move(pooled)](Buffer::ByteArray*) { pooled->leased.store(false, std::memory_order_release); });
 }
 
-void PkgInputStream::require_available(int size)
+Buffer::word_t* PkgInputStream::prepare(size_t size)
 {
-	buffer.require_available(size);
+	// Ends the lease right away unless views of the previous payload are still alive.
+	slab.reset();
+
+	const auto free_slab = std::find_if(slab_pool.begin(), slab_pool.end(),
+		[](std::shared_ptr<pooled_slab> const& it) { return !it->leased.load(std::memory_order_acquire); });
+	if (free_slab != slab_pool.end())
+	{
+		slab = lease(*free_slab);
+	}
+	else
+	{
+		auto pooled = std::make_shared<pooled_slab>();
+		if (slab_pool.size() < max_pooled_slabs.load(std::memory_order_relaxed))
+		{
+			slab_pool.push_back(pooled);
+		}
+		else
+		{
+			slab_misses.fetch_add(1, std::memory_order_relaxed);
+		}
+		slab = lease(std::move(pooled));
+	}
+
+	if (slab->size() < size)
+	{
+		slab->resize(size);
+	}
+	position = 0;
+	return slab->data();
 }
 
 size_t PkgInputStream::get_position() const
 {
-	return buffer.get_position();
+	return position;
 }
 
-Buffer::word_t* PkgInputStream::data()
+void PkgInputStream::set_max_pooled_slabs(size_t count)
 {
-	return buffer.data();
+	max_pooled_slabs = (std::max)(count, size_t{1});
 }
 
-Buffer& PkgInputStream::get_buffer()
+size_t PkgInputStream::get_slab_misses() const
 {
-	return buffer;
+	return slab_misses.load(std::memory_order_relaxed);
 }
 
 int32_t PkgInputStream::try_read(Buffer::word_t* res, size_t size)
 {
-	if (memory == -1 || buffer.get_position() == memory)
+	if (memory == -1 || position == memory)
 	{
 		memory = request_data();
 		if (memory == -1)
@@ -41,16 +80,16 @@ int32_t PkgInputStream::try_read(Buffer::word_t* res, size_t size)
 			return -1;
 		}
 	}
-	const int32_t n = static_cast<int32_t>((std::min)(size, memory - buffer.get_position()));
-	Buffer::word_t* start = buffer.current_pointer();
+	const int32_t n = static_cast<int32_t>((std::min)(size, memory - position));
+	const Buffer::word_t* start = slab->data() + position;
 	std::copy(start, start + n, res);
-	buffer.set_position(buffer.get_position() + n);
+	position += n;
 	return n;
 }
 
 bool PkgInputStream::read(Buffer::word_t* res, size_t size)
 {
-	//		spdlog::trace("PkgInputStream call: size={}, pos={}, memory={}", size, buffer.get_position(), memory);
+	//		spdlog::trace("PkgInputStream call: size={}, pos={}, memory={}", size, position, memory);
 
 	int32_t summary_size = 0;
 	while (summary_size < size)
@@ -64,4 +103,15 @@ bool PkgInputStream::read(Buffer::word_t* res, size_t size)
 	}
 	return true;
 }
+
+bool PkgInputStream::try_read_view(size_t size, Buffer& out)
+{
+	if (!slab || memory == static_cast<size_t>(-1) || memory - position < size)
+	{
+		return false;
+	}
+	out = Buffer::view(slab, position, size);
+	position += size;
+	return true;
+}
 }	 // namespace rd
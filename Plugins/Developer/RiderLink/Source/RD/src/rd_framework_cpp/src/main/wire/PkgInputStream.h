@@ -8,14 +8,43 @@
 
 #include "protocol/Buffer.h"
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 #include <rd_framework_export.h>
 
 namespace rd
 {
+/**
+ * \brief Reads messages out of the package payloads the wire receives. Each payload is received straight into a slab,
+ * and messages lying entirely in one payload can be handed out as views of it instead of being copied.
+ */
 class RD_FRAMEWORK_API PkgInputStream
 {
+public:
+	static constexpr size_t DEFAULT_MAX_POOLED_SLABS = 4;
+
 private:
-	Buffer buffer;
+	struct pooled_slab
+	{
+		Buffer::ByteArray bytes;
+		// Set while a payload lives in [bytes]. Cleared with release semantics once the stream and every view of it let go,
+		// possibly on another thread, so reusing the slab after an acquire load sees their reads done.
+		std::atomic<bool> leased{false};
+	};
+
+	// Payload of the current package, a lease on one of the slabs that views share.
+	std::shared_ptr<Buffer::ByteArray> slab;
+	size_t position = 0;
+
+	// Slabs are reused once their lease is over.
+	std::vector<std::shared_ptr<pooled_slab>> slab_pool;
+	std::atomic<size_t> max_pooled_slabs{DEFAULT_MAX_POOLED_SLABS};
+	// Payloads that got a slab of their own because every pooled one was still leased.
+	std::atomic<size_t> slab_misses{0};
+
+	static std::shared_ptr<Buffer::ByteArray> lease(std::shared_ptr<pooled_slab> pooled);
 
 	std::function<int32_t()> request_data;
 
@@ -29,18 +58,35 @@ public:
 
 	void rewind();
 
-	void require_available(int size);
+	/**
+	 * \brief Storage for the next package payload of [size] bytes, to be filled by the caller.
+	 * The previous slab is left alone if views of it are still alive.
+	 */
+	Buffer::word_t* prepare(size_t size);
 
 	size_t get_position() const;
 
-	Buffer::word_t* data();
+	/**
+	 * \brief At most [count] slabs are kept for reuse. As many payloads as views of received messages are alive for,
+	 * typically messages waiting for the wire's scheduler, are needed to never allocate one.
+	 */
+	void set_max_pooled_slabs(size_t count);
 
-	Buffer& get_buffer();
+	/**
+	 * \brief How many payloads got a slab of their own so far, because every pooled one was still leased.
+	 */
+	size_t get_slab_misses() const;
 
 	int32_t try_read(Buffer::word_t* res, size_t size);
 
 	bool read(Buffer::word_t* res, size_t size);
 
+	/**
+	 * \brief Hands out the next [size] bytes as a view sharing the current payload if they all are in it.
+	 * Returns false without consuming anything otherwise.
+	 */
+	bool try_read_view(size_t size, Buffer& out);
+
 	template <typename T>
 	T read_integral()
 	{
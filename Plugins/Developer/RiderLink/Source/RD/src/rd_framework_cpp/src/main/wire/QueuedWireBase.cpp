@@ -0,0 +1,165 @@
+#include "wire/QueuedWireBase.h"
+
+#include "protocol/ByteArrayPool.h"
+
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+#include <cstring>
+
+namespace rd
+{
+std::shared_ptr<spdlog::logger> QueuedWireBase::logger =
+	spdlog::stderr_color_mt<spdlog::synchronous_factory>("queuedWireLog", spdlog::color_mode::automatic);
+
+constexpr int32_t QueuedWireBase::PACKED_LAYOUT_FLAG;
+
+QueuedWireBase::QueuedWireBase(std::string id, IScheduler* scheduler) : WireBase(scheduler), id(std::move(id))
+{
+}
+
+void QueuedWireBase::write_packed_layout(Buffer& buffer, Buffer::packed_layout const& layout, int32_t message_size)
+{
+	for (auto const& it : layout.fields)
+	{
+		buffer.write_integral<uint32_t>(it.position);
+		buffer.write_integral<uint8_t>(it.size);
+		buffer.write_integral<uint8_t>(it.is_signed ? 1 : 0);
+	}
+	for (auto const& it : layout.length_tags)
+	{
+		buffer.write_integral<uint32_t>(it.position);
+		buffer.write_integral<uint32_t>(it.end);
+	}
+	buffer.write_integral(static_cast<uint32_t>(layout.fields.size()));
+	buffer.write_integral(static_cast<uint32_t>(layout.length_tags.size()));
+	buffer.write_integral(static_cast<uint32_t>(message_size));
+}
+
+int32_t QueuedWireBase::read_packed_layout(Buffer::word_t const* package, size_t size, Buffer::packed_layout& layout)
+{
+	uint32_t counts[3];
+	std::memcpy(counts, package + size - sizeof(counts), sizeof(counts));
+
+	layout.clear();
+	Buffer::word_t const* cursor = package + counts[2];
+	for (uint32_t i = 0; i < counts[0]; ++i, cursor += 6)
+	{
+		Buffer::packed_layout::field field{};
+		std::memcpy(&field.position, cursor, sizeof(uint32_t));
+		field.size = cursor[4];
+		field.is_signed = cursor[5] != 0;
+		layout.fields.push_back(field);
+	}
+	for (uint32_t i = 0; i < counts[1]; ++i, cursor += 8)
+	{
+		Buffer::packed_layout::length_tag tag{};
+		std::memcpy(&tag.position, cursor, sizeof(uint32_t));
+		std::memcpy(&tag.end, cursor + 4, sizeof(uint32_t));
+		layout.length_tags.push_back(tag);
+	}
+	return static_cast<int32_t>(counts[2]);
+}
+
+void QueuedWireBase::send(RdId const& rd_id, std::function<void(Buffer& buffer)> writer) const
+{
+	bool droppable;
+	{
+		std::lock_guard<decltype(droppable_lock)> guard(droppable_lock);
+		droppable = droppable_ids.count(rd_id) != 0;
+	}
+	if (droppable)
+	{
+		try_send(rd_id, std::move(writer), ByteBufferAsyncProcessor::Priority::Droppable);
+	}
+	else
+	{
+		Buffer::ByteArray package = write_message(rd_id, writer);
+		if (!package.empty() && !async_send_buffer.put(std::move(package)))
+		{
+			logger->debug("{}: message {} not sent, the send processor stopped", this->id, to_string(rd_id));
+		}
+	}
+}
+
+bool QueuedWireBase::try_send(
+	RdId const& rd_id, std::function<void(Buffer& buffer)> writer, ByteBufferAsyncProcessor::Priority priority) const
+{
+	Buffer::ByteArray package = write_message(rd_id, writer);
+	return !package.empty() && async_send_buffer.try_put(std::move(package), priority);
+}
+
+Buffer::ByteArray QueuedWireBase::write_message(RdId const& rd_id, std::function<void(Buffer& buffer)> const& writer) const
+{
+	RD_ASSERT_MSG(!rd_id.isNull(), "{}: id mustn't be null");
+
+	// Written plain whatever the counterpart reads: unacknowledged messages are sent again after a reconnect, maybe to
+	// a counterpart that doesn't read compact ones. With the layout of their packed fields send0 encodes them per connection.
+	bool compact = compact_encoding_enabled;
+	Buffer::packed_layout layout;
+
+	// Its storage goes back to the pool once the package is acknowledged.
+	Buffer local_send_buffer = Buffer::pooled();
+	local_send_buffer.write_integral<int32_t>(0);	 // placeholder for length
+	rd_id.write(local_send_buffer);					 // write id
+	local_send_buffer.write_integral<int16_t>(0);	 // placeholder for context
+	if (compact)
+	{
+		local_send_buffer.set_packed_layout(&layout);
+	}
+	writer(local_send_buffer);						 // write rest
+	local_send_buffer.set_packed_layout(nullptr);
+
+	// The flags send0 and the counterpart read from the length field start at PACKED_LAYOUT_FLAG.
+	const size_t position = local_send_buffer.get_position();
+	if (position >= static_cast<size_t>(PACKED_LAYOUT_FLAG))
+	{
+		logger->error("{}: message {} of {} bytes not sent, larger than the {} bytes a package can hold", this->id, to_string(rd_id),
+			position, PACKED_LAYOUT_FLAG - 1);
+		ByteArrayPool::release(std::move(local_send_buffer).getRealArray());
+		return {};
+	}
+	int32_t len = static_cast<int32_t>(position);
+	if (layout.opaque)
+	{
+		compact = false;
+	}
+
+	local_send_buffer.rewind();
+	local_send_buffer.write_integral<int32_t>((len - 4) | (compact ? PACKED_LAYOUT_FLAG : 0));
+	local_send_buffer.set_position(len);
+	if (compact)
+	{
+		write_packed_layout(local_send_buffer, layout, len);
+	}
+	return std::move(local_send_buffer).getRealArray();
+}
+
+void QueuedWireBase::set_droppable(Lifetime lifetime, RdId const& rd_id)
+{
+	lifetime->bracket(
+		[this, rd_id] {
+			std::lock_guard<decltype(droppable_lock)> guard(droppable_lock);
+			droppable_ids.insert(rd_id);
+		},
+		[this, rd_id] {
+			std::lock_guard<decltype(droppable_lock)> guard(droppable_lock);
+			droppable_ids.erase(rd_id);
+		});
+}
+
+void QueuedWireBase::set_max_send_batch_size(size_t size)
+{
+	async_send_buffer.set_max_batch_size(size);
+}
+
+void QueuedWireBase::set_send_window(
+	size_t max_bytes, size_t max_packages, ByteBufferAsyncProcessor::OverflowPolicy policy, std::chrono::milliseconds block_timeout)
+{
+	async_send_buffer.set_window(max_bytes, max_packages, policy, block_timeout);
+}
+
+ByteBufferAsyncProcessor::Metrics QueuedWireBase::get_send_metrics() const
+{
+	return async_send_buffer.get_metrics();
+}
+}	 // namespace rd
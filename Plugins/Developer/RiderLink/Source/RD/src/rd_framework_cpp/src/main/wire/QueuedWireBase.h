@@ -0,0 +1,111 @@
+#ifndef RD_CPP_QUEUEDWIREBASE_H
+#define RD_CPP_QUEUEDWIREBASE_H
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable:4251)
+#endif
+
+#include "base/WireBase.h"
+#include "ByteBufferAsyncProcessor.h"
+#include "std/unordered_set.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include <rd_framework_export.h>
+
+namespace rd
+{
+/**
+ * \brief Send side shared by the wires queueing messages through a ByteBufferAsyncProcessor: how a message is framed
+ * into a package, which messages are droppable, and the send window. Packages are [int32 length][id][int16 context][payload],
+ * followed by the layout of their packed fields when compact encoding is enabled, see write_message.
+ */
+class RD_FRAMEWORK_API QueuedWireBase : public WireBase
+{
+protected:
+	static std::shared_ptr<spdlog::logger> logger;
+
+	std::string id;
+
+	mutable ByteBufferAsyncProcessor async_send_buffer{id + "-AsyncSendProcessor",
+		[this](ByteBufferAsyncProcessor::package_iterator first, ByteBufferAsyncProcessor::package_iterator last,
+			sequence_number_t first_seqn) -> bool { return this->send0(first, last, first_seqn); }};
+
+	// Messages to these entities are sent droppable, see set_droppable.
+	mutable std::mutex droppable_lock;
+	rd::unordered_set<RdId> droppable_ids;
+
+	// Whether packages are queued with the layout of their packed fields, for send0 to encode them per connection.
+	std::atomic<bool> compact_encoding_enabled{false};
+
+	// Set in the length of queued messages followed by the layout of their packed fields, cleared before sending.
+	// Lengths stay below it, so that neither this nor the flags above it are ever misread.
+	static constexpr int32_t PACKED_LAYOUT_FLAG = 1 << 29;
+
+	// Writes the package of a message to queue for sending, queued plain if its layout is opaque.
+	// Returns an empty array for messages too large for a package, which are never sent.
+	Buffer::ByteArray write_message(RdId const& rd_id, std::function<void(Buffer& buffer)> const& writer) const;
+
+	// Appended to queued messages with PACKED_LAYOUT_FLAG: fields, length tags, their counts and the message size.
+	static void write_packed_layout(Buffer& buffer, Buffer::packed_layout const& layout, int32_t message_size);
+
+	// Returns the size of the message in front of the layout.
+	static int32_t read_packed_layout(Buffer::word_t const* package, size_t size, Buffer::packed_layout& layout);
+
+public:
+	// region ctor/dtor
+
+	QueuedWireBase(std::string id, IScheduler* scheduler);
+
+	virtual ~QueuedWireBase() override = default;
+
+	// endregion
+
+	/**
+	 * \brief Sends packages [first, last) numbered from [first_seqn] on, called from the send processor thread.
+	 */
+	virtual bool send0(ByteBufferAsyncProcessor::package_iterator first, ByteBufferAsyncProcessor::package_iterator last,
+		sequence_number_t first_seqn) const = 0;
+
+	/**
+	 * \brief Never loses the message, see ByteBufferAsyncProcessor::put, unless its entity was marked droppable.
+	 * When the counterpart stops acknowledging for good the send processor stops, the next connection recovers it.
+	 */
+	void send(RdId const& rd_id, std::function<void(Buffer& buffer)> writer) const override;
+
+	/**
+	 * \brief Same as send, returns false if the message was refused because the send window is full,
+	 * or congested for a droppable message. A refused message is never sent, see ByteBufferAsyncProcessor::try_put.
+	 */
+	bool try_send(RdId const& rd_id, std::function<void(Buffer& buffer)> writer,
+		ByteBufferAsyncProcessor::Priority priority = ByteBufferAsyncProcessor::Priority::Normal) const;
+
+	/**
+	 * \brief Messages sent to [rd_id] during [lifetime] go through try_send with Priority::Droppable: they are dropped while
+	 * the send window is congested. Meant for traffic nothing depends on, such as log events.
+	 */
+	void set_droppable(Lifetime lifetime, RdId const& rd_id);
+
+	/**
+	 * \brief Packages queued for sending are coalesced into batches of at most [size] bytes.
+	 */
+	void set_max_send_batch_size(size_t size);
+
+	/**
+	 * \brief See ByteBufferAsyncProcessor::set_window.
+	 */
+	void set_send_window(size_t max_bytes, size_t max_packages,
+		ByteBufferAsyncProcessor::OverflowPolicy policy = ByteBufferAsyncProcessor::OverflowPolicy::Fail,
+		std::chrono::milliseconds block_timeout = std::chrono::milliseconds(ByteBufferAsyncProcessor::DEFAULT_BLOCK_TIMEOUT_MS));
+
+	ByteBufferAsyncProcessor::Metrics get_send_metrics() const;
+};
+}	 // namespace rd
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#endif	  // RD_CPP_QUEUEDWIREBASE_H
@@ -0,0 +1,707 @@
+#include "wire/SharedMemoryWire.h"
+
+#include <util/thread_util.h>
+
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <random>
+#include <utility>
+#include <thread>
+
+namespace rd
+{
+namespace
+{
+constexpr uint32_t SEGMENT_MAGIC = 0x52445357;
+constexpr uint32_t SEGMENT_VERSION = 1;
+
+// segment_header::server_state
+constexpr uint32_t SERVER_DOWN = 0;
+constexpr uint32_t SERVER_ACCEPTING = 1;
+constexpr uint32_t SERVER_CONNECTED = 2;
+
+// segment_header::client_state
+constexpr uint32_t CLIENT_DETACHED = 0;
+constexpr uint32_t CLIENT_ATTACHED = 1;
+// Claimed by a client resetting the rings, the server waits for it to be attached.
+constexpr uint32_t CLIENT_ATTACHING = 2;
+
+// Rings are waited on in slices of this, to notice the counterpart going away and what it read meanwhile.
+constexpr std::chrono::milliseconds WAIT_SLICE = std::chrono::milliseconds(100);
+
+size_t rings_offset(size_t header_size)
+{
+	return (header_size + 4095) & ~size_t{4095};
+}
+}	 // namespace
+
+/**
+ * \brief Written by one process and read by the other, through std::atomic which are plain lock free integers.
+ */
+struct SharedMemoryWire::ring_header
+{
+	// Bytes ever written, only published by the writer.
+	alignas(64) std::atomic<uint64_t> head;
+	// Bytes ever read, only published by the reader.
+	alignas(64) std::atomic<uint64_t> tail;
+	// Last sequence number the reader dispatched.
+	std::atomic<sequence_number_t> consumed_seqn;
+
+	alignas(64) std::atomic<uint32_t> data_word;
+	std::atomic<uint32_t> space_word;
+	std::atomic<uint32_t> reader_waiting;
+	std::atomic<uint32_t> writer_waiting;
+	// Bumped by the writer side every heartbeat interval.
+	std::atomic<uint32_t> heartbeat;
+};
+
+struct SharedMemoryWire::segment_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t ring_capacity;
+
+	std::atomic<uint32_t> state_word;
+	std::atomic<uint32_t> server_state;
+	std::atomic<uint32_t> client_state;
+	// Bumped by the server whenever a connection ends, so a client can tell its connection from the next one.
+	std::atomic<uint32_t> session;
+
+	// [0] is written by the server, [1] by the client.
+	ring_header rings[2];
+};
+
+/**
+ * \brief One process' end of a ring: the writer copies in and publishes head, the reader copies out and publishes tail.
+ * Each side only waits when the ring is full or empty, and is only woken if it said it's waiting.
+ */
+class SharedMemoryWire::ring
+{
+	ring_header* header;
+	Buffer::word_t* data;
+	const uint64_t capacity;
+	util::shared_memory_signal data_signal;
+	util::shared_memory_signal space_signal;
+
+	// Not published yet.
+	uint64_t local_head = 0;
+	uint64_t local_tail = 0;
+
+public:
+	ring(ring_header* header, Buffer::word_t* data, uint64_t capacity, std::string const& name)
+		: header(header)
+		, data(data)
+		, capacity(capacity)
+		, data_signal(&header->data_word, name + "d")
+		, space_signal(&header->space_word, name + "s")
+	{
+		sync();
+	}
+
+	/**
+	 * \brief Picks up the positions of a ring reset by the counterpart.
+	 */
+	void sync()
+	{
+		local_head = header->head.load(std::memory_order_acquire);
+		local_tail = header->tail.load(std::memory_order_acquire);
+	}
+
+	ring_header& get_header() const
+	{
+		return *header;
+	}
+
+	/**
+	 * \brief Clears the ring, only while neither side uses it.
+	 */
+	void reset()
+	{
+		header->head.store(0);
+		header->tail.store(0);
+		header->consumed_seqn.store(0);
+		header->reader_waiting.store(0);
+		header->writer_waiting.store(0);
+		local_head = local_tail = 0;
+	}
+
+	/**
+	 * \brief Copies [size] bytes in, waiting for room while [keep_waiting] says so. Published by flush().
+	 */
+	template <typename F>
+	bool write(const Buffer::word_t* src, size_t size, F&& keep_waiting)
+	{
+		while (size > 0)
+		{
+			const uint64_t free = capacity - (local_head - header->tail.load(std::memory_order_acquire));
+			if (free == 0)
+			{
+				flush();
+
+				const uint32_t seen = space_signal.load();
+				header->writer_waiting.store(1);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const bool full = local_head - header->tail.load() == capacity;
+				if (full && !keep_waiting())
+				{
+					header->writer_waiting.store(0);
+					return false;
+				}
+				if (full)
+				{
+					space_signal.wait(seen, WAIT_SLICE);
+				}
+				header->writer_waiting.store(0, std::memory_order_relaxed);
+				continue;
+			}
+
+			const size_t count = static_cast<size_t>((std::min)(free, uint64_t{size}));
+			const size_t offset = static_cast<size_t>(local_head & (capacity - 1));
+			const size_t first = (std::min)(count, static_cast<size_t>(capacity) - offset);
+			std::memcpy(data + offset, src, first);
+			std::memcpy(data, src + first, count - first);
+
+			local_head += count;
+			src += count;
+			size -= count;
+		}
+		return true;
+	}
+
+	void flush()
+	{
+		header->head.store(local_head, std::memory_order_release);
+		// Pairs with the fence of a reader about to wait: either it sees the bytes, or this sees it waiting.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (header->reader_waiting.load(std::memory_order_relaxed) != 0)
+		{
+			data_signal.notify();
+		}
+	}
+
+	/**
+	 * \brief Copies [size] bytes out, waiting for them while [keep_waiting] says so. Released to the writer by consume().
+	 */
+	template <typename F>
+	bool read(Buffer::word_t* dst, size_t size, F&& keep_waiting)
+	{
+		while (size > 0)
+		{
+			const uint64_t available = header->head.load(std::memory_order_acquire) - local_tail;
+			if (available == 0)
+			{
+				consume();
+
+				const uint32_t seen = data_signal.load();
+				header->reader_waiting.store(1);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const bool empty = header->head.load() == local_tail;
+				if (empty && !keep_waiting())
+				{
+					header->reader_waiting.store(0);
+					return false;
+				}
+				if (empty)
+				{
+					data_signal.wait(seen, WAIT_SLICE);
+				}
+				header->reader_waiting.store(0, std::memory_order_relaxed);
+				continue;
+			}
+
+			const size_t count = static_cast<size_t>((std::min)(available, uint64_t{size}));
+			const size_t offset = static_cast<size_t>(local_tail & (capacity - 1));
+			const size_t first = (std::min)(count, static_cast<size_t>(capacity) - offset);
+			std::memcpy(dst, data + offset, first);
+			std::memcpy(dst + first, data, count - first);
+
+			local_tail += count;
+			dst += count;
+			size -= count;
+		}
+		return true;
+	}
+
+	void consume()
+	{
+		header->tail.store(local_tail, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (header->writer_waiting.load(std::memory_order_relaxed) != 0)
+		{
+			space_signal.notify();
+		}
+	}
+
+	/**
+	 * \brief Wakes both sides, so they notice what changed.
+	 */
+	void wake()
+	{
+		data_signal.notify();
+		space_signal.notify();
+	}
+};
+
+std::shared_ptr<spdlog::logger> SharedMemoryWire::Base::logger =
+	spdlog::stderr_color_mt<spdlog::synchronous_factory>("sharedMemoryWireLog", spdlog::color_mode::automatic);
+
+std::chrono::milliseconds SharedMemoryWire::timeout = std::chrono::milliseconds(500);
+
+constexpr int32_t SharedMemoryWire::Base::MaximumHeartbeatDelay;
+constexpr int32_t SharedMemoryWire::Base::DisconnectHeartbeatDelay;
+constexpr size_t SharedMemoryWire::Server::DEFAULT_RING_CAPACITY;
+
+SharedMemoryWire::Base::Base(std::string id, Lifetime parentLifetime, IScheduler* scheduler)
+	: QueuedWireBase(std::move(id), scheduler), scheduler(scheduler), lifetimeDef(parentLifetime)
+{
+	async_send_buffer.pause("initial");
+	async_send_buffer.start();
+}
+
+SharedMemoryWire::Base::~Base()
+{
+	if (!lifetimeDef.is_terminated())
+	{
+		lifetimeDef.terminate();
+	}
+}
+
+void SharedMemoryWire::Base::map_rings(std::string const& name, bool server_side)
+{
+	auto* base = static_cast<Buffer::word_t*>(segment.data());
+	header = static_cast<segment_header*>(segment.data());
+	const uint64_t capacity = header->ring_capacity;
+	Buffer::word_t* data = base + rings_offset(sizeof(segment_header));
+
+	state_signal = std::make_unique<util::shared_memory_signal>(&header->state_word, name + "-s");
+	auto server_ring = std::make_unique<ring>(&header->rings[0], data, capacity, name + "-0");
+	auto client_ring = std::make_unique<ring>(&header->rings[1], data + capacity, capacity, name + "-1");
+	outgoing = server_side ? std::move(server_ring) : std::move(client_ring);
+	incoming = server_side ? std::move(client_ring) : std::move(server_ring);
+}
+
+void SharedMemoryWire::Base::unmap_rings()
+{
+	outgoing.reset();
+	incoming.reset();
+	state_signal.reset();
+	header = nullptr;
+	segment = util::shared_memory_segment();
+}
+
+bool SharedMemoryWire::Base::is_linked() const
+{
+	return linked && !terminating && counterpart_attached();
+}
+
+void SharedMemoryWire::Base::connection()
+{
+	async_send_buffer.recover();
+	outgoing->sync();
+	incoming->sync();
+	linked = true;
+
+	auto heartbeat = LifetimeDefinition::use([this](Lifetime heartbeatLifetime) {
+		const auto heartbeat = start_heartbeat(heartbeatLifetime).share();
+
+		async_send_buffer.resume();
+
+		connected.set(true);
+
+		receiverProc();
+
+		// The send processor may be waiting for room in the outgoing ring.
+		linked = false;
+		outgoing->wake();
+
+		connected.set(false);
+
+		async_send_buffer.pause("Disconnected");
+
+		return heartbeat;
+	});
+	// It uses the rings, which a client unmaps right after.
+	heartbeat.wait();
+
+	logger->debug("{}: heartbeat stopped", this->id);
+}
+
+void SharedMemoryWire::Base::receiverProc()
+{
+	async_send_buffer.set_receiver_thread(std::this_thread::get_id());
+
+	const auto keep_waiting = [this]() -> bool {
+		acknowledge_consumed();
+		return is_linked();
+	};
+
+	Buffer::ByteArray discarded;
+	while (is_linked())
+	{
+		sequence_number_t seqn = 0;
+		int32_t len = 0;
+		RdId::hash_t hash = 0;
+		if (!incoming->read(reinterpret_cast<Buffer::word_t*>(&seqn), sizeof(seqn), keep_waiting) ||
+			!incoming->read(reinterpret_cast<Buffer::word_t*>(&len), sizeof(len), keep_waiting) ||
+			!incoming->read(reinterpret_cast<Buffer::word_t*>(&hash), sizeof(hash), keep_waiting))
+		{
+			break;
+		}
+		const int32_t size = len - static_cast<int32_t>(sizeof(hash));
+		if (size < 0)
+		{
+			logger->error("{}: broken message, len={}, seqn={}", this->id, len, seqn);
+			break;
+		}
+
+		// Sent again after the counterpart reattached, same as SocketWire does after a reconnect.
+		if (seqn <= max_received_seqn && seqn != 1)
+		{
+			discarded.resize(size);
+			if (!incoming->read(discarded.data(), size, keep_waiting))
+			{
+				break;
+			}
+			continue;
+		}
+
+		Buffer message(static_cast<size_t>(size));
+		if (!incoming->read(message.data(), size, keep_waiting))
+		{
+			break;
+		}
+		max_received_seqn = seqn;
+		incoming->get_header().consumed_seqn.store(seqn, std::memory_order_release);
+		incoming->consume();
+
+		message_broker.dispatch(RdId{hash}, std::move(message));
+		acknowledge_consumed();
+	}
+	logger->debug("{}: receiver stopped", this->id);
+}
+
+void SharedMemoryWire::Base::acknowledge_consumed()
+{
+	const sequence_number_t consumed = outgoing->get_header().consumed_seqn.load(std::memory_order_acquire);
+	if (consumed > max_consumed_seqn)
+	{
+		max_consumed_seqn = consumed;
+		async_send_buffer.acknowledge(consumed);
+	}
+}
+
+std::future<void> SharedMemoryWire::Base::start_heartbeat(Lifetime lifetime)
+{
+	return std::async([this, lifetime] {
+		uint32_t counterpart_heartbeat = incoming->get_header().heartbeat.load();
+		int32_t missed = 0;
+		while (!lifetime->is_terminated())
+		{
+			std::this_thread::sleep_for(heartBeatInterval);
+			outgoing->get_header().heartbeat.fetch_add(1);
+
+			const uint32_t received = incoming->get_header().heartbeat.load();
+			missed = received == counterpart_heartbeat ? missed + 1 : 0;
+			counterpart_heartbeat = received;
+
+			heartbeatAlive.set(missed <= MaximumHeartbeatDelay);
+			if (missed > DisconnectHeartbeatDelay && linked.exchange(false))
+			{
+				logger->warn("{}: counterpart stopped responding, disconnecting", this->id);
+				incoming->wake();
+			}
+		}
+	});
+}
+
+void SharedMemoryWire::Base::wake_all()
+{
+	if (state_signal)
+	{
+		state_signal->notify();
+	}
+	if (outgoing)
+	{
+		outgoing->wake();
+	}
+	if (incoming)
+	{
+		incoming->wake();
+	}
+}
+
+void SharedMemoryWire::Base::terminate_connection()
+{
+	logger->info("{}: starts terminating lifetime", this->id);
+	terminating = true;
+
+	const bool send_buffer_stopped = async_send_buffer.stop(timeout);
+	logger->debug("{}: send buffer stopped, success: {}", this->id, send_buffer_stopped);
+
+	{
+		std::lock_guard<decltype(lock)> guard(lock);
+		wake_all();
+	}
+	cv.notify_all();
+
+	logger->debug("{}: waiting for receiver thread", this->id);
+	thread.join();
+	logger->info("{}: termination finished", this->id);
+}
+
+bool SharedMemoryWire::Base::send0(ByteBufferAsyncProcessor::package_iterator first, ByteBufferAsyncProcessor::package_iterator last,
+	sequence_number_t first_seqn) const
+{
+	// Only ever called from the send processor thread, while connected.
+	const auto keep_waiting = [this]() -> bool { return is_linked(); };
+
+	sequence_number_t seqn = first_seqn;
+	for (auto it = first; it != last; ++it, ++seqn)
+	{
+		if (!outgoing->write(reinterpret_cast<const Buffer::word_t*>(&seqn), sizeof(seqn), keep_waiting) ||
+			!outgoing->write(it->data(), it->size(), keep_waiting))
+		{
+			logger->debug("{}: counterpart detached while sending", this->id);
+			return false;
+		}
+	}
+	outgoing->flush();
+
+	logger->trace("{}: were sent {} packages", this->id, seqn - first_seqn);
+	return true;
+}
+
+SharedMemoryWire::Client::Client(Lifetime parentLifetime, IScheduler* scheduler, std::string name, const std::string& id)
+	: Base(id, parentLifetime, scheduler), name(std::move(name)), clientLifetimeDefinition(parentLifetime)
+{
+	thread = std::thread([this]() {
+		rd::util::set_thread_name(this->id.empty() ? "SharedMemoryWire::Client Thread" : this->id.c_str());
+
+		logger->info("{}: started, segment: {}.", this->id, this->name);
+
+		while (!terminating)
+		{
+			try
+			{
+				{
+					std::unique_lock<decltype(lock)> ul(lock);
+					util::shared_memory_segment opened = util::shared_memory_segment::open(this->name);
+					auto const* opened_header = static_cast<segment_header const*>(opened.data());
+					const uint64_t capacity = opened.is_valid() && opened.get_size() >= sizeof(segment_header) ? opened_header->ring_capacity : 0;
+					// Rings index with capacity - 1 as a mask.
+					const bool ready = capacity != 0 && (capacity & (capacity - 1)) == 0 && opened_header->magic == SEGMENT_MAGIC &&
+									   opened_header->version == SEGMENT_VERSION &&
+									   opened.get_size() >= rings_offset(sizeof(segment_header)) + 2 * capacity &&
+									   opened_header->server_state == SERVER_ACCEPTING && opened_header->client_state == CLIENT_DETACHED;
+					if (!ready)
+					{
+						logger->debug("{}: segment {} isn't accepting a client yet", this->id, this->name);
+						cv.wait_for(ul, timeout);
+						continue;
+					}
+
+					segment = std::move(opened);
+					map_rings(this->name, false);
+
+					// Claimed before touching the rings: of clients attaching at once, only one gets through.
+					session = header->session;
+					uint32_t detached = CLIENT_DETACHED;
+					if (!header->client_state.compare_exchange_strong(detached, CLIENT_ATTACHING))
+					{
+						logger->debug("{}: another client attached to {} first", this->id, this->name);
+						unmap_rings();
+						cv.wait_for(ul, timeout);
+						continue;
+					}
+
+					// The server doesn't touch the rings until it sees the client attached.
+					outgoing->reset();
+					incoming->reset();
+					// Unless it gave the slot back meanwhile, taking this client for a crashed one.
+					uint32_t attaching = CLIENT_ATTACHING;
+					if (header->session != session || !header->client_state.compare_exchange_strong(attaching, CLIENT_ATTACHED))
+					{
+						logger->warn("{}: attaching to {} took too long, retrying", this->id, this->name);
+						unmap_rings();
+						continue;
+					}
+					state_signal->notify();
+				}
+				logger->info("{}: attached to {}", this->id, this->name);
+
+				connection();
+
+				{
+					std::lock_guard<decltype(lock)> guard(lock);
+					// The server already let go otherwise.
+					if (header->session == session)
+					{
+						header->client_state = CLIENT_DETACHED;
+						state_signal->notify();
+					}
+					unmap_rings();
+				}
+				logger->info("{}: detached from {}", this->id, this->name);
+			}
+			catch (std::exception const& e)
+			{
+				logger->error("{}: attaching to {} failed: {}", this->id, this->name, e.what());
+				std::unique_lock<decltype(lock)> ul(lock);
+				cv.wait_for(ul, timeout);
+			}
+		}
+		logger->info("{}: terminated, segment: {}.", this->id, this->name);
+	});
+
+	clientLifetimeDefinition.lifetime->add_action([this]() { terminate_connection(); });
+}
+
+SharedMemoryWire::Client::~Client()
+{
+	if (!clientLifetimeDefinition.is_terminated())
+	{
+		clientLifetimeDefinition.terminate();
+	}
+}
+
+bool SharedMemoryWire::Client::counterpart_attached() const
+{
+	return header->server_state != SERVER_DOWN && header->session == session;
+}
+
+SharedMemoryWire::Server::Server(Lifetime parentLifetime, IScheduler* scheduler, std::string name, size_t ring_capacity, const std::string& id)
+	: Base(id, parentLifetime, scheduler), name(std::move(name)), serverLifetimeDefinition(parentLifetime)
+{
+	if (this->name.empty())
+	{
+		this->name = fmt::format("rd-{:08x}", std::random_device{}());
+	}
+	size_t capacity = 4096;
+	while (capacity < ring_capacity)
+	{
+		capacity <<= 1;
+	}
+
+	try
+	{
+		create_segment(rings_offset(sizeof(segment_header)) + 2 * capacity);
+	}
+	catch (...)
+	{
+		// The send processor Base started would be waited for forever on destruction.
+		async_send_buffer.terminate(timeout);
+		throw;
+	}
+	header = new (segment.data()) segment_header();
+	header->magic = SEGMENT_MAGIC;
+	header->version = SEGMENT_VERSION;
+	header->ring_capacity = capacity;
+	map_rings(this->name, true);
+
+	logger->info("{}: created segment {}, rings of {} bytes", this->id, this->name, capacity);
+
+	thread = std::thread([this]() {
+		rd::util::set_thread_name(this->id.empty() ? "SharedMemoryWire::Server Thread" : this->id.c_str());
+
+		auto attaching_since = std::chrono::steady_clock::now();
+		while (!terminating)
+		{
+			header->server_state = SERVER_ACCEPTING;
+			state_signal->notify();
+
+			const uint32_t seen = state_signal->load();
+			const uint32_t client_state = header->client_state;
+			if (client_state != CLIENT_ATTACHED)
+			{
+				// A client which died while attaching would hold the slot forever.
+				uint32_t attaching = CLIENT_ATTACHING;
+				if (client_state != CLIENT_ATTACHING)
+				{
+					attaching_since = std::chrono::steady_clock::now();
+				}
+				else if (std::chrono::steady_clock::now() - attaching_since > heartBeatInterval * DisconnectHeartbeatDelay &&
+						 header->client_state.compare_exchange_strong(attaching, CLIENT_DETACHED))
+				{
+					header->session.fetch_add(1);
+					logger->warn("{}: client attaching to {} stopped responding", this->id, this->name);
+				}
+				state_signal->wait(seen, timeout);
+				continue;
+			}
+
+			header->server_state = SERVER_CONNECTED;
+			logger->info("{}: client attached to {}", this->id, this->name);
+
+			connection();
+
+			// Whatever the reason, the client attaches again from scratch.
+			header->session.fetch_add(1);
+			header->client_state = CLIENT_DETACHED;
+			state_signal->notify();
+			logger->info("{}: client detached from {}", this->id, this->name);
+		}
+
+		header->server_state = SERVER_DOWN;
+		state_signal->notify();
+		logger->info("{}: terminated, segment: {}.", this->id, this->name);
+	});
+
+	serverLifetimeDefinition.lifetime->add_action([this]() { terminate_connection(); });
+}
+
+SharedMemoryWire::Server::~Server()
+{
+	if (!serverLifetimeDefinition.is_terminated())
+	{
+		serverLifetimeDefinition.terminate();
+	}
+}
+
+void SharedMemoryWire::Server::create_segment(size_t size)
+{
+	segment = util::shared_memory_segment::create(name, size);
+	if (segment.is_valid())
+	{
+		return;
+	}
+
+	RD_ASSERT_THROW_MSG(!is_served(name), "shared memory segment " + name + " is used by another server")
+	logger->warn("{}: replacing segment {} left by a server which is gone", this->id, name);
+	segment = util::shared_memory_segment::create(name, size, true);
+	RD_ASSERT_THROW_MSG(segment.is_valid(), "shared memory segment " + name + " was taken meanwhile")
+}
+
+bool SharedMemoryWire::Server::is_served(std::string const& name) const
+{
+	const util::shared_memory_segment existing = util::shared_memory_segment::open(name);
+	auto const* existing_header = static_cast<segment_header const*>(existing.data());
+	// Not one of ours, or not initialized yet by a server starting right now: left alone either way.
+	if (!existing.is_valid() || existing.get_size() < sizeof(segment_header) || existing_header->magic != SEGMENT_MAGIC ||
+		existing_header->version != SEGMENT_VERSION)
+	{
+		return true;
+	}
+
+	// A running server bumps the state word while accepting, and its heartbeat while connected. Its state alone doesn't
+	// tell: a crashed one never got to set it down, and one just created hasn't set it up yet.
+	const uint32_t state_word = existing_header->state_word;
+	const uint32_t heartbeat = existing_header->rings[0].heartbeat;
+	for (int32_t i = 0; i <= MaximumHeartbeatDelay; ++i)
+	{
+		std::this_thread::sleep_for((std::max)(timeout, heartBeatInterval));
+		if (existing_header->state_word != state_word || existing_header->rings[0].heartbeat != heartbeat)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SharedMemoryWire::Server::counterpart_attached() const
+{
+	return header->client_state == CLIENT_ATTACHED;
+}
+}	 // namespace rd
@@ -0,0 +1,172 @@
+#ifndef RD_CPP_SHAREDMEMORYWIRE_H
+#define RD_CPP_SHAREDMEMORYWIRE_H
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable:4251)
+#endif
+
+#include "scheduler/base/IScheduler.h"
+#include "QueuedWireBase.h"
+#include "util/shared_memory.h"
+
+#include <string>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+
+#include <rd_framework_export.h>
+
+namespace rd
+{
+/**
+ * \brief Wire between two rd-cpp peers of the same host, over a pair of single producer single consumer byte rings
+ * in a named shared memory segment. The Server creates the segment, a Client attaches to it by name, one at a time.
+ * Same send/advise and connected/heartbeatAlive semantics as SocketWire: messages sent while disconnected are queued,
+ * and the ones the counterpart didn't read are sent again after it reattaches. Messages are framed and queued by
+ * QueuedWireBase, droppable ones included; compact encoding is never enabled here, packages go out as queued.
+ */
+class RD_FRAMEWORK_API SharedMemoryWire
+{
+	static std::chrono::milliseconds timeout;
+
+	struct ring_header;
+	struct segment_header;
+	class ring;
+
+public:
+	class RD_FRAMEWORK_API Base : public QueuedWireBase
+	{
+	protected:
+		static std::shared_ptr<spdlog::logger> logger;
+
+		std::mutex lock;
+		std::condition_variable cv;
+
+		std::thread thread{};
+
+		IScheduler* scheduler = nullptr;
+
+		// Replaced by the client on each attach, under lock.
+		util::shared_memory_segment segment;
+		segment_header* header = nullptr;
+		std::unique_ptr<util::shared_memory_signal> state_signal;
+		std::unique_ptr<ring> outgoing;
+		std::unique_ptr<ring> incoming;
+
+		// Whether the current connection is up, cleared by whichever thread notices it's not.
+		std::atomic<bool> linked{false};
+		std::atomic<bool> terminating{false};
+
+		sequence_number_t max_received_seqn = 0;
+		// Highest sequence number the counterpart read and this wire acknowledged to its send processor.
+		sequence_number_t max_consumed_seqn = 0;
+
+		// Maps the rings of [segment] after its header, [server_side] tells which one this wire writes.
+		void map_rings(std::string const& name, bool server_side);
+
+		// Lets go of [segment] and its rings.
+		void unmap_rings();
+
+		bool is_linked() const;
+
+		virtual bool counterpart_attached() const = 0;
+
+		/**
+		 * \brief Runs one connection over the mapped rings until either side detaches or stops responding.
+		 */
+		void connection();
+
+		void receiverProc();
+
+		// Passes what the counterpart read on to the send processor, as SocketWire does with acks.
+		void acknowledge_consumed();
+
+		std::future<void> start_heartbeat(Lifetime lifetime);
+
+		void wake_all();
+
+		void terminate_connection();
+
+	public:
+		static constexpr int32_t MaximumHeartbeatDelay = 3;
+		// Heartbeats missed before the counterpart is considered gone, it doesn't close anything when it crashes.
+		static constexpr int32_t DisconnectHeartbeatDelay = 20;
+		std::chrono::milliseconds heartBeatInterval = std::chrono::milliseconds(500);
+
+		// region ctor/dtor
+
+		Base(std::string id, Lifetime lifetime, IScheduler* scheduler);
+
+		virtual ~Base() override;
+
+		// endregion
+
+		/**
+		 * \brief Writes packages [first, last) numbered from [first_seqn] on to the outgoing ring, waking the counterpart once.
+		 */
+		bool send0(ByteBufferAsyncProcessor::package_iterator first, ByteBufferAsyncProcessor::package_iterator last,
+			sequence_number_t first_seqn) const override;
+
+	private:
+		LifetimeDefinition lifetimeDef;
+	};
+
+	class RD_FRAMEWORK_API Client : public Base
+	{
+		uint32_t session = 0;
+
+	protected:
+		bool counterpart_attached() const override;
+
+	public:
+		std::string name;
+
+		// region ctor/dtor
+
+		Client(Lifetime parentLifetime, IScheduler* scheduler, std::string name, const std::string& id = "ClientSharedMemory");
+
+		virtual ~Client() override;
+		// endregion
+
+	private:
+		LifetimeDefinition clientLifetimeDefinition;
+	};
+
+	class RD_FRAMEWORK_API Server : public Base
+	{
+		// Whether the segment [name] belongs to a server still running, rather than one which crashed.
+		bool is_served(std::string const& name) const;
+
+		// Creates [segment] of [size] bytes under [name], throws if another server uses it.
+		void create_segment(size_t size);
+
+	protected:
+		bool counterpart_attached() const override;
+
+	public:
+		static constexpr size_t DEFAULT_RING_CAPACITY = 1u << 22;
+
+		/**
+		 * \brief Name of the segment clients attach to, chosen at random when not given.
+		 * The server fails to start if another one still uses it.
+		 */
+		std::string name;
+
+		// region ctor/dtor
+
+		Server(Lifetime lifetime, IScheduler* scheduler, std::string name = {}, size_t ring_capacity = DEFAULT_RING_CAPACITY,
+			const std::string& id = "ServerSharedMemory");
+
+		virtual ~Server() override;
+		// endregion
+	private:
+		LifetimeDefinition serverLifetimeDefinition;
+	};
+};
+}	 // namespace rd
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#endif	  // RD_CPP_SHAREDMEMORYWIRE_H
@@ -1,6 +1,7 @@
 #include "wire/SocketWire.h"
 
 #include <util/thread_util.h>
+#include <util/lz_codec.h>
 
 #include "spdlog/sinks/stdout_color_sinks.h"
 
@@ -8,6 +9,7 @@
 #include <ActiveSocket.h>
 #include <PassiveSocket.h>
 
+#include <cstring>
 #include <utility>
 #include <thread>
 #include <csignal>
@@ -21,11 +23,25 @@ std::chrono::milliseconds SocketWire::timeout = std::chrono::milliseconds(500);
 
 constexpr int32_t SocketWire::Base::ACK_MESSAGE_LENGTH;
 constexpr int32_t SocketWire::Base::PING_MESSAGE_LENGTH;
+constexpr int32_t SocketWire::Base::ENCODING_MESSAGE_LENGTH;
+constexpr sequence_number_t SocketWire::Base::ENCODING_COMPACT;
+constexpr sequence_number_t SocketWire::Base::ENCODING_COMPRESSION;
+constexpr int32_t SocketWire::Base::COMPRESSED_PACKAGE_FLAG;
+constexpr size_t SocketWire::Base::DEFAULT_COMPRESSION_THRESHOLD;
+constexpr int32_t SocketWire::Base::COMPACT_MESSAGE_FLAG;
 constexpr int32_t SocketWire::Base::PACKAGE_HEADER_LENGTH;
+constexpr int32_t SocketWire::Base::DIRECT_RECEIVE_THRESHOLD;
+constexpr int32_t SocketWire::Base::MAX_SEND_VECTOR;
+constexpr int32_t SocketWire::Base::DEFAULT_ACK_BATCH_SIZE;
 
 SocketWire::Base::Base(std::string id, Lifetime parentLifetime, IScheduler* scheduler)
-	: WireBase(scheduler), id(std::move(id)), scheduler(scheduler), lifetimeDef(parentLifetime)
+	: QueuedWireBase(std::move(id), scheduler), scheduler(scheduler), lifetimeDef(parentLifetime)
 {
+	async_send_buffer.set_congestion_handler([this](bool value) { congested.set(value); });
+	async_send_buffer.set_overflow_handler([this]() {
+		logger->error("{}: counterpart stopped acknowledging, shutting the connection down", this->id);
+		try_shutdown_connection();
+	});
 	async_send_buffer.pause("initial");
 	async_send_buffer.start();
 	ping_pkg_header.write_integral(PING_MESSAGE_LENGTH);
@@ -41,6 +57,7 @@ SocketWire::Base::~Base()
 
 void SocketWire::Base::receiverProc() const
 {
+	async_send_buffer.set_receiver_thread(std::this_thread::get_id());
 	while (!lifetimeDef.lifetime->is_terminated())
 	{
 		try
@@ -68,30 +85,144 @@ void SocketWire::Base::receiverProc() const
 	}
 }
 
-bool SocketWire::Base::send0(Buffer::ByteArray const& msg, sequence_number_t seqn) const
+bool SocketWire::Base::send0(ByteBufferAsyncProcessor::package_iterator first, ByteBufferAsyncProcessor::package_iterator last,
+	sequence_number_t first_seqn) const
 {
+	// Only ever called from the send processor thread.
+	static thread_local std::vector<iovec> send_vector;
+	static thread_local std::vector<Buffer::ByteArray> compressed_bodies;
+	static thread_local std::vector<Buffer::ByteArray> encoded_bodies;
+	static thread_local Buffer::packed_layout layout;
+
 	try
 	{
 		std::lock_guard<decltype(socket_send_lock)> guard(socket_send_lock);
 
-		int32_t msglen = static_cast<int32_t>(msg.size());
+		const size_t threshold = counterpart_compression ? compression_threshold.load() : 0;
 
 		send_package_header.rewind();
-		send_package_header.write_integral(msglen);
-		send_package_header.write_integral(seqn);
+		send_vector.clear();
+		sequence_number_t seqn = first_seqn;
+		size_t total = 0;
+		size_t compressed_count = 0;
+		size_t encoded_count = 0;
+		for (auto it = first; it != last; ++it)
+		{
+			const Buffer::word_t* body = it->data();
+			int32_t body_size = static_cast<int32_t>(it->size());
+
+			// Encoded for this connection only, the queued message stays plain in case it has to be sent again.
+			int32_t message_length;
+			std::memcpy(&message_length, body, sizeof(int32_t));
+			if ((message_length & PACKED_LAYOUT_FLAG) != 0)
+			{
+				if (encoded_bodies.size() == encoded_count)
+				{
+					encoded_bodies.emplace_back();
+				}
+				auto& encoded = encoded_bodies[encoded_count++];
+
+				body_size = read_packed_layout(body, it->size(), layout);
+				if (counterpart_compact)
+				{
+					layout.compact(body, static_cast<size_t>(body_size), encoded);
+					message_length = static_cast<int32_t>(encoded.size() - sizeof(int32_t)) | COMPACT_MESSAGE_FLAG;
+				}
+				else
+				{
+					encoded.assign(body, body + body_size);
+					message_length = body_size - static_cast<int32_t>(sizeof(int32_t));
+				}
+				std::memcpy(encoded.data(), &message_length, sizeof(int32_t));
+				body = encoded.data();
+				body_size = static_cast<int32_t>(encoded.size());
+			}
+			int32_t header_size = body_size;
 
-		RD_ASSERT_THROW_MSG(
-			socket_provider->Send(send_package_header.data(), send_package_header.get_position()) == PACKAGE_HEADER_LENGTH,
+			const auto raw_size = static_cast<size_t>(body_size);
+			if (threshold > 0 && raw_size >= threshold && raw_size > sizeof(int32_t))
+			{
+				if (compressed_bodies.size() == compressed_count)
+				{
+					compressed_bodies.emplace_back();
+				}
+				auto& compressed = compressed_bodies[compressed_count];
+				compressed.resize(raw_size);
+
+				// Only worth it if the compressed body, raw size included, is smaller than the raw one.
+				const size_t compressed_size =
+					util::lz_compress(body, raw_size, compressed.data() + sizeof(int32_t), raw_size - sizeof(int32_t));
+				if (compressed_size > 0)
+				{
+					std::memcpy(compressed.data(), &body_size, sizeof(int32_t));
+					body = compressed.data();
+					body_size = static_cast<int32_t>(compressed_size + sizeof(int32_t));
+					header_size = body_size | COMPRESSED_PACKAGE_FLAG;
+					++compressed_count;
+				}
+			}
+
+			send_package_header.write_integral(header_size);
+			send_package_header.write_integral(seqn++);
+			total += PACKAGE_HEADER_LENGTH + body_size;
+
+			send_vector.push_back({nullptr, static_cast<size_t>(PACKAGE_HEADER_LENGTH)});
+			send_vector.push_back({const_cast<Buffer::word_t*>(body), static_cast<size_t>(body_size)});
+		}
+
+		sequence_number_t ack = 0;
+		if (take_ack(ack))
+		{
+			send_package_header.write_integral(ACK_MESSAGE_LENGTH);
+			send_package_header.write_integral(ack);
+			send_vector.push_back({nullptr, static_cast<size_t>(PACKAGE_HEADER_LENGTH)});
+		}
+
+		// Pointers into send_package_header are only stable once every header is written.
+		Buffer::word_t* header = send_package_header.data();
+		for (size_t i = 0; i < send_vector.size(); i += 2, header += PACKAGE_HEADER_LENGTH)
+		{
+			send_vector[i].iov_base = header;
+		}
+
+#ifdef _WIN32
+		// Vectored sends are emulated with one send per buffer there, gathering into one buffer is cheaper.
+		static thread_local Buffer::ByteArray gathered;
+		gathered.clear();
+		for (auto const& vec : send_vector)
+		{
+			auto const* begin = static_cast<Buffer::word_t const*>(vec.iov_base);
+			gathered.insert(gathered.end(), begin, begin + vec.iov_len);
+		}
+		RD_ASSERT_THROW_MSG(socket_provider->Send(gathered.data(), gathered.size()) == static_cast<int32_t>(gathered.size()),
 			this->id +
-				": failed to send header over the network"
+				": failed to send packages over the network"
 				", reason: " +
-				socket_provider->DescribeError())
-
-		RD_ASSERT_THROW_MSG(socket_provider->Send(msg.data(), msglen) == msglen, this->id +
-																					 ": failed to send package over the network"
-																					 ", reason: " +
-																					 socket_provider->DescribeError());
-		logger->info("{}: were sent {} bytes", this->id, msglen);
+				socket_provider->DescribeError());
+#else
+		size_t next = 0;
+		while (next < send_vector.size())
+		{
+			const auto count = (std::min)(static_cast<int32_t>(send_vector.size() - next), MAX_SEND_VECTOR);
+			int32_t sent = socket_provider->Send(&send_vector[next], count);
+			RD_ASSERT_THROW_MSG(sent > 0, this->id +
+											  ": failed to send packages over the network"
+											  ", reason: " +
+											  socket_provider->DescribeError());
+
+			// Partial send: skip what went through and resume in the middle of the buffer it stopped in.
+			while (next < send_vector.size() && static_cast<size_t>(sent) >= send_vector[next].iov_len)
+			{
+				sent -= static_cast<int32_t>(send_vector[next++].iov_len);
+			}
+			if (sent > 0)
+			{
+				send_vector[next].iov_base = static_cast<Buffer::word_t*>(send_vector[next].iov_base) + sent;
+				send_vector[next].iov_len -= sent;
+			}
+		}
+#endif
+		logger->info("{}: were sent {} packages ({} compressed), {} bytes", this->id, seqn - first_seqn, compressed_count, total);
 		//        RD_ASSERT_MSG(socketProvider->Flush(), "{}: failed to flush");
 		return true;
 	}
@@ -103,29 +234,41 @@ bool SocketWire::Base::send0(Buffer::ByteArray const& msg, sequence_number_t seq
 	}
 }
 
-void SocketWire::Base::send(RdId const& rd_id, std::function<void(Buffer& buffer)> writer) const
+void SocketWire::Base::enable_compact_encoding()
 {
-	RD_ASSERT_MSG(!rd_id.isNull(), "{}: id mustn't be null");
-
-	Buffer local_send_buffer;
-	local_send_buffer.write_integral<int32_t>(0);	 // placeholder for length
-	rd_id.write(local_send_buffer);					 // write id
-	local_send_buffer.write_integral<int16_t>(0);	 // placeholder for context
-	writer(local_send_buffer);						 // write rest
-
-	int32_t len = static_cast<int32_t>(local_send_buffer.get_position());
+	compact_encoding_enabled = true;
+}
 
-	local_send_buffer.rewind();
-	local_send_buffer.write_integral<int32_t>(len - 4);
-	local_send_buffer.set_position(len);
-	async_send_buffer.put(std::move(local_send_buffer).getRealArray());
+void SocketWire::Base::enable_compression(size_t threshold)
+{
+	compression_threshold = (std::max)(threshold, size_t{1});
 }
 
 void SocketWire::Base::set_socket_provider(std::shared_ptr<CActiveSocket> new_socket)
 {
+	// The previous counterpart stopped acknowledging: what it never saw is dropped and sending starts afresh.
+	async_send_buffer.recover();
 	{
 		std::lock_guard<decltype(socket_send_lock)> guard(socket_send_lock);
 		socket_provider = std::move(new_socket);
+		counterpart_compact = false;
+		counterpart_compression = false;
+		// Whatever the previous counterpart didn't see acknowledged it sends again, which acknowledges it anew.
+		ack_seqn = 0;
+		sent_ack_seqn = 0;
+		unacked_packages = 0;
+		const sequence_number_t encoding =
+			(compact_encoding_enabled ? ENCODING_COMPACT : 0) | (compression_threshold > 0 ? ENCODING_COMPRESSION : 0);
+		if (encoding != 0)
+		{
+			Buffer encoding_pkg_header(PACKAGE_HEADER_LENGTH);
+			encoding_pkg_header.write_integral(ENCODING_MESSAGE_LENGTH);
+			encoding_pkg_header.write_integral(encoding);
+			if (socket_provider->Send(encoding_pkg_header.data(), PACKAGE_HEADER_LENGTH) != PACKAGE_HEADER_LENGTH)
+			{
+				logger->warn("{}: failed to announce encoding, reason: {}", this->id, socket_provider->DescribeError());
+			}
+		}
 		socket_send_var.notify_all();
 	}
 	{
@@ -201,12 +344,21 @@ bool SocketWire::Base::read_from_socket(Buffer::word_t* res, int32_t msglen) con
 		}
 		else
 		{
-			if (hi == receiver_buffer.end())
+			// Nothing is buffered: a large rest goes straight into res, skipping the copy out of receiver_buffer.
+			const bool direct = rest >= DIRECT_RECEIVE_THRESHOLD;
+			if (!direct && hi == receiver_buffer.end())
 			{
 				hi = lo = receiver_buffer.begin();
 			}
+			// About to wait for the counterpart: whatever it sent so far gets acknowledged first.
+			if (unacked_packages > 0)
+			{
+				unacked_packages = 0;
+				flush_ack();
+			}
 			logger->info("{}: receive started", this->id);
-			int32_t read = socket_provider->Receive(static_cast<int32_t>(receiver_buffer.end() - hi), &*hi);
+			int32_t read = direct ? socket_provider->Receive(rest, res + ptr)
+								  : socket_provider->Receive(static_cast<int32_t>(receiver_buffer.end() - hi), &*hi);
 			if (read == -1)
 			{
 				auto err = socket_provider->GetSocketError();
@@ -223,7 +375,14 @@ bool SocketWire::Base::read_from_socket(Buffer::word_t* res, int32_t msglen) con
 				logger->info("{}: socket was shut down for receiving", this->id);
 				return false;
 			}
-			hi += read;
+			if (direct)
+			{
+				ptr += read;
+			}
+			else
+			{
+				hi += read;
+			}
 			if (read > 0)
 			{
 				logger->info("{}: receive finished: {} bytes read", this->id, read);
@@ -294,37 +453,82 @@ std::pair<int, sequence_number_t> SocketWire::Base::read_header() const
 			async_send_buffer.acknowledge(seqn);
 			continue;
 		}
+		if (len == ENCODING_MESSAGE_LENGTH)
+		{
+			logger->debug("{}: counterpart announced encoding {}", this->id, seqn);
+			counterpart_compact = (seqn & ENCODING_COMPACT) != 0;
+			counterpart_compression = (seqn & ENCODING_COMPRESSION) != 0;
+			continue;
+		}
 		return std::make_pair(len, seqn);
 	}
 }
 
 int32_t SocketWire::Base::read_package() const
 {
-	receive_pkg.rewind();
-
 	const auto pair = read_header();
 	if (pair == INVALID_HEADER)
 	{
 		logger->debug("{}: failed to read header", this->id);
 		return -1;
 	}
-	const auto len = pair.first;
+	auto len = pair.first;
 	const auto seqn = pair.second;
 
 	logger->debug("{}: read len={}, seqn={}, max_received_seqn={}", this->id, len, seqn, max_received_seqn);
 
-	receive_pkg.require_available(len);
-	if (!read_data_from_socket(receive_pkg.data(), len))
+	if ((len & COMPRESSED_PACKAGE_FLAG) != 0)
+	{
+		const int32_t compressed_len = len & ~COMPRESSED_PACKAGE_FLAG;
+		if (compressed_pkg.size() < static_cast<size_t>(compressed_len))
+		{
+			compressed_pkg.resize(compressed_len);
+		}
+		if (compressed_len < static_cast<int32_t>(sizeof(int32_t)) || !read_data_from_socket(compressed_pkg.data(), compressed_len))
+		{
+			logger->debug("{}: failed to read compressed package", this->id);
+			return -1;
+		}
+
+		std::memcpy(&len, compressed_pkg.data(), sizeof(int32_t));
+		if (len < 0 || !util::lz_decompress(compressed_pkg.data() + sizeof(int32_t), compressed_len - sizeof(int32_t),
+						   receive_pkg.prepare(len), len))
+		{
+			logger->error("{}: failed to decompress package, seqn={}", this->id, seqn);
+			return -1;
+		}
+	}
+	else if (!read_data_from_socket(receive_pkg.prepare(len), len))
 	{
 		logger->debug("{}: failed to read package", this->id);
 		return -1;
 	}
-	send_ack(seqn);
-	if (seqn <= max_received_seqn && seqn != 1)
+
+	const size_t slab_misses = receive_pkg.get_slab_misses();
+	// Logged at the 1st, 2nd, 4th... miss, a scheduler that keeps lagging doesn't flood the log.
+	if (slab_misses != logged_slab_misses && (slab_misses & (slab_misses - 1)) == 0)
+	{
+		logger->warn("{}: {} package payloads allocated past the receive slab pool, messages wait longer for the scheduler "
+					 "than it covers, see set_max_receive_slabs",
+			this->id, slab_misses);
+	}
+	logged_slab_misses = slab_misses;
+	const bool duplicate = seqn <= max_received_seqn && seqn != 1;
+	if (!duplicate)
+	{
+		max_received_seqn = seqn;
+	}
+	// Duplicates are resent after a reconnect, acknowledging max_received_seqn covers them too.
+	ack_seqn = max_received_seqn;
+	if (++unacked_packages >= ack_batch_size)
+	{
+		unacked_packages = 0;
+		flush_ack();
+	}
+	if (duplicate)
 	{
 		return true;
 	}
-	max_received_seqn = seqn;
 
 	logger->info("{}: was received package, bytes={}, seqn={}", this->id, len, seqn);
 	return len;
@@ -332,7 +536,15 @@ int32_t SocketWire::Base::read_package() const
 
 bool SocketWire::Base::read_and_dispatch_message() const
 {
-	sz = (sz == -1 ? receive_pkg.read_integral<int32_t>() : sz);
+	if (sz == -1)
+	{
+		sz = receive_pkg.read_integral<int32_t>();
+		compact_message = sz != -1 && (sz & COMPACT_MESSAGE_FLAG) != 0;
+		if (compact_message)
+		{
+			sz &= ~COMPACT_MESSAGE_FLAG;
+		}
+	}
 	if (sz == -1)
 	{
 		logger->debug("{}: sz == -1", this->id);
@@ -347,6 +559,20 @@ bool SocketWire::Base::read_and_dispatch_message() const
 	logger->trace("{}: message info: sz={}, id={}", this->id, sz, id_);
 	const RdId rd_id{id_};
 	sz -= 8;	// RdId
+
+	// Usual case, the whole message is in the package just received: the broker gets a view of the package instead of a copy.
+	Buffer payload(0);
+	if (message.get_position() == 0 && receive_pkg.try_read_view(sz, payload))
+	{
+		payload.set_compact(compact_message);
+		message_broker.dispatch(rd_id, std::move(payload));
+		logger->debug("{}: message dispatched", this->id);
+
+		sz = -1;
+		id_ = -1;
+		return true;
+	}
+
 	message.require_available(sz);
 
 	if (!receive_pkg.read(message.data() + message.get_position(), sz - message.get_position()))
@@ -356,6 +582,7 @@ bool SocketWire::Base::read_and_dispatch_message() const
 	}
 
 	logger->debug("{}: message received", this->id);
+	message.set_compact(compact_message);
 	message_broker.dispatch(rd_id, std::move(message));
 	logger->debug("{}: message dispatched", this->id);
 
@@ -393,13 +620,19 @@ void SocketWire::Base::ping() const
 		ping_pkg_header.write_integral(counterpart_timestamp);
 		{
 			std::lock_guard<decltype(socket_send_lock)> guard(socket_send_lock);
+			sequence_number_t ack = 0;
+			if (take_ack(ack))
+			{
+				ping_pkg_header.write_integral(ACK_MESSAGE_LENGTH);
+				ping_pkg_header.write_integral(ack);
+			}
 			int32_t sent = socket_provider->Send(ping_pkg_header.data(), ping_pkg_header.get_position());
 			if (sent == 0 && !socket_provider->IsSocketValid())
 			{
 				logger->debug("{}: failed to send ping over the network, reason: socket was shut down for sending", this->id);
 				return;
 			}
-			RD_ASSERT_THROW_MSG(sent == PACKAGE_HEADER_LENGTH,
+			RD_ASSERT_THROW_MSG(sent == static_cast<int32_t>(ping_pkg_header.get_position()),
 				fmt::format("{}: failed to send ping over the network, reason: {}", this->id, socket_provider->DescribeError()))
 		}
 
@@ -436,6 +669,56 @@ bool SocketWire::Base::send_ack(sequence_number_t seqn) const
 	}
 }
 
+bool SocketWire::Base::take_ack(sequence_number_t& seqn) const
+{
+	seqn = ack_seqn;
+	// Compared for inequality: the sequence restarts from 1 when the counterpart does.
+	if (seqn == 0 || seqn == sent_ack_seqn)
+	{
+		return false;
+	}
+	sent_ack_seqn = seqn;
+	return true;
+}
+
+bool SocketWire::Base::flush_ack() const
+{
+	sequence_number_t seqn = 0;
+	try
+	{
+		std::lock_guard<decltype(socket_send_lock)> guard(socket_send_lock);
+		if (!take_ack(seqn))
+		{
+			return true;
+		}
+		logger->trace("{} send ack {}", id, seqn);
+		ack_buffer.rewind();
+		ack_buffer.write_integral(ACK_MESSAGE_LENGTH);
+		ack_buffer.write_integral(seqn);
+		RD_ASSERT_THROW_MSG(socket_provider->Send(ack_buffer.data(), ack_buffer.get_position()) == PACKAGE_HEADER_LENGTH,
+			this->id +
+				": failed to send ack over the network"
+				", reason: " +
+				socket_provider->DescribeError())
+		return true;
+	}
+	catch (std::exception const& e)
+	{
+		logger->warn("{}: exception raised during ACK, seqn = {} | {}", id, seqn, e.what());
+		return false;
+	}
+}
+
+void SocketWire::Base::set_ack_batch_size(int32_t size)
+{
+	ack_batch_size = (std::max)(size, 1);
+}
+
+void SocketWire::Base::set_max_receive_slabs(size_t count)
+{
+	receive_pkg.set_max_pooled_slabs(count);
+}
+
 bool SocketWire::Base::try_shutdown_connection() const
 {
 	auto s = get_socket_provider();
@@ -7,12 +7,12 @@
 #endif
 
 #include "scheduler/base/IScheduler.h"
-#include "base/WireBase.h"
-#include "ByteBufferAsyncProcessor.h"
+#include "QueuedWireBase.h"
 #include "PkgInputStream.h"
 
 #include <string>
 #include <array>
+#include <atomic>
 #include <condition_variable>
 
 #include <rd_framework_export.h>
@@ -28,7 +28,7 @@ class RD_FRAMEWORK_API SocketWire
 	static std::chrono::milliseconds timeout;
 
 public:
-	class RD_FRAMEWORK_API Base : public WireBase
+	class RD_FRAMEWORK_API Base : public QueuedWireBase
 	{
 	protected:
 		static std::shared_ptr<spdlog::logger> logger;
@@ -39,25 +39,39 @@ public:
 
 		std::thread thread{};
 
-		std::string id;
 		IScheduler* scheduler = nullptr;
 		std::shared_ptr<CSimpleSocket> socket_provider;
 
 		std::shared_ptr<CActiveSocket> socket;
 
 		mutable std::condition_variable socket_send_var;
-		mutable ByteBufferAsyncProcessor async_send_buffer{id + "-AsyncSendProcessor",
-			[this](Buffer::ByteArray const& it, sequence_number_t seqn) -> bool { return this->send0(it, seqn); }};
-
 		static constexpr size_t RECEIVE_BUFFER_SIZE = 1u << 16;
+		// Reads at least this large are received straight into their destination when nothing is buffered.
+		static constexpr int32_t DIRECT_RECEIVE_THRESHOLD = 1 << 12;
 		mutable std::array<Buffer::word_t, RECEIVE_BUFFER_SIZE> receiver_buffer{};
 		mutable decltype(receiver_buffer)::iterator lo = receiver_buffer.begin(), hi = receiver_buffer.begin();
 
 		static constexpr int32_t ACK_MESSAGE_LENGTH = -1;
 		static constexpr int32_t PING_MESSAGE_LENGTH = -2;
+		// Sent on connect by wires with compact encoding or compression enabled, its sequence number field holds ENCODING_ flags.
+		static constexpr int32_t ENCODING_MESSAGE_LENGTH = -3;
+		static constexpr sequence_number_t ENCODING_COMPACT = 1;
+		static constexpr sequence_number_t ENCODING_COMPRESSION = 2;
+		// Set in the length of packages whose body is an int32 raw size followed by the LZ4 block of the raw package.
+		static constexpr int32_t COMPRESSED_PACKAGE_FLAG = 1 << 30;
+		// Set in the length of messages whose payload is compact, far above any real message length.
+		static constexpr int32_t COMPACT_MESSAGE_FLAG = 1 << 30;
 		static constexpr int32_t PACKAGE_HEADER_LENGTH = sizeof(ACK_MESSAGE_LENGTH) + sizeof(sequence_number_t);
 		mutable Buffer ack_buffer{PACKAGE_HEADER_LENGTH};
 
+		// Highest received sequence number, acknowledged cumulatively by the next ack going out.
+		mutable std::atomic<sequence_number_t> ack_seqn{0};
+		// Last sequence number acknowledged on the current connection, guarded by socket_send_lock.
+		mutable sequence_number_t sent_ack_seqn = 0;
+		// Packages received since the receiver thread last flushed the ack.
+		mutable int32_t unacked_packages = 0;
+		std::atomic<int32_t> ack_batch_size{DEFAULT_ACK_BATCH_SIZE};
+
 		/**
 		 * \brief Timestamp of this wire which increases at intervals of [heartBeatInterval].
 		 */
@@ -75,13 +89,28 @@ public:
 
 		mutable Buffer ping_pkg_header{PACKAGE_HEADER_LENGTH};
 
+		// Whether the counterpart announced compact encoding on the current connection.
+		mutable std::atomic<bool> counterpart_compact{false};
+
+		// Packages at least this large are compressed, 0 when compression is disabled.
+		std::atomic<size_t> compression_threshold{0};
+		mutable std::atomic<bool> counterpart_compression{false};
+		// Compressed body of the package being received, decompressed straight into the package stream.
+		mutable Buffer::ByteArray compressed_pkg;
+
 		mutable sequence_number_t max_received_seqn = 0;
+		// Headers of the packages sent by the current send0 call, back to back.
 		mutable Buffer send_package_header{PACKAGE_HEADER_LENGTH};
+		// Most buffers passed to one vectored send, IOV_MAX is 1024 on every platform we run on.
+		static constexpr int32_t MAX_SEND_VECTOR = 1024;
 
 		static constexpr int32_t CHUNK_SIZE = 16370;
 		mutable int32_t sz = -1;
+		mutable bool compact_message = false;
 		mutable RdId::hash_t id_ = -1;
 		mutable PkgInputStream receive_pkg{[this]() -> int32_t { return this->read_package(); }};
+		// Slab misses of receive_pkg as of the previous package, receiver thread only.
+		mutable size_t logged_slab_misses = 0;
 
 		mutable Buffer message{CHUNK_SIZE};
 
@@ -100,10 +129,18 @@ public:
 
 		void set_socket_provider(std::shared_ptr<CActiveSocket> new_socket);
 
+		// Takes the ack to send, if any. Requires socket_send_lock.
+		bool take_ack(sequence_number_t& seqn) const;
+
 		CSimpleSocket* get_socket_provider() const;
 
 	public:
 		static constexpr int32_t MaximumHeartbeatDelay = 3;
+		/**
+		 * \brief Whether the send window is congested: packages pile up faster than the counterpart acknowledges them.
+		 * Set from the sending thread.
+		 */
+		Property<bool> congested{false};
 		std::chrono::milliseconds heartBeatInterval = std::chrono::milliseconds(500);
 
 		// region ctor/dtor
@@ -122,9 +159,12 @@ public:
 
 		void receiverProc() const;
 
-		bool send0(Buffer::ByteArray const& msg, sequence_number_t seqn) const;
+		/**
+		 * \brief Sends packages [first, last) numbered from [first_seqn] on, headers and bodies with as few syscalls as possible.
+		 */
+		bool send0(ByteBufferAsyncProcessor::package_iterator first, ByteBufferAsyncProcessor::package_iterator last,
+			sequence_number_t first_seqn) const override;
 
-		void send(RdId const& rd_id, std::function<void(Buffer& buffer)> writer) const override;
 
 		static bool connection_established(int32_t timestamp, int32_t acknowledged_timestamp);
 
@@ -134,6 +174,40 @@ public:
 
 		bool send_ack(sequence_number_t seqn) const;
 
+		/**
+		 * \brief Sends an ack for the highest received sequence number, unless it was already acknowledged.
+		 */
+		bool flush_ack() const;
+
+		static constexpr int32_t DEFAULT_ACK_BATCH_SIZE = 32;
+
+		/**
+		 * \brief Received packages are acknowledged cumulatively: piggybacked on outgoing packages and pings,
+		 * and otherwise sent before the receiver waits for more data or once [size] packages are left unacknowledged.
+		 */
+		void set_ack_batch_size(int32_t size);
+
+		/**
+		 * \brief Payloads are sent with packed integers in LEB128 once the counterpart announced it does the same, see Buffer::write_packed.
+		 * Announcing it breaks counterparts that don't know about it, so only enable it, before connecting,
+		 * when the other side is known to be an rd-cpp wire supporting it.
+		 */
+		void enable_compact_encoding();
+
+		static constexpr size_t DEFAULT_COMPRESSION_THRESHOLD = 1u << 12;
+
+		/**
+		 * \brief Packages of at least [threshold] bytes are sent LZ4 compressed once the counterpart announced it does the same,
+		 * if that makes them smaller. Same caveat as enable_compact_encoding about counterparts not knowing about it.
+		 */
+		void enable_compression(size_t threshold = DEFAULT_COMPRESSION_THRESHOLD);
+
+		/**
+		 * \brief Payloads of received packages are kept in up to [count] reused slabs, one per package while views of its
+		 * messages are alive, see PkgInputStream. Raise it when the scheduler lags further behind, the wire logs it.
+		 */
+		void set_max_receive_slabs(size_t count);
+
 		bool try_shutdown_connection() const;
 		
 	private:		
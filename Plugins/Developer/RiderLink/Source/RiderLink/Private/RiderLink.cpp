@@ -73,6 +73,11 @@ void FRiderLinkModule::InitProtocol()
 			JetBrains::EditorPlugin::UE4Library::serializersOwner.registerSerializersCore(
 				EditorModel->get_serialization_context().get_serializers()
 			);
+			// Log events are dropped rather than queued while Rider isn't keeping up with them.
+			if (auto const* UnrealLog = dynamic_cast<rd::RdReactiveBase const*>(&EditorModel->get_unrealLog()))
+			{
+				std::static_pointer_cast<rd::SocketWire::Base>(Protocol->wire)->set_droppable(ConnectionLifetime, UnrealLog->get_id());
+			}
 			ConnectionLifetime->add_action([&]() mutable
 			{
 				Scheduler.queue([&]()mutable
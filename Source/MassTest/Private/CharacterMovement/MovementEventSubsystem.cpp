@@ -0,0 +1,75 @@
+#include "CharacterMovement/MovementEventSubsystem.h"
+
+#include "EntityCommon.h"
+
+void UMovementEventSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	if (UMortonCompactionSubsystem* Compaction = Collection.InitializeDependency<UMortonCompactionSubsystem>())
+	{
+		EntitiesRemappedHandle = Compaction->OnEntitiesRemapped().AddUObject(this, &UMovementEventSubsystem::OnEntitiesRemapped);
+	}
+}
+
+void UMovementEventSubsystem::Deinitialize()
+{
+	if (UMortonCompactionSubsystem* Compaction = GetWorld()->GetSubsystem<UMortonCompactionSubsystem>())
+	{
+		Compaction->OnEntitiesRemapped().Remove(EntitiesRemappedHandle);
+	}
+
+	Super::Deinitialize();
+}
+
+FMovementEventBuffer* UMovementEventSubsystem::AcquireBuffer()
+{
+	FScopeLock Lock{&BufferCriticalSection};
+
+	TUniquePtr<FMovementEventBuffer> Buffer = FreeBuffers.IsEmpty() ? MakeUnique<FMovementEventBuffer>() : FreeBuffers.Pop(false);
+	FMovementEventBuffer* Result = Buffer.Get();
+
+	// Writers never hand it back, it's merged and recycled by the next MergeEvents.
+	FilledBuffers.Add(MoveTemp(Buffer));
+	return Result;
+}
+
+void UMovementEventSubsystem::MergeEvents()
+{
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UMovementEventSubsystem::MergeEvents"), STAT_MovementEventMerge, STATGROUP_MassTest);
+
+	FScopeLock Lock{&BufferCriticalSection};
+
+	int32 NumEvents = 0;
+	for (const TUniquePtr<FMovementEventBuffer>& Buffer : FilledBuffers)
+	{
+		NumEvents += Buffer->Num();
+	}
+
+	Events.Reset(NumEvents);
+	for (TUniquePtr<FMovementEventBuffer>& Buffer : FilledBuffers)
+	{
+		Events.Append(*Buffer);
+		Buffer->Reset();
+		FreeBuffers.Add(MoveTemp(Buffer));
+	}
+	FilledBuffers.Reset();
+}
+
+void UMovementEventSubsystem::OnEntitiesRemapped(const FMassEntityRemap& EntityRemap)
+{
+	for (FMovementEvent& Event : Events)
+	{
+		UMortonCompactionSubsystem::Remap(EntityRemap, Event.Entity);
+	}
+
+	// An async simulation step that ran between frames leaves its events here until the next MergeEvents, after compaction.
+	FScopeLock Lock{&BufferCriticalSection};
+	for (const TUniquePtr<FMovementEventBuffer>& Buffer : FilledBuffers)
+	{
+		for (FMovementEvent& Event : *Buffer)
+		{
+			UMortonCompactionSubsystem::Remap(EntityRemap, Event.Entity);
+		}
+	}
+}
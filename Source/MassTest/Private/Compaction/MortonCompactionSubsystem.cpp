@@ -0,0 +1,165 @@
+#include "Compaction/MortonCompactionSubsystem.h"
+
+#include "Algo/StableSort.h"
+#include "Engine/World.h"
+#include "EntityCommon.h"
+#include "MassArchetypeTypes.h"
+#include "MassCommonFragments.h"
+#include "MassEntityManager.h"
+#include "MassEntityUtils.h"
+#include "MassExecutionContext.h"
+#include "Simulation/MassAsyncSimulationSubsystem.h"
+
+static TAutoConsoleVariable<float> CVarMassTestCompactionInterval{
+	TEXT("MassTest.Compaction.Interval"),
+	2.f,
+	TEXT("Seconds between two Morton sorting passes over character archetypes. 0 disables sorting.")};
+
+static TAutoConsoleVariable<float> CVarMassTestCompactionCellSize{
+	TEXT("MassTest.Compaction.CellSize"),
+	100.f,
+	TEXT("Locations are quantized to cells of this size in cm before computing their Morton code.")};
+
+void UMortonCompactionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CharacterQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	CharacterQuery.AddTagRequirement<FCharacterMovementTag>(EMassFragmentPresence::All);
+
+	if (GetWorld()->IsGameWorld())
+	{
+		PreActorTickHandle = FWorldDelegates::OnWorldPreActorTick.AddUObject(this, &UMortonCompactionSubsystem::OnPreActorTick);
+	}
+}
+
+void UMortonCompactionSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldPreActorTick.Remove(PreActorTickHandle);
+
+	Super::Deinitialize();
+}
+
+void UMortonCompactionSubsystem::OnPreActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld()) return;
+
+	const float Interval = CVarMassTestCompactionInterval.GetValueOnGameThread();
+	if (Interval <= 0.f) return;
+
+	if (PendingArchetypes.IsEmpty())
+	{
+		if (World->GetTimeSeconds() < NextPassTime) return;
+
+		NextPassTime = World->GetTimeSeconds() + Interval;
+		BeginPass();
+	}
+
+	if (PendingArchetypes.IsEmpty()) return;
+
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UMortonCompactionSubsystem::Compact"), STAT_MortonCompaction, STATGROUP_MassTest);
+
+	// Data moves between entities underneath anything still holding their handles: the simulation step and deferred commands go first.
+	if (UMassAsyncSimulationSubsystem* Simulation = World->GetSubsystem<UMassAsyncSimulationSubsystem>())
+	{
+		Simulation->WaitForSimulation();
+	}
+
+	FMassEntityManager& Manager = UE::Mass::Utils::GetEntityManagerChecked(*World);
+	Manager.FlushCommands();
+
+	FMassEntityRemap EntityRemap;
+	if (CompactArchetype(PendingArchetypes.Pop(false), EntityRemap))
+	{
+		EntitiesRemapped.Broadcast(EntityRemap);
+	}
+}
+
+void UMortonCompactionSubsystem::BeginPass()
+{
+	FMassEntityManager& Manager = UE::Mass::Utils::GetEntityManagerChecked(*GetWorld());
+	CharacterQuery.CacheArchetypes(Manager);
+
+	for (const FMassArchetypeHandle& Archetype : CharacterQuery.GetArchetypes())
+	{
+		const FMassArchetypeCompositionDescriptor& Composition = Manager.GetArchetypeComposition(Archetype);
+		if (Composition.SharedFragments.IsEmpty() && Composition.ChunkFragments.IsEmpty())
+		{
+			PendingArchetypes.Add(Archetype);
+		}
+	}
+}
+
+bool UMortonCompactionSubsystem::CompactArchetype(const FMassArchetypeHandle& Archetype, FMassEntityRemap& OutRemap)
+{
+	FMassEntityManager& Manager = UE::Mass::Utils::GetEntityManagerChecked(*GetWorld());
+	const float CellSize = FMath::Max(CVarMassTestCompactionCellSize.GetValueOnGameThread(), 1.f);
+
+	//~ Entities in memory order, with the Morton code of the cell they're in.
+	TArray<FMassEntityHandle> Entities;
+	TArray<TPair<uint64, int32>> Keys;
+
+	FMassExecutionContext ExecutionContext{Manager};
+	CharacterQuery.ForEachEntityChunk(FMassArchetypeEntityCollection{Archetype}, Manager, ExecutionContext, [&](FMassExecutionContext& Context) -> void
+	{
+		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
+		for (int32 i = 0; i < Context.GetNumEntities(); ++i)
+		{
+			const FVector& Location = Transforms[i].GetTransform().GetLocation();
+
+			// Biased so negative coordinates keep their order, 21 bits per axis covers ~2000km at the default cell size.
+			const uint64 X = (uint64)(FMath::FloorToInt64(Location.X / CellSize) + (1 << 20)) & 0x1FFFFF;
+			const uint64 Y = (uint64)(FMath::FloorToInt64(Location.Y / CellSize) + (1 << 20)) & 0x1FFFFF;
+
+			Keys.Emplace(FMath::MortonCode2_64(X) | (FMath::MortonCode2_64(Y) << 1), Entities.Num());
+			Entities.Add(Context.GetEntity(i));
+		}
+	});
+	//~
+
+	// Stable, so entities sharing a cell keep their relative order and a sorted archetype doesn't move at all.
+	Algo::StableSortBy(Keys, [](const TPair<uint64, int32>& Key) -> uint64 { return Key.Key; });
+
+	bool bAnyMoved = false;
+	for (int32 Slot = 0; Slot < Keys.Num() && !bAnyMoved; ++Slot)
+	{
+		bAnyMoved = Keys[Slot].Value != Slot;
+	}
+	if (!bAnyMoved) return false;
+
+	//~ Slot k receives the fragments of the k-th entity in Morton order, one fragment type at a time.
+	TArray<const UScriptStruct*> FragmentTypes;
+	Manager.GetArchetypeComposition(Archetype).Fragments.ExportTypes(FragmentTypes);
+
+	TArray<uint8, TAlignedHeapAllocator<16>> Scratch;
+	for (const UScriptStruct* Type : FragmentTypes)
+	{
+		const int32 Stride = Type->GetStructureSize();
+		Scratch.SetNumUninitialized(Stride * Entities.Num(), false);
+		Type->InitializeStruct(Scratch.GetData(), Entities.Num());
+
+		for (int32 Slot = 0; Slot < Keys.Num(); ++Slot)
+		{
+			Type->CopyScriptStruct(Scratch.GetData() + Slot * Stride, Manager.GetFragmentDataStruct(Entities[Keys[Slot].Value], Type).GetMemory());
+		}
+
+		for (int32 Slot = 0; Slot < Keys.Num(); ++Slot)
+		{
+			Type->CopyScriptStruct(Manager.GetFragmentDataStruct(Entities[Slot], Type).GetMemory(), Scratch.GetData() + Slot * Stride);
+		}
+
+		Type->DestroyStruct(Scratch.GetData(), Entities.Num());
+	}
+	//~
+
+	OutRemap.Reserve(Keys.Num());
+	for (int32 Slot = 0; Slot < Keys.Num(); ++Slot)
+	{
+		if (Keys[Slot].Value != Slot)
+		{
+			OutRemap.Add(Entities[Keys[Slot].Value], Entities[Slot]);
+		}
+	}
+
+	return true;
+}
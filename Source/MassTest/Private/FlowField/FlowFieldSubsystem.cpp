@@ -0,0 +1,240 @@
+#include "FlowField/FlowFieldSubsystem.h"
+
+#include "Async/ParallelFor.h"
+#include "Engine/LevelBounds.h"
+#include "Engine/World.h"
+#include "EntityCommon.h"
+#include "Lockstep/DeterministicMath.h"
+
+static TAutoConsoleVariable<float> CVarFlowFieldCellSize{
+	TEXT("MassTest.FlowField.CellSize"),
+	100.f,
+	TEXT("Size in cm of a flow field grid cell. Applied on the next grid build.")};
+
+static TAutoConsoleVariable<int32> CVarFlowFieldExpansionsPerFrame{
+	TEXT("MassTest.FlowField.ExpansionsPerFrame"),
+	16384,
+	TEXT("Max number of cells a single field expands per frame.")};
+
+static TAutoConsoleVariable<float> CVarFlowFieldEvictionTime{
+	TEXT("MassTest.FlowField.EvictionTime"),
+	10.f,
+	TEXT("Seconds after which an unused flow field is dropped from the cache.")};
+
+static constexpr float FLOW_FIELD_MAX_STEP_HEIGHT = 45.f;
+static constexpr float FLOW_FIELD_WALKABLE_FLOOR_Z = 0.71f;
+static constexpr int32 FLOW_FIELD_MAX_CELLS = 1024 * 1024;
+
+const FIntPoint FFlowField::DirectionOffsets[8] =
+{
+	{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1},
+};
+
+const FVector2f FFlowField::DirectionVectors[8] =
+{
+	{1.f, 0.f}, {UE_INV_SQRT_2, UE_INV_SQRT_2}, {0.f, 1.f}, {-UE_INV_SQRT_2, UE_INV_SQRT_2},
+	{-1.f, 0.f}, {-UE_INV_SQRT_2, -UE_INV_SQRT_2}, {0.f, -1.f}, {UE_INV_SQRT_2, -UE_INV_SQRT_2},
+};
+
+void UFlowFieldSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (InWorld.PersistentLevel)
+	{
+		BuildGrid(ALevelBounds::CalculateLevelBounds(InWorld.PersistentLevel));
+	}
+}
+
+void UFlowFieldSubsystem::Deinitialize()
+{
+	GridTask.Wait();
+	WaitForPendingWork();
+	Fields.Empty();
+
+	Super::Deinitialize();
+}
+
+MASSTEST_DETERMINISTIC_FP_BEGIN
+
+void UFlowFieldSubsystem::BuildGrid(const FBox& Bounds)
+{
+	check(IsInGameThread());
+
+	GridTask.Wait();
+	WaitForPendingWork();
+	Fields.Empty();
+	bGridReady = false;
+
+	if (!Bounds.IsValid) return;
+
+	float CellSize = FMath::Max(CVarFlowFieldCellSize.GetValueOnGameThread(), 1.f);
+	const FVector Size = Bounds.GetSize();
+	while ((Size.X / CellSize) * (Size.Y / CellSize) > FLOW_FIELD_MAX_CELLS)
+	{
+		CellSize *= 2.f;
+	}
+
+	Grid.Origin = FVector2D{Bounds.Min};
+	Grid.CellSize = CellSize;
+	Grid.SizeX = FMath::Max(FMath::CeilToInt32(Size.X / CellSize), 1);
+	Grid.SizeY = FMath::Max(FMath::CeilToInt32(Size.Y / CellSize), 1);
+	Grid.FloorHeights.Init(TNumericLimits<float>::Lowest(), Grid.Num());
+	Grid.Walkable.Init(false, Grid.Num());
+
+	GridTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, World = GetWorld(), TraceTop = Bounds.Max.Z + 1.f, TraceBottom = Bounds.Min.Z - 1.f]() -> void
+	{
+		DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UFlowFieldSubsystem::BuildGrid"), STAT_FlowFieldBuildGrid, STATGROUP_MassTest);
+
+		// One row per task. Scene queries are thread safe, and each row writes a disjoint range of the grid.
+		TArray<bool> CellWalkable;
+		CellWalkable.SetNumZeroed(Grid.Num());
+
+		ParallelFor(Grid.SizeY, [&](const int32 Y) -> void
+		{
+			const FCollisionQueryParams QueryParams{SCENE_QUERY_STAT(FlowFieldGrid), false};
+			for (int32 X = 0; X < Grid.SizeX; ++X)
+			{
+				const FVector2D Center = Grid.GetCellCenter(FIntPoint{X, Y});
+
+				FHitResult Hit;
+				if (!World->LineTraceSingleByChannel(Hit, FVector{Center, TraceTop}, FVector{Center, TraceBottom}, ECC_WorldStatic, QueryParams)) continue;
+
+				const int32 Index = Y * Grid.SizeX + X;
+				Grid.FloorHeights[Index] = Hit.ImpactPoint.Z;
+				CellWalkable[Index] = Hit.ImpactNormal.Z >= FLOW_FIELD_WALKABLE_FLOOR_Z;
+			}
+		});
+
+		for (int32 i = 0; i < CellWalkable.Num(); ++i)
+		{
+			Grid.Walkable[i] = CellWalkable[i];
+		}
+
+		bGridReady = true;
+	});
+}
+
+const FFlowField* UFlowFieldSubsystem::FindOrAddField(const FVector& GoalLocation)
+{
+	check(IsInGameThread());
+	if (!bGridReady) return nullptr;
+
+	const FIntPoint GoalCell = Grid.GetCell(GoalLocation);
+	if (!Grid.IsValidCell(GoalCell) || !Grid.Walkable[Grid.GetCellIndex(GoalCell)]) return nullptr;
+
+	TUniquePtr<FFlowField>& Field = Fields.FindOrAdd(GoalCell);
+	if (!Field)
+	{
+		Field = MakeUnique<FFlowField>();
+		Field->GoalCell = GoalCell;
+		const int32 GoalIndex = Grid.GetCellIndex(GoalCell);
+		Field->GoalLocation = FVector{Grid.GetCellCenter(GoalCell), Grid.FloorHeights[GoalIndex]};
+		Field->Costs.Init(TNumericLimits<float>::Max(), Grid.Num());
+		Field->Directions.Init(FFlowField::INVALID_DIRECTION, Grid.Num());
+
+		Field->Costs[GoalIndex] = 0.f;
+		Field->OpenSet.HeapPush(TPair<float, int32>{0.f, GoalIndex}, TLess<>{});
+	}
+
+	Field->LastUsedTime = GetWorld()->GetTimeSeconds();
+	return Field.Get();
+}
+
+bool UFlowFieldSubsystem::SampleDirection(const FFlowField& Field, const FVector& Location, FVector2f& OutDirection) const
+{
+	const FIntPoint Cell = Grid.GetCell(Location);
+	if (!Grid.IsValidCell(Cell)) return false;
+
+	if (Cell == Field.GoalCell)
+	{
+		const FVector ToGoal = Field.GoalLocation - Location;
+		OutDirection = UE::MassTest::Deterministic::GetSafeNormal(FVector2f{(float)ToGoal.X, (float)ToGoal.Y});
+		return true;
+	}
+
+	const uint8 Direction = Field.Directions[Grid.GetCellIndex(Cell)];
+	if (Direction == FFlowField::INVALID_DIRECTION) return false;
+
+	OutDirection = FFlowField::DirectionVectors[Direction];
+	return true;
+}
+
+void UFlowFieldSubsystem::WaitForPendingWork()
+{
+	UE::Tasks::Wait(PendingTasks);
+	PendingTasks.Reset();
+}
+
+void UFlowFieldSubsystem::KickPendingWork()
+{
+	check(IsInGameThread());
+	check(PendingTasks.IsEmpty());
+
+	if (!bGridReady) return;
+
+	const double EvictBeforeTime = GetWorld()->GetTimeSeconds() - CVarFlowFieldEvictionTime.GetValueOnGameThread();
+	const int32 MaxExpansions = CVarFlowFieldExpansionsPerFrame.GetValueOnGameThread();
+
+	for (auto It = Fields.CreateIterator(); It; ++It)
+	{
+		FFlowField& Field = *It.Value();
+		if (Field.LastUsedTime < EvictBeforeTime)
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+
+		if (Field.IsComplete()) continue;
+
+		// Each field is only touched by its own task until the next WaitForPendingWork.
+		PendingTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, &Field, MaxExpansions]() -> void
+		{
+			ExpandField(Grid, Field, MaxExpansions);
+		}));
+	}
+}
+
+void UFlowFieldSubsystem::ExpandField(const FFlowFieldGrid& Grid, FFlowField& Field, const int32 MaxExpansions)
+{
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UFlowFieldSubsystem::ExpandField"), STAT_FlowFieldExpand, STATGROUP_MassTest);
+
+	for (int32 NumExpansions = 0; NumExpansions < MaxExpansions && !Field.OpenSet.IsEmpty(); ++NumExpansions)
+	{
+		TPair<float, int32> Current;
+		Field.OpenSet.HeapPop(Current, TLess<>{}, false);
+
+		const int32 CurrentIndex = Current.Value;
+		if (Current.Key > Field.Costs[CurrentIndex]) continue; // Stale entry.
+
+		const FIntPoint CurrentCell{CurrentIndex % Grid.SizeX, CurrentIndex / Grid.SizeX};
+		const float CurrentHeight = Grid.FloorHeights[CurrentIndex];
+
+		for (uint8 Direction = 0; Direction < 8; ++Direction)
+		{
+			const FIntPoint NeighborCell = CurrentCell + FFlowField::DirectionOffsets[Direction];
+			if (!Grid.IsValidCell(NeighborCell)) continue;
+
+			const int32 NeighborIndex = Grid.GetCellIndex(NeighborCell);
+			if (!Grid.Walkable[NeighborIndex] || FMath::Abs(Grid.FloorHeights[NeighborIndex] - CurrentHeight) > FLOW_FIELD_MAX_STEP_HEIGHT) continue;
+
+			// Don't cut corners through unwalkable cells on diagonals.
+			if (Direction & 1)
+			{
+				const int32 SideA = Grid.GetCellIndex(FIntPoint{NeighborCell.X, CurrentCell.Y});
+				const int32 SideB = Grid.GetCellIndex(FIntPoint{CurrentCell.X, NeighborCell.Y});
+				if (!Grid.Walkable[SideA] || !Grid.Walkable[SideB]) continue;
+			}
+
+			const float NewCost = Current.Key + ((Direction & 1) ? UE_SQRT_2 : 1.f);
+			if (NewCost >= Field.Costs[NeighborIndex]) continue;
+
+			// The neighbour flows back towards the cell that relaxed it, which is already final.
+			Field.Costs[NeighborIndex] = NewCost;
+			Field.Directions[NeighborIndex] = (Direction + 4) & 7;
+			Field.OpenSet.HeapPush(TPair<float, int32>{NewCost, NeighborIndex}, TLess<>{});
+		}
+	}
+}
+
+MASSTEST_DETERMINISTIC_FP_END
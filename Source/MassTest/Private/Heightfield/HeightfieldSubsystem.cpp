@@ -0,0 +1,249 @@
+#include "Heightfield/HeightfieldSubsystem.h"
+
+#include "Async/ParallelFor.h"
+#include "Engine/LevelBounds.h"
+#include "Engine/World.h"
+#include "EntityCommon.h"
+#include "Lockstep/LockstepSubsystem.h"
+#include "Simulation/MassAsyncSimulationSubsystem.h"
+
+static TAutoConsoleVariable<float> CVarHeightfieldCellSize{
+	TEXT("MassTest.Heightfield.CellSize"),
+	50.f,
+	TEXT("Size in cm of a baked heightfield cell. Read when the world starts.")};
+
+static TAutoConsoleVariable<int32> CVarHeightfieldMaxTilesPerLevel{
+	TEXT("MassTest.Heightfield.MaxTilesPerLevel"),
+	4096,
+	TEXT("Levels whose bounds cover more tiles than this aren't baked.")};
+
+static constexpr float HEIGHTFIELD_WALKABLE_FLOOR_Z = 0.71f;
+// Gap between two surfaces of a column a character could fit in.
+static constexpr float HEIGHTFIELD_OVERHANG_TOLERANCE = 200.f;
+// Surfaces under the top one looked at for room underneath.
+static constexpr int32 HEIGHTFIELD_MAX_COLUMN_SURFACES = 8;
+static constexpr double HEIGHTFIELD_TRACE_EXTENT = 100000.0;
+
+void UHeightfieldSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CellSize = FMath::Max(CVarHeightfieldCellSize.GetValueOnGameThread(), 1.f);
+	InvCellSize = 1.f / CellSize;
+
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UHeightfieldSubsystem::OnLevelAdded);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UHeightfieldSubsystem::OnLevelRemoved);
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UHeightfieldSubsystem::OnPostActorTick);
+}
+
+void UHeightfieldSubsystem::Deinitialize()
+{
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+
+	for (const TPair<UE::Tasks::FTask, TUniquePtr<FHeightfieldTile>>& Bake : PendingBakes)
+	{
+		Bake.Key.Wait();
+	}
+	PendingBakes.Empty();
+	Tiles.Empty();
+	LevelTiles.Empty();
+
+	Super::Deinitialize();
+}
+
+void UHeightfieldSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Levels streamed in from now on go through OnLevelAdded, the ones already loaded are baked here.
+	for (ULevel* Level : InWorld.GetLevels())
+	{
+		AddLevelTiles(Level);
+	}
+}
+
+void UHeightfieldSubsystem::OnLevelAdded(ULevel* Level, UWorld* World)
+{
+	if (World == GetWorld() && World->HasBegunPlay())
+	{
+		AddLevelTiles(Level);
+	}
+}
+
+void UHeightfieldSubsystem::OnLevelRemoved(ULevel* Level, UWorld* World)
+{
+	if (World != GetWorld()) return;
+
+	// An async simulation step may be querying the tiles about to be freed.
+	if (UMassAsyncSimulationSubsystem* Simulation = GetWorld()->GetSubsystem<UMassAsyncSimulationSubsystem>())
+	{
+		Simulation->WaitForSimulation();
+	}
+
+	// A null level means every level is being removed.
+	if (!Level)
+	{
+		Tiles.Empty();
+		LevelTiles.Empty();
+		return;
+	}
+
+	TArray<FIntPoint> RemovedTiles;
+	if (!LevelTiles.RemoveAndCopyValue(Level, RemovedTiles)) return;
+
+	for (const FIntPoint& TileCoord : RemovedTiles)
+	{
+		const TUniquePtr<FHeightfieldTile>* Tile = Tiles.Find(TileCoord);
+		if (!Tile) continue;
+
+		if (--(*Tile)->NumOwningLevels <= 0)
+		{
+			Tiles.Remove(TileCoord);
+		}
+		else
+		{
+			// Still covered by another level, but may contain geometry of the removed one.
+			RequestBake(TileCoord);
+		}
+	}
+}
+
+void UHeightfieldSubsystem::AddLevelTiles(ULevel* Level)
+{
+	if (!Level || LevelTiles.Contains(Level)) return;
+
+	const FBox Bounds = ALevelBounds::CalculateLevelBounds(Level);
+	if (!Bounds.IsValid) return;
+
+	const double TileSize = CellSize * FHeightfieldTile::TILE_CELLS;
+	const FIntPoint Min{FMath::FloorToInt32(Bounds.Min.X / TileSize), FMath::FloorToInt32(Bounds.Min.Y / TileSize)};
+	const FIntPoint Max{FMath::FloorToInt32(Bounds.Max.X / TileSize), FMath::FloorToInt32(Bounds.Max.Y / TileSize)};
+	if ((int64)(Max.X - Min.X + 1) * (Max.Y - Min.Y + 1) > CVarHeightfieldMaxTilesPerLevel.GetValueOnGameThread()) return;
+
+	TArray<FIntPoint>& OwnedTiles = LevelTiles.Add(Level);
+	for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+	{
+		for (int32 X = Min.X; X <= Max.X; ++X)
+		{
+			const FIntPoint TileCoord{X, Y};
+			OwnedTiles.Add(TileCoord);
+
+			if (const TUniquePtr<FHeightfieldTile>* Tile = Tiles.Find(TileCoord))
+			{
+				++(*Tile)->NumOwningLevels;
+			}
+			else
+			{
+				TUniquePtr<FHeightfieldTile>& NewTile = Tiles.Add(TileCoord, MakeUnique<FHeightfieldTile>());
+				NewTile->Coord = TileCoord;
+				NewTile->NumOwningLevels = 1;
+				NewTile->Flags.Init(EHeightfieldCellFlags::None, FMath::Square(FHeightfieldTile::TILE_CELLS));
+			}
+
+			RequestBake(TileCoord);
+		}
+	}
+}
+
+void UHeightfieldSubsystem::RequestBake(const FIntPoint& TileCoord)
+{
+	TUniquePtr<FHeightfieldTile> Tile = MakeUnique<FHeightfieldTile>();
+	Tile->Coord = TileCoord;
+	Tile->BakeGeneration = ++LastBakeGeneration;
+
+	FHeightfieldTile* TilePtr = Tile.Get();
+	UE::Tasks::FTask Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [World = GetWorld(), CellSize = CellSize, TilePtr]() -> void
+	{
+		BakeTile(World, CellSize, *TilePtr);
+	});
+
+	PendingBakes.Emplace(MoveTemp(Task), MoveTemp(Tile));
+}
+
+void UHeightfieldSubsystem::OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld()) return;
+
+	// Which path characters take depends on which tiles are live, so lockstep peers publish every bake on the frame it was requested
+	// rather than whenever their worker threads got to it.
+	const ULockstepSubsystem* Lockstep = World->GetSubsystem<ULockstepSubsystem>();
+	const bool bWaitForBakes = Lockstep && Lockstep->IsEnabled();
+
+	// Mass isn't processing here, so swapping tile contents can't race with floor queries.
+	for (int32 i = PendingBakes.Num() - 1; i >= 0; --i)
+	{
+		if (bWaitForBakes)
+		{
+			PendingBakes[i].Key.Wait();
+		}
+		else if (!PendingBakes[i].Key.IsCompleted())
+		{
+			continue;
+		}
+
+		// Bakes of the same tile may finish out of order, a stale one never replaces what a later request produced.
+		TUniquePtr<FHeightfieldTile>& Baked = PendingBakes[i].Value;
+		TUniquePtr<FHeightfieldTile>* Tile = Tiles.Find(Baked->Coord);
+		if (Tile && Baked->BakeGeneration > (*Tile)->BakeGeneration)
+		{
+			Baked->NumOwningLevels = (*Tile)->NumOwningLevels;
+			*Tile = MoveTemp(Baked);
+		}
+
+		PendingBakes.RemoveAtSwap(i, 1, false);
+	}
+}
+
+void UHeightfieldSubsystem::BakeTile(const UWorld* World, const float CellSize, FHeightfieldTile& Tile)
+{
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UHeightfieldSubsystem::BakeTile"), STAT_HeightfieldBakeTile, STATGROUP_MassTest);
+
+	constexpr int32 NumCells = FHeightfieldTile::TILE_CELLS * FHeightfieldTile::TILE_CELLS;
+	Tile.Heights.SetNumZeroed(NumCells);
+	Tile.NormalsX.SetNumZeroed(NumCells);
+	Tile.NormalsY.SetNumZeroed(NumCells);
+	Tile.Flags.Init(EHeightfieldCellFlags::None, NumCells);
+
+	ParallelFor(FHeightfieldTile::TILE_CELLS, [&](const int32 Row) -> void
+	{
+		const FCollisionQueryParams QueryParams{SCENE_QUERY_STAT(HeightfieldBake), false};
+
+		for (int32 Column = 0; Column < FHeightfieldTile::TILE_CELLS; ++Column)
+		{
+			const int32 Index = Row * FHeightfieldTile::TILE_CELLS + Column;
+			const FVector2D Center = (FVector2D{(double)Tile.Coord.X, (double)Tile.Coord.Y} * FHeightfieldTile::TILE_CELLS + FVector2D{Column + 0.5, Row + 0.5}) * CellSize;
+
+			// Every surface down the column, top first. Traced as overlaps so the ray doesn't stop at the first blocking one.
+			TArray<FHitResult, TInlineAllocator<HEIGHTFIELD_MAX_COLUMN_SURFACES>> ColumnHits;
+			World->LineTraceMultiByChannel(ColumnHits, FVector{Center, HEIGHTFIELD_TRACE_EXTENT}, FVector{Center, -HEIGHTFIELD_TRACE_EXTENT}, ECC_WorldStatic, QueryParams, FCollisionResponseParams{ECR_Overlap});
+			if (ColumnHits.IsEmpty()) continue;
+
+			const FHitResult& DownHit = ColumnHits[0];
+
+			EHeightfieldCellFlags Flags = EHeightfieldCellFlags::HasFloor;
+			if (DownHit.ImpactNormal.Z >= HEIGHTFIELD_WALKABLE_FLOOR_Z) Flags |= EHeightfieldCellFlags::Walkable;
+
+			// A character could stand on a lower surface when there's room between it and the underside of whatever is above it.
+			// The top surface's own thickness, however large, isn't room: going up from the surface it rests on hits its underside right away.
+			for (int32 HitIndex = 1; HitIndex < FMath::Min(ColumnHits.Num(), HEIGHTFIELD_MAX_COLUMN_SURFACES); ++HitIndex)
+			{
+				const FVector LowerFloor = ColumnHits[HitIndex].ImpactPoint + FVector{0.0, 0.0, UE_KINDA_SMALL_NUMBER};
+				FHitResult UpHit;
+				const double Ceiling = World->LineTraceSingleByChannel(UpHit, LowerFloor, ColumnHits[HitIndex - 1].ImpactPoint, ECC_WorldStatic, QueryParams)
+					? UpHit.ImpactPoint.Z : ColumnHits[HitIndex - 1].ImpactPoint.Z;
+				if (Ceiling - LowerFloor.Z >= HEIGHTFIELD_OVERHANG_TOLERANCE)
+				{
+					Flags |= EHeightfieldCellFlags::Overhang;
+					break;
+				}
+			}
+
+			Tile.Heights[Index] = (float)DownHit.ImpactPoint.Z;
+			Tile.NormalsX[Index] = (float)DownHit.ImpactNormal.X;
+			Tile.NormalsY[Index] = (float)DownHit.ImpactNormal.Y;
+			Tile.Flags[Index] = Flags;
+		}
+	});
+}
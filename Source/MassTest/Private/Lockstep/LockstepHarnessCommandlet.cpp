@@ -0,0 +1,89 @@
+#include "Lockstep/LockstepHarnessCommandlet.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMassLockstepHarness, Log, All);
+
+UMassLockstepHarnessCommandlet::UMassLockstepHarnessCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UMassLockstepHarnessCommandlet::Main(const FString& Params)
+{
+	FString Map;
+	if (!FParse::Value(*Params, TEXT("Map="), Map))
+	{
+		UE_LOG(LogMassLockstepHarness, Error, TEXT("Missing -Map=."));
+		return 1;
+	}
+
+	int32 NumFrames = 600;
+	FParse::Value(*Params, TEXT("Frames="), NumFrames);
+
+	FString ExtraArgs;
+	FParse::Value(*Params, TEXT("ExtraArgs="), ExtraArgs, false);
+
+	const FString LogDirectory = FPaths::ProjectSavedDir() / TEXT("Lockstep");
+	const FString LogPaths[2] = {LogDirectory / TEXT("PeerA.txt"), LogDirectory / TEXT("PeerB.txt")};
+
+	//~ Both peers run concurrently so they also race for cores, which is what would expose thread timing leaking into the simulation.
+	FProcHandle Peers[2];
+	for (int32 Peer = 0; Peer < 2; ++Peer)
+	{
+		IFileManager::Get().Delete(*LogPaths[Peer]);
+
+		const FString Args = FString::Printf(TEXT("\"%s\" %s -game -nullrhi -nosound -unattended -nosplash -Lockstep -LockstepFrames=%d -LockstepHashLog=\"%s\" %s"),
+			*FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()), *Map, NumFrames, *FPaths::ConvertRelativePathToFull(LogPaths[Peer]), *ExtraArgs);
+
+		Peers[Peer] = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *Args, true, true, true, nullptr, 0, nullptr, nullptr);
+		if (!Peers[Peer].IsValid())
+		{
+			UE_LOG(LogMassLockstepHarness, Error, TEXT("Failed to launch peer %d."), Peer);
+			return 1;
+		}
+	}
+
+	for (FProcHandle& Peer : Peers)
+	{
+		FPlatformProcess::WaitForProc(Peer);
+		FPlatformProcess::CloseProc(Peer);
+	}
+	//~
+
+	//~ Compare frame by frame.
+	TArray<FString> Hashes[2];
+	for (int32 Peer = 0; Peer < 2; ++Peer)
+	{
+		if (!FFileHelper::LoadFileToStringArray(Hashes[Peer], *LogPaths[Peer]))
+		{
+			UE_LOG(LogMassLockstepHarness, Error, TEXT("Peer %d wrote no hash log at %s."), Peer, *LogPaths[Peer]);
+			return 1;
+		}
+	}
+
+	const int32 NumCompared = FMath::Min(Hashes[0].Num(), Hashes[1].Num());
+	for (int32 Frame = 0; Frame < NumCompared; ++Frame)
+	{
+		if (Hashes[0][Frame] != Hashes[1][Frame])
+		{
+			UE_LOG(LogMassLockstepHarness, Error, TEXT("Desync at frame %d: \"%s\" vs \"%s\"."), Frame, *Hashes[0][Frame], *Hashes[1][Frame]);
+			return 1;
+		}
+	}
+
+	if (Hashes[0].Num() != Hashes[1].Num())
+	{
+		UE_LOG(LogMassLockstepHarness, Error, TEXT("Peers ran a different number of frames: %d vs %d."), Hashes[0].Num(), Hashes[1].Num());
+		return 1;
+	}
+
+	UE_LOG(LogMassLockstepHarness, Display, TEXT("%d frames matched."), NumCompared);
+	return 0;
+}
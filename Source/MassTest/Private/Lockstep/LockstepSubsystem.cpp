@@ -0,0 +1,84 @@
+#include "Lockstep/LockstepSubsystem.h"
+
+#include "Engine/World.h"
+#include "EntityCommon.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMassLockstep, Log, All);
+
+static TAutoConsoleVariable<bool> CVarMassTestLockstep{
+	TEXT("MassTest.Lockstep"),
+	false,
+	TEXT("Runs the movement pipeline in deterministic lockstep mode and hashes its state every frame. Read when the world starts.")};
+
+static TAutoConsoleVariable<float> CVarMassTestLockstepTickRate{
+	TEXT("MassTest.Lockstep.TickRate"),
+	30.f,
+	TEXT("Fixed frames per second in lockstep mode. Read when the world starts.")};
+
+void ULockstepSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	bEnabled = GetWorld()->IsGameWorld() && (CVarMassTestLockstep.GetValueOnGameThread() || FParse::Param(FCommandLine::Get(), TEXT("Lockstep")));
+	if (!bEnabled) return;
+
+	FParse::Value(FCommandLine::Get(), TEXT("LockstepHashLog="), HashLogPath);
+	FParse::Value(FCommandLine::Get(), TEXT("LockstepFrames="), MaxFrames);
+
+	// Every peer has to step by the same delta, whatever its frame rate.
+	bPreviousUseFixedTimeStep = FApp::UseFixedTimeStep();
+	PreviousFixedDeltaTime = FApp::GetFixedDeltaTime();
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(1.0 / FMath::Max(CVarMassTestLockstepTickRate.GetValueOnGameThread(), 1.f));
+
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &ULockstepSubsystem::OnPostActorTick);
+}
+
+void ULockstepSubsystem::Deinitialize()
+{
+	if (bEnabled)
+	{
+		FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+
+		FApp::SetUseFixedTimeStep(bPreviousUseFixedTimeStep);
+		FApp::SetFixedDeltaTime(PreviousFixedDeltaTime);
+
+		// Covers worlds torn down before reaching -LockstepFrames.
+		WriteHashLog();
+	}
+
+	Super::Deinitialize();
+}
+
+void ULockstepSubsystem::OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld()) return;
+
+	FrameHashes.Add(PendingHash);
+	PendingHash = 0;
+
+	if (MaxFrames > 0 && FrameHashes.Num() == MaxFrames)
+	{
+		UE_LOG(LogMassLockstep, Display, TEXT("MassTest.Lockstep: reached %d frames, final hash %016llx."), MaxFrames, FrameHashes.Last());
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+void ULockstepSubsystem::WriteHashLog() const
+{
+	if (HashLogPath.IsEmpty()) return;
+
+	const int32 NumFrames = MaxFrames > 0 ? FMath::Min(MaxFrames, FrameHashes.Num()) : FrameHashes.Num();
+
+	TArray<FString> Lines;
+	Lines.Reserve(NumFrames);
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		Lines.Add(FString::Printf(TEXT("%d %016llx"), Frame, FrameHashes[Frame]));
+	}
+
+	FFileHelper::SaveStringArrayToFile(Lines, *HashLogPath);
+}
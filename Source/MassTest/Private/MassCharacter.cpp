@@ -3,10 +3,22 @@
 
 #include "MassCharacter.h"
 
+#include "EntityCommon.h"
+#include "MassCommonFragments.h"
+#include "MassEntityConfigAsset.h"
+#include "MassEntityManager.h"
+#include "MassEntityUtils.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Representation/MassActorTableSubsystem.h"
+#include "Simulation/MassAsyncSimulationSubsystem.h"
+#include "TransformMirror/ActorTransformMirrorSubsystem.h"
+
 // Sets default values
 AMassCharacter::AMassCharacter()
 {
- 	// Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+ 	// Ticks unless Mass-driven, BeginPlay turns the actor tick off then.
 	PrimaryActorTick.bCanEverTick = true;
 
 }
@@ -15,14 +27,103 @@ AMassCharacter::AMassCharacter()
 void AMassCharacter::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	if (!bMassDriven || !MassEntityConfig) return;
+
+	const FMassEntityTemplate& Template = MassEntityConfig->GetOrCreateEntityTemplate(*GetWorld());
+	FMassEntityManager& Manager = UE::Mass::Utils::GetEntityManagerChecked(*GetWorld());
+
+	if (UMassAsyncSimulationSubsystem* Simulation = GetWorld()->GetSubsystem<UMassAsyncSimulationSubsystem>())
+	{
+		Simulation->WaitForSimulation();
+	}
+
+	EntityHandle = Manager.CreateEntity(Template.GetArchetype(), Template.GetSharedFragmentValues());
+	Manager.GetFragmentDataChecked<FTransformFragment>(EntityHandle).SetTransform(GetActorTransform());
+	Manager.GetFragmentDataChecked<FActorHandleFragment>(EntityHandle).Handle = GetWorld()->GetSubsystem<UMassActorTableSubsystem>()->RegisterActor(this);
+	Manager.GetFragmentDataChecked<FTransformMirrorFragment>(EntityHandle).Slot = GetWorld()->GetSubsystem<UActorTransformMirrorSubsystem>()->RegisterActor(this);
+	Manager.GetFragmentDataChecked<FCapsuleFragment>(EntityHandle).Radius = GetCapsuleComponent()->GetScaledCapsuleRadius();
+	Manager.GetFragmentDataChecked<FCapsuleFragment>(EntityHandle).HalfHeight = GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+
+	if (UMortonCompactionSubsystem* Compaction = GetWorld()->GetSubsystem<UMortonCompactionSubsystem>())
+	{
+		EntitiesRemappedHandle = Compaction->OnEntitiesRemapped().AddUObject(this, &AMassCharacter::OnEntitiesRemapped);
+	}
+
+	SetActorTickEnabled(false);
+
+	// The skeletal mesh keeps its own tick function, UMassActorVisualTickProcessor only lowers its rate with distance.
+	TInlineComponentArray<UActorComponent*> Components{this};
+	for (UActorComponent* Component : Components)
+	{
+		if (Component != GetMesh())
+		{
+			Component->SetComponentTickEnabled(false);
+		}
+	}
+
+	// Mass owns movement, so the movement component would only duplicate the work.
+	if (UCharacterMovementComponent* Movement = GetCharacterMovement())
+	{
+		Movement->StopMovementImmediately();
+		Movement->Deactivate();
+	}
+
+	GetCapsuleComponent()->SetGenerateOverlapEvents(false);
+
+	if (USkeletalMeshComponent* SkeletalMesh = GetMesh())
+	{
+		SkeletalMesh->SetGenerateOverlapEvents(false);
+		SkeletalMesh->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+	}
 }
 
-// Called every frame
-void AMassCharacter::Tick(float DeltaTime)
+void AMassCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	Super::Tick(DeltaTime);
+	Super::EndPlay(EndPlayReason);
 
+	if (UMortonCompactionSubsystem* Compaction = GetWorld()->GetSubsystem<UMortonCompactionSubsystem>())
+	{
+		Compaction->OnEntitiesRemapped().Remove(EntitiesRemappedHandle);
+	}
+
+	if (EntityHandle.IsValid())
+	{
+		FMassEntityManager& Manager = UE::Mass::Utils::GetEntityManagerChecked(*GetWorld());
+
+		if (UMassAsyncSimulationSubsystem* Simulation = GetWorld()->GetSubsystem<UMassAsyncSimulationSubsystem>())
+		{
+			Simulation->WaitForSimulation();
+		}
+		if (Manager.IsEntityValid(EntityHandle))
+		{
+			if (UActorTransformMirrorSubsystem* TransformMirror = GetWorld()->GetSubsystem<UActorTransformMirrorSubsystem>())
+			{
+				TransformMirror->UnregisterActor(Manager.GetFragmentDataChecked<FTransformMirrorFragment>(EntityHandle).Slot);
+			}
+
+			if (UMassActorTableSubsystem* ActorTable = GetWorld()->GetSubsystem<UMassActorTableSubsystem>())
+			{
+				ActorTable->UnregisterActor(Manager.GetFragmentDataChecked<FActorHandleFragment>(EntityHandle).Handle);
+			}
+		}
+
+		Manager.Defer().DestroyEntity(EntityHandle);
+		EntityHandle.Reset();
+	}
+}
+
+void AMassCharacter::OnEntitiesRemapped(const FMassEntityRemap& EntityRemap)
+{
+	UMortonCompactionSubsystem::Remap(EntityRemap, EntityHandle);
+}
+
+void AMassCharacter::SetMassVisualTickInterval(const float TickInterval)
+{
+	if (USkeletalMeshComponent* SkeletalMesh = GetMesh())
+	{
+		SkeletalMesh->SetComponentTickInterval(TickInterval);
+	}
 }
 
 // Called to bind functionality to input
@@ -31,4 +132,3 @@ void AMassCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputCompo
 	Super::SetupPlayerInputComponent(PlayerInputComponent);
 
 }
-
@@ -4,15 +4,22 @@
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
 #include "EntityCommon.h"
+#include "MassCommands.h"
 #include "MassCommonUtils.h"
 #include "MassEntityConfigAsset.h"
 #include "MassEntityManager.h"
 #include "MassEntityUtils.h"
 #include "MassSimulationSubsystem.h"
+#include "Representation/MassActorTableSubsystem.h"
+#include "Simulation/MassAsyncSimulationSubsystem.h"
+#include "TransformMirror/ActorTransformMirrorSubsystem.h"
 
 AMassPawn::AMassPawn(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 {
+	// Movement input is read by UInputVelocityProcessor, nothing to do per actor.
+	PrimaryActorTick.bCanEverTick = false;
+
 	bUseControllerRotationPitch = true;
 	bUseControllerRotationYaw = true;
 	bUseControllerRotationRoll = true;
@@ -27,29 +34,62 @@ void AMassPawn::BeginPlay()
 	check(GetMassEntityConfig());
 	const FMassEntityTemplate& Template = GetMassEntityConfig()->GetOrCreateEntityTemplate(*GetWorld());
 	FMassEntityManager& Manager = UE::Mass::Utils::GetEntityManagerChecked(*GetWorld());
+
+	if (UMassAsyncSimulationSubsystem* Simulation = GetWorld()->GetSubsystem<UMassAsyncSimulationSubsystem>())
+	{
+		Simulation->WaitForSimulation();
+	}
 	
 	EntityHandle = Manager.CreateEntity(Template.GetArchetype(), Template.GetSharedFragmentValues());
-	Manager.GetFragmentDataChecked<FActorHandleFragment>(EntityHandle).Actor = this;
+	Manager.GetFragmentDataChecked<FActorHandleFragment>(EntityHandle).Handle = GetWorld()->GetSubsystem<UMassActorTableSubsystem>()->RegisterActor(this);
+	Manager.GetFragmentDataChecked<FTransformMirrorFragment>(EntityHandle).Slot = GetWorld()->GetSubsystem<UActorTransformMirrorSubsystem>()->RegisterActor(this);
 	Manager.GetFragmentDataChecked<FCapsuleFragment>(EntityHandle).Radius = 34.f;
 	Manager.GetFragmentDataChecked<FCapsuleFragment>(EntityHandle).HalfHeight = 88.f;
+
+	if (UMortonCompactionSubsystem* Compaction = GetWorld()->GetSubsystem<UMortonCompactionSubsystem>())
+	{
+		EntitiesRemappedHandle = Compaction->OnEntitiesRemapped().AddUObject(this, &AMassPawn::OnEntitiesRemapped);
+	}
 }
 
 void AMassPawn::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	Super::EndPlay(EndPlayReason);
 
+	if (UMortonCompactionSubsystem* Compaction = GetWorld()->GetSubsystem<UMortonCompactionSubsystem>())
+	{
+		Compaction->OnEntitiesRemapped().Remove(EntitiesRemappedHandle);
+	}
+
 	if (EntityHandle.IsValid())
 	{
-		UE::Mass::Utils::GetEntityManagerChecked(*GetWorld()).Defer().DestroyEntity(EntityHandle);
+		FMassEntityManager& Manager = UE::Mass::Utils::GetEntityManagerChecked(*GetWorld());
+
+		if (UMassAsyncSimulationSubsystem* Simulation = GetWorld()->GetSubsystem<UMassAsyncSimulationSubsystem>())
+		{
+			Simulation->WaitForSimulation();
+		}
+		if (Manager.IsEntityValid(EntityHandle))
+		{
+			if (UActorTransformMirrorSubsystem* TransformMirror = GetWorld()->GetSubsystem<UActorTransformMirrorSubsystem>())
+			{
+				TransformMirror->UnregisterActor(Manager.GetFragmentDataChecked<FTransformMirrorFragment>(EntityHandle).Slot);
+			}
+
+			if (UMassActorTableSubsystem* ActorTable = GetWorld()->GetSubsystem<UMassActorTableSubsystem>())
+			{
+				ActorTable->UnregisterActor(Manager.GetFragmentDataChecked<FActorHandleFragment>(EntityHandle).Handle);
+			}
+		}
+
+		Manager.Defer().DestroyEntity(EntityHandle);
 		EntityHandle.Reset();
 	}
 }
 
-void AMassPawn::Tick(float DeltaSeconds)
+void AMassPawn::OnEntitiesRemapped(const FMassEntityRemap& EntityRemap)
 {
-	Super::Tick(DeltaSeconds);
-
-	//UE::Mass::Utils::GetEntityManagerChecked(*GetWorld()).GetFragmentDataChecked<FMovementInputFragment>(EntityHandle) = (FVector2f)CastChecked<UEnhancedInputComponent>(InputComponent)->GetBoundActionValue(GetMoveAction()).Get<FVector2D>();
+	UMortonCompactionSubsystem::Remap(EntityRemap, EntityHandle);
 }
 
 void AMassPawn::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
@@ -87,6 +127,13 @@ void AMassPawn::OnLook(const FInputActionValue& Value)
 
 void AMassPawn::OnJump()
 {
-	UE::Mass::Utils::GetEntityManagerChecked(*GetWorld()).GetFragmentDataChecked<FVelocityFragment>(EntityHandle).Velocity.Z += 50.f;
+	// Deferred so it never races with an async simulation step still writing velocities.
+	UE::Mass::Utils::GetEntityManagerChecked(*GetWorld()).Defer().PushCommand<FMassDeferredSetCommand>([Entity = EntityHandle](FMassEntityManager& Manager) -> void
+	{
+		if (Manager.IsEntityValid(Entity))
+		{
+			Manager.GetFragmentDataChecked<FVelocityFragment>(Entity).Velocity.Z += 50.f;
+		}
+	});
 }
 
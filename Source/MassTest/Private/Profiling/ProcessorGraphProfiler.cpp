@@ -0,0 +1,436 @@
+#include "Profiling/ProcessorGraphProfiler.h"
+
+#include "EntityCommon.h"
+#include "MassEntityUtils.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectIterator.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMassProcessorGraph, Log, All);
+
+std::atomic<int32> UProcessorGraphProfilerSubsystem::NumActiveCaptures{0};
+
+static FAutoConsoleCommandWithWorldAndArgs CaptureProcessorGraphCommand{
+	TEXT("MassTest.ProcessorGraph.Capture"),
+	TEXT("Records Mass processor spans for [NumFrames] frames (60 by default) and writes the dependency graph and critical path to Saved/Profiling/MassProcessorGraph."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) -> void
+	{
+		if (UProcessorGraphProfilerSubsystem* Profiler = World ? World->GetSubsystem<UProcessorGraphProfilerSubsystem>() : nullptr)
+		{
+			Profiler->BeginCapture(Args.IsEmpty() ? 60 : FCString::Atoi(*Args[0]));
+		}
+	})};
+
+void UProcessorGraphProfilerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	PreActorTickHandle = FWorldDelegates::OnWorldPreActorTick.AddUObject(this, &UProcessorGraphProfilerSubsystem::OnPreActorTick);
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UProcessorGraphProfilerSubsystem::OnPostActorTick);
+}
+
+void UProcessorGraphProfilerSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldPreActorTick.Remove(PreActorTickHandle);
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+
+	if (IsCapturing())
+	{
+		RemainingFrames = 0;
+		--NumActiveCaptures;
+	}
+
+	Super::Deinitialize();
+}
+
+void UProcessorGraphProfilerSubsystem::BeginCapture(const int32 NumFrames)
+{
+	check(IsInGameThread());
+	if (IsCapturing() || NumFrames <= 0) return;
+
+	BuildGraph();
+
+	{
+		FScopeLock Lock{&SpansCriticalSection};
+		Spans.Reset();
+		FrameStartSeconds.Reset();
+		CurrentFrame = INDEX_NONE;
+		CaptureStartSeconds = FPlatformTime::Seconds();
+	}
+	RemainingFrames = NumFrames;
+	++NumActiveCaptures;
+}
+
+void UProcessorGraphProfilerSubsystem::RecordSpan(const UMassProcessor& Processor, const double StartSeconds, const double EndSeconds)
+{
+	FScopeLock Lock{&SpansCriticalSection};
+
+	// Spans from the partial frame the capture was started in are dropped.
+	if (CurrentFrame == INDEX_NONE) return;
+
+	Spans.Add(FMassProcessorSpan{Processor.GetClass()->GetFName(), FPlatformTLS::GetCurrentThreadId(), CurrentFrame, StartSeconds - CaptureStartSeconds, EndSeconds - CaptureStartSeconds, IsInGameThread()});
+}
+
+void UProcessorGraphProfilerSubsystem::OnPreActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld() || !IsCapturing()) return;
+
+	FScopeLock Lock{&SpansCriticalSection};
+	CurrentFrame = FrameStartSeconds.Add(FPlatformTime::Seconds() - CaptureStartSeconds);
+}
+
+void UProcessorGraphProfilerSubsystem::OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld() || !IsCapturing() || CurrentFrame == INDEX_NONE) return;
+
+	if (--RemainingFrames == 0)
+	{
+		EndCapture();
+	}
+}
+
+void UProcessorGraphProfilerSubsystem::BuildGraph()
+{
+	Nodes.Reset();
+	NodeIndices.Reset();
+	TopologicalOrder.Reset();
+
+	//~ Gather every processor the phases would auto register for this world.
+	const EProcessorExecutionFlags WorldExecutionFlags = UE::Mass::Utils::GetProcessorExecutionFlagsForWorld(*GetWorld());
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		if (!It->IsChildOf(UMassProcessor::StaticClass()) || It->HasAnyClassFlags(CLASS_Abstract | CLASS_Deprecated | CLASS_NewerVersionExists)) continue;
+
+		const UMassProcessor* Processor = It->GetDefaultObject<UMassProcessor>();
+		if (!Processor->ShouldAutoAddToGlobalList() || !Processor->ShouldExecute(WorldExecutionFlags)) continue;
+
+		FProcessorNode& Node = Nodes.AddDefaulted_GetRef();
+		Node.Name = It->GetFName();
+		Node.Group = Processor->GetExecutionOrder().ExecuteInGroup;
+		Node.ExecuteBefore = Processor->GetExecutionOrder().ExecuteBefore;
+		Node.ExecuteAfter = Processor->GetExecutionOrder().ExecuteAfter;
+		Node.bGameThread = Processor->DoesRequireGameThreadExecution();
+		NodeIndices.Add(Node.Name, Nodes.Num() - 1);
+	}
+	//~
+
+	//~ Resolve dependencies. A group is ordered by the union of its members' constraints, and nested groups ("A.B") belong to their parents.
+	const auto IsTargetOf = [](const FProcessorNode& Node, const FName Target) -> bool
+	{
+		if (Node.Name == Target || Node.Group == Target) return true;
+		return !Node.Group.IsNone() && Node.Group.ToString().StartsWith(Target.ToString() + TEXT("."));
+	};
+
+	// Whether any of Source's constraints names Target, ignoring names that also cover Source itself.
+	const auto AnyTargets = [&IsTargetOf](const TArray<FName>& Constraints, const FProcessorNode& Target, const FProcessorNode& Source) -> bool
+	{
+		return Constraints.ContainsByPredicate([&](const FName Name) -> bool { return IsTargetOf(Target, Name) && !IsTargetOf(Source, Name); });
+	};
+
+	TMap<FName, TArray<FName>> GroupBefore, GroupAfter;
+	for (const FProcessorNode& Node : Nodes)
+	{
+		if (Node.Group.IsNone()) continue;
+		GroupBefore.FindOrAdd(Node.Group).Append(Node.ExecuteBefore);
+		GroupAfter.FindOrAdd(Node.Group).Append(Node.ExecuteAfter);
+	}
+
+	static const TArray<FName> NoConstraints;
+	const auto FindGroupConstraints = [](const TMap<FName, TArray<FName>>& GroupConstraints, const FName Group) -> const TArray<FName>&
+	{
+		const TArray<FName>* Constraints = GroupConstraints.Find(Group);
+		return Constraints ? *Constraints : NoConstraints;
+	};
+
+	for (int32 Index = 0; Index < Nodes.Num(); ++Index)
+	{
+		FProcessorNode& Node = Nodes[Index];
+
+		for (int32 Other = 0; Other < Nodes.Num(); ++Other)
+		{
+			if (Other == Index) continue;
+			const FProcessorNode& OtherNode = Nodes[Other];
+
+			// Constraints naming the node's own group order the group, not its members. Constraints inherited from the group only apply outside of it.
+			const bool bSameGroup = !Node.Group.IsNone() && Node.Group == OtherNode.Group;
+
+			const bool bDepends =
+				AnyTargets(Node.ExecuteAfter, OtherNode, Node) ||
+				AnyTargets(OtherNode.ExecuteBefore, Node, OtherNode) ||
+				(!bSameGroup && AnyTargets(FindGroupConstraints(GroupAfter, Node.Group), OtherNode, Node)) ||
+				(!bSameGroup && AnyTargets(FindGroupConstraints(GroupBefore, OtherNode.Group), Node, OtherNode));
+
+			if (bDepends)
+			{
+				Node.Dependencies.Add(Other);
+			}
+		}
+	}
+	//~
+
+	//~ Kahn's algorithm. Anything left over is part of a cycle the dependency solver would have to break.
+	TArray<int32> NumPendingDependencies;
+	TArray<TArray<int32>> Dependents;
+	NumPendingDependencies.SetNumZeroed(Nodes.Num());
+	Dependents.SetNum(Nodes.Num());
+	for (int32 Index = 0; Index < Nodes.Num(); ++Index)
+	{
+		NumPendingDependencies[Index] = Nodes[Index].Dependencies.Num();
+		for (const int32 Dependency : Nodes[Index].Dependencies)
+		{
+			Dependents[Dependency].Add(Index);
+		}
+	}
+
+	for (int32 Index = 0; Index < Nodes.Num(); ++Index)
+	{
+		if (NumPendingDependencies[Index] == 0) TopologicalOrder.Add(Index);
+	}
+
+	for (int32 i = 0; i < TopologicalOrder.Num(); ++i)
+	{
+		for (const int32 Dependent : Dependents[TopologicalOrder[i]])
+		{
+			if (--NumPendingDependencies[Dependent] == 0) TopologicalOrder.Add(Dependent);
+		}
+	}
+
+	if (TopologicalOrder.Num() != Nodes.Num())
+	{
+		UE_LOG(LogMassProcessorGraph, Warning, TEXT("MassTest.ProcessorGraph: %d processors are part of a dependency cycle, their ordering is ignored."), Nodes.Num() - TopologicalOrder.Num());
+		for (int32 Index = 0; Index < Nodes.Num(); ++Index)
+		{
+			if (NumPendingDependencies[Index] > 0)
+			{
+				Nodes[Index].Dependencies.Reset();
+				TopologicalOrder.Add(Index);
+			}
+		}
+	}
+	//~
+}
+
+void UProcessorGraphProfilerSubsystem::EndCapture()
+{
+	--NumActiveCaptures;
+
+	// Span scopes that saw the capture running can still be recording.
+	FScopeLock Lock{&SpansCriticalSection};
+
+	const FString Path = WriteReport();
+	UE_LOG(LogMassProcessorGraph, Display, TEXT("MassTest.ProcessorGraph: captured %d frames and %d spans, report written to %s"), FrameStartSeconds.Num(), Spans.Num(), *Path);
+
+	Spans.Empty();
+	FrameStartSeconds.Empty();
+	CurrentFrame = INDEX_NONE;
+}
+
+FString UProcessorGraphProfilerSubsystem::WriteReport() const
+{
+	FScopeLock Lock{&SpansCriticalSection};
+
+	const int32 NumNodes = Nodes.Num();
+	const int32 NumFrames = FrameStartSeconds.Num();
+
+	//~ Merge each processor's spans per frame. A processor can be split into several spans, e.g. by running in multiple phases.
+	struct FFrameNode
+	{
+		double Start = TNumericLimits<double>::Max();
+		double End = TNumericLimits<double>::Lowest();
+		double Busy = 0.0;
+		bool bGameThread = false;
+
+		FORCEINLINE bool HasRun() const { return Busy > 0.0; }
+	};
+
+	TArray<FFrameNode> FrameNodes;
+	FrameNodes.SetNum(NumFrames * NumNodes);
+
+	TArray<double> FrameFirstStart, FrameLastEnd;
+	FrameFirstStart.Init(TNumericLimits<double>::Max(), NumFrames);
+	FrameLastEnd.Init(TNumericLimits<double>::Lowest(), NumFrames);
+
+	for (const FMassProcessorSpan& Span : Spans)
+	{
+		const int32* NodeIndex = NodeIndices.Find(Span.Processor);
+		if (!NodeIndex || !FrameStartSeconds.IsValidIndex(Span.Frame)) continue;
+
+		FFrameNode& FrameNode = FrameNodes[Span.Frame * NumNodes + *NodeIndex];
+		FrameNode.Start = FMath::Min(FrameNode.Start, Span.Start);
+		FrameNode.End = FMath::Max(FrameNode.End, Span.End);
+		FrameNode.Busy += Span.End - Span.Start;
+		FrameNode.bGameThread |= Span.bGameThread;
+
+		FrameFirstStart[Span.Frame] = FMath::Min(FrameFirstStart[Span.Frame], Span.Start);
+		FrameLastEnd[Span.Frame] = FMath::Max(FrameLastEnd[Span.Frame], Span.End);
+	}
+	//~
+
+	//~ Per processor averages. Waiting is the time between the last dependency finishing, or the first span of the frame, and starting.
+	struct FNodeStats
+	{
+		double Duration = 0.0;
+		double Wait = 0.0;
+		int32 NumFramesRun = 0;
+		int32 NumGameThreadFrames = 0;
+	};
+
+	TArray<FNodeStats> Stats;
+	Stats.SetNum(NumNodes);
+
+	int32 NumActiveFrames = 0;
+	double TotalWork = 0.0, TotalWall = 0.0;
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		if (FrameLastEnd[Frame] < FrameFirstStart[Frame]) continue;
+
+		++NumActiveFrames;
+		TotalWall += FrameLastEnd[Frame] - FrameFirstStart[Frame];
+
+		for (int32 Index = 0; Index < NumNodes; ++Index)
+		{
+			const FFrameNode& FrameNode = FrameNodes[Frame * NumNodes + Index];
+			if (!FrameNode.HasRun()) continue;
+
+			double Ready = FrameFirstStart[Frame];
+			for (const int32 Dependency : Nodes[Index].Dependencies)
+			{
+				const FFrameNode& DependencyNode = FrameNodes[Frame * NumNodes + Dependency];
+				if (DependencyNode.HasRun()) Ready = FMath::Max(Ready, DependencyNode.End);
+			}
+
+			FNodeStats& NodeStats = Stats[Index];
+			NodeStats.Duration += FrameNode.Busy;
+			NodeStats.Wait += FMath::Max(FrameNode.Start - Ready, 0.0);
+			NodeStats.NumFramesRun += 1;
+			NodeStats.NumGameThreadFrames += FrameNode.bGameThread ? 1 : 0;
+			TotalWork += FrameNode.Busy;
+		}
+	}
+
+	for (FNodeStats& NodeStats : Stats)
+	{
+		if (NodeStats.NumFramesRun == 0) continue;
+		NodeStats.Duration /= NodeStats.NumFramesRun;
+		NodeStats.Wait /= NodeStats.NumFramesRun;
+	}
+	//~
+
+	//~ Longest path through the graph weighted by average duration.
+	TArray<double> PathCost;
+	TArray<int32> PathPrevious;
+	PathCost.SetNumZeroed(NumNodes);
+	PathPrevious.Init(INDEX_NONE, NumNodes);
+
+	int32 CriticalEnd = INDEX_NONE;
+	for (const int32 Index : TopologicalOrder)
+	{
+		for (const int32 Dependency : Nodes[Index].Dependencies)
+		{
+			if (PathCost[Dependency] > PathCost[Index])
+			{
+				PathCost[Index] = PathCost[Dependency];
+				PathPrevious[Index] = Dependency;
+			}
+		}
+		PathCost[Index] += Stats[Index].Duration;
+
+		if (CriticalEnd == INDEX_NONE || PathCost[Index] > PathCost[CriticalEnd]) CriticalEnd = Index;
+	}
+
+	TArray<int32> CriticalPath;
+	for (int32 Index = CriticalEnd; Index != INDEX_NONE; Index = PathPrevious[Index])
+	{
+		CriticalPath.Insert(Index, 0);
+	}
+
+	const double CriticalPathCost = CriticalEnd != INDEX_NONE ? PathCost[CriticalEnd] : 0.0;
+	double CriticalGameThreadCost = 0.0;
+	for (const int32 Index : CriticalPath)
+	{
+		if (Nodes[Index].bGameThread) CriticalGameThreadCost += Stats[Index].Duration;
+	}
+	//~
+
+	//~ Processors that are neither ancestors nor descendants of a node are free to overlap with it.
+	TArray<TBitArray<>> Ancestors;
+	Ancestors.Init(TBitArray<>{false, NumNodes}, NumNodes);
+	for (const int32 Index : TopologicalOrder)
+	{
+		for (const int32 Dependency : Nodes[Index].Dependencies)
+		{
+			Ancestors[Index].CombineWithBitwiseOR(Ancestors[Dependency], EBitwiseOperatorFlags::MaintainSize);
+			Ancestors[Index][Dependency] = true;
+		}
+	}
+
+	TArray<int32> NumConcurrent;
+	NumConcurrent.Init(NumNodes - 1, NumNodes);
+	for (int32 Index = 0; Index < NumNodes; ++Index)
+	{
+		for (TConstSetBitIterator<> It{Ancestors[Index]}; It; ++It)
+		{
+			--NumConcurrent[Index];
+			--NumConcurrent[It.GetIndex()];
+		}
+	}
+	//~
+
+	//~ Serialize. Spans use the Chrome trace event format so the file also opens in Perfetto or chrome://tracing.
+	const auto Ms = [](const double Seconds) -> double { return Seconds * 1000.0; };
+	const double MeanWork = NumActiveFrames > 0 ? TotalWork / NumActiveFrames : 0.0;
+	const double MeanWall = NumActiveFrames > 0 ? TotalWall / NumActiveFrames : 0.0;
+
+	FString Json;
+	Json += TEXT("{\n");
+	Json += FString::Printf(TEXT("\t\"frames\": %d,\n"), NumActiveFrames);
+	Json += FString::Printf(TEXT("\t\"meanWorkMs\": %.4f,\n"), Ms(MeanWork));
+	Json += FString::Printf(TEXT("\t\"meanWallMs\": %.4f,\n"), Ms(MeanWall));
+	Json += FString::Printf(TEXT("\t\"criticalPathMs\": %.4f,\n"), Ms(CriticalPathCost));
+	Json += FString::Printf(TEXT("\t\"criticalPathGameThreadMs\": %.4f,\n"), Ms(CriticalGameThreadCost));
+	Json += FString::Printf(TEXT("\t\"availableParallelism\": %.3f,\n"), CriticalPathCost > 0.0 ? MeanWork / CriticalPathCost : 0.0);
+	Json += FString::Printf(TEXT("\t\"achievedParallelism\": %.3f,\n"), MeanWall > 0.0 ? MeanWork / MeanWall : 0.0);
+
+	Json += TEXT("\t\"criticalPath\": [");
+	for (int32 i = 0; i < CriticalPath.Num(); ++i)
+	{
+		Json += FString::Printf(TEXT("%s\"%s\""), i > 0 ? TEXT(", ") : TEXT(""), *Nodes[CriticalPath[i]].Name.ToString());
+	}
+	Json += TEXT("],\n");
+
+	Json += TEXT("\t\"processors\": [\n");
+	for (int32 Index = 0; Index < NumNodes; ++Index)
+	{
+		const FProcessorNode& Node = Nodes[Index];
+		const FNodeStats& NodeStats = Stats[Index];
+
+		FString Dependencies;
+		for (int32 i = 0; i < Node.Dependencies.Num(); ++i)
+		{
+			Dependencies += FString::Printf(TEXT("%s\"%s\""), i > 0 ? TEXT(", ") : TEXT(""), *Nodes[Node.Dependencies[i]].Name.ToString());
+		}
+
+		Json += FString::Printf(TEXT("\t\t{\"name\": \"%s\", \"group\": \"%s\", \"requiresGameThread\": %s, \"framesRun\": %d, \"gameThreadFrames\": %d, \"meanMs\": %.4f, \"meanWaitMs\": %.4f, \"concurrentProcessors\": %d, \"onCriticalPath\": %s, \"dependencies\": [%s]}%s\n"),
+			*Node.Name.ToString(), *Node.Group.ToString(), Node.bGameThread ? TEXT("true") : TEXT("false"), NodeStats.NumFramesRun, NodeStats.NumGameThreadFrames,
+			Ms(NodeStats.Duration), Ms(NodeStats.Wait), NumConcurrent[Index], CriticalPath.Contains(Index) ? TEXT("true") : TEXT("false"), *Dependencies,
+			Index + 1 < NumNodes ? TEXT(",") : TEXT(""));
+	}
+	Json += TEXT("\t],\n");
+
+	Json += TEXT("\t\"traceEvents\": [\n");
+	for (int32 i = 0; i < Spans.Num(); ++i)
+	{
+		const FMassProcessorSpan& Span = Spans[i];
+		Json += FString::Printf(TEXT("\t\t{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"frame\": %d}}%s\n"),
+			*Span.Processor.ToString(), Span.ThreadId, Span.Start * 1e6, (Span.End - Span.Start) * 1e6, Span.Frame, i + 1 < Spans.Num() ? TEXT(",") : TEXT(""));
+	}
+	Json += TEXT("\t]\n");
+	Json += TEXT("}\n");
+	//~
+
+	const FString Path = FPaths::ProfilingDir() / TEXT("MassProcessorGraph") / FString::Printf(TEXT("ProcessorGraph-%s.json"), *FDateTime::Now().ToString());
+	FFileHelper::SaveStringToFile(Json, *Path);
+
+	return Path;
+}
@@ -0,0 +1,76 @@
+#include "Projectile/ProjectileSubsystem.h"
+
+#include "MassEntityConfigAsset.h"
+#include "MassEntityManager.h"
+#include "MassEntityUtils.h"
+#include "Simulation/MassAsyncSimulationSubsystem.h"
+
+void UProjectileSubsystem::SpawnProjectiles(const UMassEntityConfigAsset& Config, TConstArrayView<FProjectileSpawnParams> Params)
+{
+	check(IsInGameThread());
+	if (Params.IsEmpty()) return;
+
+	// Entities are created outside of the Mass phases, which an async simulation step may be running through.
+	if (UMassAsyncSimulationSubsystem* Simulation = GetWorld()->GetSubsystem<UMassAsyncSimulationSubsystem>())
+	{
+		Simulation->WaitForSimulation();
+	}
+
+	const FMassEntityTemplate& Template = Config.GetOrCreateEntityTemplate(*GetWorld());
+	FMassEntityManager& Manager = UE::Mass::Utils::GetEntityManagerChecked(*GetWorld());
+
+	const auto InitProjectile = [&Manager](const FMassEntityHandle Entity, const FProjectileSpawnParams& Spawn) -> void
+	{
+		FProjectileFragment& Projectile = Manager.GetFragmentDataChecked<FProjectileFragment>(Entity);
+		Projectile.Location = Spawn.Location;
+		Projectile.Velocity = Spawn.Velocity;
+		Projectile.GravityScale = Spawn.GravityScale;
+		Projectile.RemainingLifetime = Spawn.Lifetime;
+	};
+
+	//~ Reuse pooled entities first. Their fragments are initialized in place, the inactive tag is dropped on the next flush.
+	int32 NumSpawned = 0;
+	{
+		FScopeLock Lock{&PoolCriticalSection};
+		if (TArray<FMassEntityHandle>* Pooled = Pool.Find(Template.GetArchetype()))
+		{
+			while (NumSpawned < Params.Num() && !Pooled->IsEmpty())
+			{
+				const FMassEntityHandle Entity = Pooled->Pop(false);
+				if (!Manager.IsEntityValid(Entity)) continue;
+
+				InitProjectile(Entity, Params[NumSpawned++]);
+				Manager.Defer().RemoveTag<FProjectileInactiveTag>(Entity);
+			}
+		}
+	}
+	//~
+
+	if (NumSpawned == Params.Num()) return;
+
+	TArray<FMassEntityHandle> NewEntities;
+	const TSharedRef<FMassEntityManager::FEntityCreationContext> CreationContext = Manager.BatchCreateEntities(Template.GetArchetype(), Template.GetSharedFragmentValues(), Params.Num() - NumSpawned, NewEntities);
+
+	for (int32 i = 0; i < NewEntities.Num(); ++i)
+	{
+		InitProjectile(NewEntities[i], Params[NumSpawned + i]);
+	}
+}
+
+void UProjectileSubsystem::BeginFrame()
+{
+	GetWriteHitEvents().Reset();
+
+	FScopeLock Lock{&PoolCriticalSection};
+	for (const TPair<FMassArchetypeHandle, FMassEntityHandle>& Released : PendingRelease)
+	{
+		Pool.FindOrAdd(Released.Key).Add(Released.Value);
+	}
+	PendingRelease.Reset();
+}
+
+void UProjectileSubsystem::ReleaseToPool(const FMassArchetypeHandle& Archetype, const FMassEntityHandle Entity)
+{
+	FScopeLock Lock{&PoolCriticalSection};
+	PendingRelease.Emplace(Archetype, Entity);
+}
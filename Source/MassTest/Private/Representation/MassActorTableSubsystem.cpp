@@ -0,0 +1,48 @@
+#include "Representation/MassActorTableSubsystem.h"
+
+#include "GameFramework/Actor.h"
+
+FMassActorHandle UMassActorTableSubsystem::RegisterActor(AActor* Actor)
+{
+	check(IsInGameThread());
+	check(Actor);
+
+	FMassActorHandle Handle;
+	if (!FreeIndices.IsEmpty())
+	{
+		Handle.Index = FreeIndices.Pop(false);
+	}
+	else
+	{
+		Handle.Index = Actors.AddDefaulted();
+		Generations.Add(1);
+	}
+
+	Handle.Generation = Generations[Handle.Index];
+	Actors[Handle.Index] = Actor;
+
+	return Handle;
+}
+
+void UMassActorTableSubsystem::UnregisterActor(const FMassActorHandle Handle)
+{
+	check(IsInGameThread());
+	if (!Generations.IsValidIndex(Handle.Index) || Generations[Handle.Index] != Handle.Generation) return;
+
+	Actors[Handle.Index] = nullptr;
+
+	// Zero is reserved for unset handles.
+	uint32& Generation = Generations[Handle.Index];
+	Generation = Generation == MAX_uint32 ? 1 : Generation + 1;
+
+	FreeIndices.Add(Handle.Index);
+}
+
+void UMassActorTableSubsystem::ResolveBatch(const TConstArrayView<FActorHandleFragment> Handles, TArray<AActor*>& OutActors) const
+{
+	OutActors.SetNumUninitialized(Handles.Num(), false);
+	for (int32 i = 0; i < Handles.Num(); ++i)
+	{
+		OutActors[i] = Resolve(Handles[i].Handle);
+	}
+}
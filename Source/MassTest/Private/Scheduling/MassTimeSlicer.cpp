@@ -0,0 +1,41 @@
+#include "Scheduling/MassTimeSlicer.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMassTimeSlicing, Log, All);
+
+namespace
+{
+	FCriticalSection SlicersCriticalSection;
+	TArray<const FMassTimeSlicer*> Slicers;
+}
+
+static FAutoConsoleCommand MassTestTimeSlicingReportCommand{
+	TEXT("MassTest.TimeSlicing.Report"),
+	TEXT("Logs how often each time sliced processor ran out of budget before reaching all of its chunks."),
+	FConsoleCommandDelegate::CreateStatic(&FMassTimeSlicer::LogReport)};
+
+FMassTimeSlicer::FMassTimeSlicer(const TCHAR* InName)
+	: Name{InName}
+{
+	FScopeLock Lock{&SlicersCriticalSection};
+	Slicers.Add(this);
+}
+
+FMassTimeSlicer::~FMassTimeSlicer()
+{
+	FScopeLock Lock{&SlicersCriticalSection};
+	Slicers.RemoveSingleSwap(this, false);
+}
+
+void FMassTimeSlicer::LogReport()
+{
+	FScopeLock Lock{&SlicersCriticalSection};
+
+	for (const FMassTimeSlicer* Slicer : Slicers)
+	{
+		// Processor CDOs own a slicer too, but never execute.
+		if (Slicer->NumFrames == 0) continue;
+
+		UE_LOG(LogMassTimeSlicing, Display, TEXT("MassTest.TimeSlicing: %s missed its budget %lld of %lld frames (%.1f%%), skipping up to %d chunks."),
+			Slicer->Name, Slicer->NumMissedFrames, Slicer->NumFrames, 100.0 * Slicer->NumMissedFrames / Slicer->NumFrames, Slicer->MaxSkippedChunks);
+	}
+}
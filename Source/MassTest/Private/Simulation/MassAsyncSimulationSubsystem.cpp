@@ -0,0 +1,147 @@
+#include "Simulation/MassAsyncSimulationSubsystem.h"
+
+#include "CharacterMovement/AvoidanceProcessor.h"
+#include "CharacterMovement/CharacterMovementProcessor.h"
+#include "Engine/World.h"
+#include "EntityCommon.h"
+#include "MassCommandBuffer.h"
+#include "MassEntityManager.h"
+#include "MassEntityUtils.h"
+#include "MassExecutor.h"
+#include "Simulation/SimulationSnapshotProcessor.h"
+#include "UObject/UObjectGlobals.h"
+
+static TAutoConsoleVariable<bool> CVarMassTestAsyncSimulation{
+	TEXT("MassTest.AsyncSimulation"),
+	false,
+	TEXT("Steps character movement at a fixed rate on a worker task between frames and interpolates actors between steps. Read when the world starts.")};
+
+static TAutoConsoleVariable<float> CVarMassTestAsyncSimulationTickRate{
+	TEXT("MassTest.AsyncSimulation.TickRate"),
+	60.f,
+	TEXT("Steps per second of the async simulation. Read when the world starts.")};
+
+// Set on the thread running a simulation step, so the same processor classes know to run there and nowhere else.
+static thread_local bool bIsInSimulationStep = false;
+
+void UMassAsyncSimulationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	bEnabled = CVarMassTestAsyncSimulation.GetValueOnGameThread() && GetWorld()->IsGameWorld();
+	if (!bEnabled) return;
+
+	FixedDeltaTime = 1.f / FMath::Max(CVarMassTestAsyncSimulationTickRate.GetValueOnGameThread(), 1.f);
+
+	TickStartHandle = FWorldDelegates::OnWorldTickStart.AddUObject(this, &UMassAsyncSimulationSubsystem::OnTickStart);
+	TickEndHandle = FWorldDelegates::OnWorldTickEnd.AddUObject(this, &UMassAsyncSimulationSubsystem::OnTickEnd);
+	PreGarbageCollectHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddUObject(this, &UMassAsyncSimulationSubsystem::OnPreGarbageCollect);
+	PreLevelRemovedHandle = FWorldDelegates::PreLevelRemovedFromWorld.AddUObject(this, &UMassAsyncSimulationSubsystem::OnPreLevelRemoved);
+}
+
+void UMassAsyncSimulationSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldTickStart.Remove(TickStartHandle);
+	FWorldDelegates::OnWorldTickEnd.Remove(TickEndHandle);
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGarbageCollectHandle);
+	FWorldDelegates::PreLevelRemovedFromWorld.Remove(PreLevelRemovedHandle);
+
+	// The entity manager may already be gone, leftover commands are dropped.
+	SimulationTask.Wait();
+	SimulationTask = {};
+	SimulationCommands.Reset();
+
+	Super::Deinitialize();
+}
+
+void UMassAsyncSimulationSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (!bEnabled) return;
+
+	// Run in this order every step. The snapshot processor only ever runs from here.
+	const TArray<const UMassProcessor*> Processors{
+		GetDefault<UAvoidanceProcessor>(),
+		GetDefault<UCharacterMovementProcessor>(),
+		GetDefault<USimulationSnapshotProcessor>()};
+
+	SimulationPipeline.CreateFromArray(Processors, *this);
+	SimulationPipeline.Initialize(*this);
+	SimulationCommands = MakeShared<FMassCommandBuffer>();
+}
+
+void UMassAsyncSimulationSubsystem::WaitForSimulation()
+{
+	check(IsInGameThread());
+	if (!SimulationTask.IsValid()) return;
+
+	SimulationTask.Wait();
+	SimulationTask = {};
+
+	if (SimulationCommands->HasPendingCommands())
+	{
+		UE::Mass::Utils::GetEntityManagerChecked(*GetWorld()).FlushCommands(SimulationCommands);
+	}
+}
+
+bool UMassAsyncSimulationSubsystem::ShouldExecuteMovement(const UMassProcessor& Processor)
+{
+	if (bIsInSimulationStep) return true;
+
+	const UMassAsyncSimulationSubsystem* Simulation = Processor.GetWorld() ? Processor.GetWorld()->GetSubsystem<UMassAsyncSimulationSubsystem>() : nullptr;
+	return !Simulation || !Simulation->IsEnabled();
+}
+
+void UMassAsyncSimulationSubsystem::OnTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld()) return;
+
+	// Joined before streaming, actors or any Mass phase run, so the rest of the frame sees the finished step.
+	WaitForSimulation();
+}
+
+void UMassAsyncSimulationSubsystem::OnPreGarbageCollect()
+{
+	// The step dereferences the components it hits.
+	WaitForSimulation();
+}
+
+void UMassAsyncSimulationSubsystem::OnPreLevelRemoved(ULevel* Level, UWorld* World)
+{
+	// A null world means every world.
+	if (World && World != GetWorld()) return;
+
+	WaitForSimulation();
+}
+
+void UMassAsyncSimulationSubsystem::OnTickEnd(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld() || SimulationPipeline.Processors.IsEmpty()) return;
+
+	WaitForSimulation();
+
+	Accumulator += DeltaSeconds;
+	const int32 NumSteps = FMath::Min(FMath::FloorToInt32(Accumulator / FixedDeltaTime), MAX_STEPS_PER_FRAME);
+	Accumulator = FMath::Min(Accumulator - NumSteps * FixedDeltaTime, FixedDeltaTime);
+	InterpolationAlpha = Accumulator / FixedDeltaTime;
+
+	if (NumSteps == 0) return;
+
+	FMassEntityManager& EntityManager = UE::Mass::Utils::GetEntityManagerChecked(*GetWorld());
+	SimulationTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, &EntityManager, NumSteps]() -> void
+	{
+		DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UMassAsyncSimulationSubsystem::Step"), STAT_MassAsyncSimulationStep, STATGROUP_MassTest);
+
+		TGuardValue<bool> SimulationStepGuard{bIsInSimulationStep, true};
+		for (int32 Step = 0; Step < NumSteps; ++Step)
+		{
+			// Commands are applied on the game thread when the step is joined.
+			FMassProcessingContext ProcessingContext{EntityManager, FixedDeltaTime};
+			ProcessingContext.CommandBuffer = SimulationCommands;
+			ProcessingContext.bFlushCommandBuffer = false;
+
+			UE::Mass::Executor::Run(SimulationPipeline, ProcessingContext);
+		}
+	});
+}
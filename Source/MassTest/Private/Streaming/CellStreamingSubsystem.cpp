@@ -0,0 +1,302 @@
+#include "Streaming/CellStreamingSubsystem.h"
+
+#include "Engine/World.h"
+#include "EntityCommon.h"
+#include "GameFramework/PlayerController.h"
+#include "Lockstep/LockstepSubsystem.h"
+#include "MassEntityManager.h"
+#include "MassEntityUtils.h"
+#include "MassSpawnerSubsystem.h"
+#include "Simulation/MassAsyncSimulationSubsystem.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMassCellStreaming, Log, All);
+
+static TAutoConsoleVariable<float> CVarMassTestStreamingCellSize{
+	TEXT("MassTest.Streaming.CellSize"),
+	5000.f,
+	TEXT("Size in cm of an entity streaming cell. Read when the world starts.")};
+
+static TAutoConsoleVariable<float> CVarMassTestStreamingLoadRadius{
+	TEXT("MassTest.Streaming.LoadRadius"),
+	15000.f,
+	TEXT("Cells closer than this to a player view point are streamed in. They are streamed out again one cell further away.")};
+
+static TAutoConsoleVariable<float> CVarMassTestStreamingBudgetMs{
+	TEXT("MassTest.Streaming.BudgetMs"),
+	1.f,
+	TEXT("Time in ms spent streaming cells per frame. At least one cell is processed whenever any is pending.")};
+
+void UCellStreamingSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CellSize = FMath::Max(CVarMassTestStreamingCellSize.GetValueOnGameThread(), 100.f);
+
+	if (GetWorld()->IsGameWorld())
+	{
+		PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UCellStreamingSubsystem::OnPostActorTick);
+	}
+}
+
+void UCellStreamingSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+
+	for (TPair<FIntPoint, TArray<FStreamedEntityBlock>>& Pair : UnloadedCells)
+	{
+		for (FStreamedEntityBlock& Block : Pair.Value)
+		{
+			DestroyBlock(Block);
+		}
+	}
+	UnloadedCells.Empty();
+	LoadedCells.Empty();
+
+	Super::Deinitialize();
+}
+
+void UCellStreamingSubsystem::ResetLoadedCells()
+{
+	// Keep the allocations of cells that are still populated, drop the ones that emptied out last frame.
+	for (auto It = LoadedCells.CreateIterator(); It; ++It)
+	{
+		if (It->Value.IsEmpty())
+		{
+			It.RemoveCurrent();
+		}
+		else
+		{
+			It->Value.Reset();
+		}
+	}
+}
+
+void UCellStreamingSubsystem::OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld() || (LoadedCells.IsEmpty() && UnloadedCells.IsEmpty())) return;
+
+	// View points aren't lockstep inputs, which entities exist can't depend on them.
+	const ULockstepSubsystem* Lockstep = World->GetSubsystem<ULockstepSubsystem>();
+	if (Lockstep && Lockstep->IsEnabled()) return;
+
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UCellStreamingSubsystem::Stream"), STAT_CellStreamingStream, STATGROUP_MassTest);
+
+	TArray<FVector, TInlineAllocator<4>> Sources;
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APlayerController* PlayerController = It->Get())
+		{
+			FVector Location;
+			FRotator Rotation;
+			PlayerController->GetPlayerViewPoint(Location, Rotation);
+			Sources.Add(Location);
+		}
+	}
+
+	// Nobody to stream around yet, keep everything as is.
+	if (Sources.IsEmpty()) return;
+
+	const double LoadRadius = CVarMassTestStreamingLoadRadius.GetValueOnGameThread();
+	const double UnloadRadius = LoadRadius + CellSize;
+
+	//~ Gather pending work. Loads go first and nearest first, the player is heading into those.
+	TArray<TPair<double, FIntPoint>> ToLoad;
+	for (const TPair<FIntPoint, TArray<FStreamedEntityBlock>>& Pair : UnloadedCells)
+	{
+		if (!IsInRange(Pair.Key, Sources, LoadRadius)) continue;
+
+		const FVector2D Center = (FVector2D{Pair.Key} + 0.5) * CellSize;
+		double MinDistanceSq = TNumericLimits<double>::Max();
+		for (const FVector& Source : Sources)
+		{
+			MinDistanceSq = FMath::Min(MinDistanceSq, FVector2D::DistSquared(Center, FVector2D{Source}));
+		}
+		ToLoad.Emplace(MinDistanceSq, Pair.Key);
+	}
+	ToLoad.Sort([](const TPair<double, FIntPoint>& A, const TPair<double, FIntPoint>& B) -> bool { return A.Key < B.Key; });
+
+	TArray<FIntPoint> ToUnload;
+	for (const TPair<FIntPoint, TArray<FMassEntityHandle>>& Pair : LoadedCells)
+	{
+		if (!Pair.Value.IsEmpty() && !IsInRange(Pair.Key, Sources, UnloadRadius))
+		{
+			ToUnload.Add(Pair.Key);
+		}
+	}
+	//~
+
+	if (ToLoad.IsEmpty() && ToUnload.IsEmpty()) return;
+
+	// Entities are created and destroyed directly, which an async simulation step may be iterating.
+	if (UMassAsyncSimulationSubsystem* Simulation = World->GetSubsystem<UMassAsyncSimulationSubsystem>())
+	{
+		Simulation->WaitForSimulation();
+	}
+
+	const double EndTime = FPlatformTime::Seconds() + CVarMassTestStreamingBudgetMs.GetValueOnGameThread() / 1000.0;
+	bool bProcessedAny = false;
+	const auto HasBudget = [&]() -> bool { return !bProcessedAny || FPlatformTime::Seconds() < EndTime; };
+
+	for (int32 i = 0; i < ToLoad.Num() && HasBudget(); ++i)
+	{
+		StreamIn(ToLoad[i].Value);
+		bProcessedAny = true;
+	}
+
+	for (int32 i = 0; i < ToUnload.Num() && HasBudget(); ++i)
+	{
+		StreamOut(ToUnload[i], LoadedCells.FindChecked(ToUnload[i]));
+		LoadedCells.Remove(ToUnload[i]);
+		bProcessedAny = true;
+	}
+}
+
+bool UCellStreamingSubsystem::IsInRange(const FIntPoint& Cell, TConstArrayView<FVector> Sources, const double Radius) const
+{
+	const FVector2D Min = FVector2D{Cell} * CellSize;
+	const FVector2D Max = Min + CellSize;
+
+	for (const FVector& Source : Sources)
+	{
+		const FVector2D Closest{FMath::Clamp(Source.X, Min.X, Max.X), FMath::Clamp(Source.Y, Min.Y, Max.Y)};
+		if (FVector2D::DistSquared(Closest, FVector2D{Source}) <= FMath::Square(Radius)) return true;
+	}
+
+	return false;
+}
+
+void UCellStreamingSubsystem::StreamOut(const FIntPoint& Cell, TConstArrayView<FMassEntityHandle> Entities)
+{
+	FMassEntityManager& Manager = UE::Mass::Utils::GetEntityManagerChecked(*GetWorld());
+
+	// Entities of one block share an archetype and a template, so they can be batch created back with the same shared fragments.
+	TMap<TPair<FMassArchetypeHandle, FMassEntityTemplateID>, TArray<FMassEntityHandle>> Groups;
+	TArray<FMassEntityHandle> Destroyed;
+	Destroyed.Reserve(Entities.Num());
+
+	// Actors, mirror slots and actor table slots aren't released nor restored, entities owning any stay loaded.
+	TMap<FMassArchetypeHandle, bool> Streamable;
+	const auto IsStreamable = [&Manager, &Streamable](const FMassArchetypeHandle& Archetype) -> bool
+	{
+		if (const bool* bStreamable = Streamable.Find(Archetype)) return *bStreamable;
+
+		const FMassFragmentBitSet& Fragments = Manager.GetArchetypeComposition(Archetype).Fragments;
+		return Streamable.Add(Archetype, !Fragments.Contains<FActorHandleFragment>() && !Fragments.Contains<FTransformMirrorFragment>());
+	};
+
+	for (const FMassEntityHandle Entity : Entities)
+	{
+		if (!Manager.IsEntityValid(Entity) || !IsStreamable(Manager.GetArchetypeForEntity(Entity))) continue;
+
+		const FMassEntityTemplateID& TemplateID = Manager.GetFragmentDataChecked<FCellStreamingFragment>(Entity).TemplateID;
+		Groups.FindOrAdd({Manager.GetArchetypeForEntity(Entity), TemplateID}).Add(Entity);
+		Destroyed.Add(Entity);
+	}
+
+	if (Destroyed.IsEmpty()) return;
+
+	TArray<FStreamedEntityBlock>& Blocks = UnloadedCells.FindOrAdd(Cell);
+	for (const TPair<TPair<FMassArchetypeHandle, FMassEntityTemplateID>, TArray<FMassEntityHandle>>& Group : Groups)
+	{
+		const TArray<FMassEntityHandle>& GroupEntities = Group.Value;
+
+		FStreamedEntityBlock& Block = Blocks.AddDefaulted_GetRef();
+		Block.Archetype = Group.Key.Key;
+		Block.TemplateID = Group.Key.Value;
+		Block.NumEntities = GroupEntities.Num();
+		Manager.GetArchetypeComposition(Block.Archetype).Fragments.ExportTypes(Block.FragmentTypes);
+
+		//~ Lay the columns out back to back, each aligned for its type.
+		int32 Size = 0;
+		Block.ColumnOffsets.Reserve(Block.FragmentTypes.Num());
+		for (const UScriptStruct* Type : Block.FragmentTypes)
+		{
+			check(Type->GetMinAlignment() <= 16);
+			Size = Align(Size, Type->GetMinAlignment());
+			Block.ColumnOffsets.Add(Size);
+			Size += Type->GetStructureSize() * Block.NumEntities;
+		}
+		Block.Data.SetNumUninitialized(Size);
+		//~
+
+		for (int32 Column = 0; Column < Block.FragmentTypes.Num(); ++Column)
+		{
+			const UScriptStruct* Type = Block.FragmentTypes[Column];
+			Type->InitializeStruct(Block.GetElement(Column, 0), Block.NumEntities);
+
+			for (int32 i = 0; i < Block.NumEntities; ++i)
+			{
+				Type->CopyScriptStruct(Block.GetElement(Column, i), Manager.GetFragmentDataStruct(GroupEntities[i], Type).GetMemory());
+			}
+		}
+
+		StreamedOutBytes += Block.Data.Num();
+	}
+
+	NumStreamedOutEntities += Destroyed.Num();
+	Manager.BatchDestroyEntities(Destroyed);
+}
+
+void UCellStreamingSubsystem::StreamIn(const FIntPoint& Cell)
+{
+	TArray<FStreamedEntityBlock> Blocks;
+	if (!UnloadedCells.RemoveAndCopyValue(Cell, Blocks)) return;
+
+	FMassEntityManager& Manager = UE::Mass::Utils::GetEntityManagerChecked(*GetWorld());
+	const FMassEntityTemplateRegistry& TemplateRegistry = GetWorld()->GetSubsystem<UMassSpawnerSubsystem>()->GetTemplateRegistryInstance();
+
+	TArray<FMassEntityHandle> NewEntities;
+	for (FStreamedEntityBlock& Block : Blocks)
+	{
+		NumStreamedOutEntities -= Block.NumEntities;
+		StreamedOutBytes -= Block.Data.Num();
+
+		const TSharedRef<FMassEntityTemplate>* Template = TemplateRegistry.FindTemplateFromTemplateID(Block.TemplateID);
+		if (!Template)
+		{
+			UE_LOG(LogMassCellStreaming, Warning, TEXT("MassTest.Streaming: template of %d entities in cell %s is gone, dropping them."), Block.NumEntities, *Cell.ToString());
+			DestroyBlock(Block);
+			continue;
+		}
+
+		NewEntities.Reset();
+		{
+			// Chunks for the whole block are allocated up front. Add observers run once CreationContext goes out of scope, after the fragments are restored.
+			const TSharedRef<FMassEntityManager::FEntityCreationContext> CreationContext = Manager.BatchCreateEntities(Block.Archetype, (*Template)->GetSharedFragmentValues(), Block.NumEntities, NewEntities);
+
+			for (int32 Column = 0; Column < Block.FragmentTypes.Num(); ++Column)
+			{
+				const UScriptStruct* Type = Block.FragmentTypes[Column];
+				for (int32 i = 0; i < NewEntities.Num(); ++i)
+				{
+					Type->CopyScriptStruct(Manager.GetFragmentDataStruct(NewEntities[i], Type).GetMemory(), Block.GetElement(Column, i));
+				}
+
+				// The time spent streamed out isn't owed to the entity, it starts over like a new one rather than catching up on it.
+				if (Type == FTimeSlicedFragment::StaticStruct())
+				{
+					for (const FMassEntityHandle Entity : NewEntities)
+					{
+						Manager.GetFragmentDataChecked<FTimeSlicedFragment>(Entity).LastProcessedTime = -1.0;
+					}
+				}
+			}
+		}
+
+		DestroyBlock(Block);
+	}
+}
+
+void UCellStreamingSubsystem::DestroyBlock(FStreamedEntityBlock& Block)
+{
+	if (Block.NumEntities > 0)
+	{
+		for (int32 Column = 0; Column < Block.FragmentTypes.Num(); ++Column)
+		{
+			Block.FragmentTypes[Column]->DestroyStruct(Block.GetElement(Column, 0), Block.NumEntities);
+		}
+	}
+
+	Block.NumEntities = 0;
+	Block.Data.Empty();
+}
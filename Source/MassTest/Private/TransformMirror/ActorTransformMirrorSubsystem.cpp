@@ -0,0 +1,100 @@
+#include "TransformMirror/ActorTransformMirrorSubsystem.h"
+
+#include "Engine/World.h"
+#include "EntityCommon.h"
+#include "GameFramework/Actor.h"
+
+void UActorTransformMirrorSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UActorTransformMirrorSubsystem::OnPostActorTick);
+}
+
+void UActorTransformMirrorSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+
+	Super::Deinitialize();
+}
+
+int32 UActorTransformMirrorSubsystem::RegisterActor(AActor* Actor)
+{
+	check(IsInGameThread());
+	check(Actor);
+
+	int32 Slot;
+	if (!FreeSlots.IsEmpty())
+	{
+		Slot = FreeSlots.Pop(false);
+	}
+	else
+	{
+		Slot = Actors.AddDefaulted();
+		MassWrittenTransforms.AddDefaulted();
+	}
+
+	// Workers may be reading the front buffer right now, so neither buffer is touched here: the slot is seeded into the
+	// back buffer at the end of the frame and reaches Mass with the swap.
+	Actors[Slot] = Actor;
+	MassWrittenTransforms[Slot] = Actor->GetActorTransform();
+	PendingSlots.Add(Slot);
+
+	return Slot;
+}
+
+void UActorTransformMirrorSubsystem::UnregisterActor(const int32 Slot)
+{
+	check(IsInGameThread());
+	if (!Actors.IsValidIndex(Slot)) return;
+
+	// The front buffer may still flag the slot until the swap, it's only reused once it doesn't.
+	Actors[Slot].Reset();
+	ReleasedSlots.Add(Slot);
+}
+
+void UActorTransformMirrorSubsystem::OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld()) return;
+
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UActorTransformMirrorSubsystem::OnPostActorTick"), STAT_ActorTransformMirrorUpdate, STATGROUP_MassTest);
+
+	FActorTransformMirrorBuffer& BackBuffer = Buffers[FrontIndex ^ 1];
+	BackBuffer.Transforms.SetNum(Actors.Num());
+	BackBuffer.Dirty.SetNum(Actors.Num(), false);
+	for (int32 Slot = 0; Slot < Actors.Num(); ++Slot)
+	{
+		const AActor* Actor = Actors[Slot].Get();
+		if (!Actor)
+		{
+			BackBuffer.Dirty[Slot] = false;
+			continue;
+		}
+
+		const FTransform& Transform = Actor->GetActorTransform();
+		const bool bMovedOutsideMass = !Transform.EqualsNoScale(MassWrittenTransforms[Slot]);
+
+		BackBuffer.Dirty[Slot] = bMovedOutsideMass;
+		if (bMovedOutsideMass)
+		{
+			BackBuffer.Transforms[Slot] = Transform;
+			MassWrittenTransforms[Slot] = Transform;
+		}
+	}
+
+	// Seed newly registered actors so Mass picks their transform up straight away.
+	for (const int32 Slot : PendingSlots)
+	{
+		if (const AActor* Actor = Actors[Slot].Get())
+		{
+			BackBuffer.Transforms[Slot] = Actor->GetActorTransform();
+			BackBuffer.Dirty[Slot] = true;
+		}
+	}
+	PendingSlots.Reset();
+
+	FrontIndex ^= 1;
+
+	FreeSlots.Append(ReleasedSlots);
+	ReleasedSlots.Reset();
+}
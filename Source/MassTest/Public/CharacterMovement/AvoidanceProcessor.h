@@ -0,0 +1,498 @@
+
+#pragma once
+
+#include "CharacterMovementProcessor.h"
+#include "EntityCommon.h"
+#include "Lockstep/DeterministicMath.h"
+#include "MassProcessor.h"
+#include "Profiling/ProcessorGraphProfiler.h"
+#include "Simulation/MassAsyncSimulationSubsystem.h"
+#include "MassCommonFragments.h"
+#include "MassCommonTypes.h"
+#include "MassExecutionContext.h"
+#include "Async/ParallelFor.h"
+#include "Math/VectorRegister.h"
+#include "AvoidanceProcessor.generated.h"
+
+static TAutoConsoleVariable<float> CVarMassTestAvoidanceTimeHorizon{
+	TEXT("MassTest.Avoidance.TimeHorizon"),
+	1.f,
+	TEXT("Seconds ahead ORCA guarantees collision free velocities for.")};
+
+static TAutoConsoleVariable<float> CVarMassTestAvoidanceNeighborDistance{
+	TEXT("MassTest.Avoidance.NeighborDistance"),
+	300.f,
+	TEXT("Max distance in cm at which other characters are considered by avoidance.")};
+
+MASSTEST_DETERMINISTIC_FP_BEGIN
+
+namespace UE::MassTest::Avoidance
+{
+	// Half-plane of permitted velocities: everything left of Direction through Point.
+	struct FOrcaLine
+	{
+		FVector2f Point;
+		FVector2f Direction;
+	};
+
+	FORCEINLINE float Det(const FVector2f& A, const FVector2f& B) { return A.X * B.Y - A.Y * B.X; }
+
+	// Linear programs from "Reciprocal n-body Collision Avoidance" (van den Berg et al.), solved against a max speed disc.
+	inline bool LinearProgram1(const TConstArrayView<FOrcaLine> Lines, const int32 LineNo, const float Radius, const FVector2f& OptVelocity, const bool bDirectionOpt, FVector2f& Result)
+	{
+		const FOrcaLine& Line = Lines[LineNo];
+		const float DotProduct = Line.Point | Line.Direction;
+		const float Discriminant = FMath::Square(DotProduct) + FMath::Square(Radius) - Line.Point.SizeSquared();
+		if (Discriminant < 0.f) return false;
+
+		const float SqrtDiscriminant = FMath::Sqrt(Discriminant);
+		float TLeft = -DotProduct - SqrtDiscriminant;
+		float TRight = -DotProduct + SqrtDiscriminant;
+
+		for (int32 i = 0; i < LineNo; ++i)
+		{
+			const float Denominator = Det(Line.Direction, Lines[i].Direction);
+			const float Numerator = Det(Lines[i].Direction, Line.Point - Lines[i].Point);
+
+			if (FMath::Abs(Denominator) <= UE_KINDA_SMALL_NUMBER)
+			{
+				if (Numerator < 0.f) return false;
+				continue;
+			}
+
+			const float T = Numerator / Denominator;
+			if (Denominator >= 0.f) TRight = FMath::Min(TRight, T);
+			else TLeft = FMath::Max(TLeft, T);
+
+			if (TLeft > TRight) return false;
+		}
+
+		if (bDirectionOpt)
+		{
+			Result = Line.Point + Line.Direction * ((OptVelocity | Line.Direction) > 0.f ? TRight : TLeft);
+		}
+		else
+		{
+			Result = Line.Point + Line.Direction * FMath::Clamp(Line.Direction | (OptVelocity - Line.Point), TLeft, TRight);
+		}
+
+		return true;
+	}
+
+	// Returns the number of lines satisfied. Lines.Num() on success.
+	inline int32 LinearProgram2(const TConstArrayView<FOrcaLine> Lines, const float Radius, const FVector2f& OptVelocity, const bool bDirectionOpt, FVector2f& Result)
+	{
+		if (bDirectionOpt) Result = OptVelocity * Radius;
+		else if (OptVelocity.SizeSquared() > FMath::Square(Radius)) Result = UE::MassTest::Deterministic::GetSafeNormal(OptVelocity) * Radius;
+		else Result = OptVelocity;
+
+		for (int32 i = 0; i < Lines.Num(); ++i)
+		{
+			if (Det(Lines[i].Direction, Lines[i].Point - Result) <= 0.f) continue;
+
+			const FVector2f TempResult = Result;
+			if (!LinearProgram1(Lines, i, Radius, OptVelocity, bDirectionOpt, Result))
+			{
+				Result = TempResult;
+				return i;
+			}
+		}
+
+		return Lines.Num();
+	}
+
+	// Infeasible case: minimizes the max penetration of the remaining lines.
+	inline void LinearProgram3(const TConstArrayView<FOrcaLine> Lines, const int32 BeginLine, const float Radius, FVector2f& Result)
+	{
+		TArray<FOrcaLine, TInlineAllocator<32>> ProjectedLines;
+		float Distance = 0.f;
+
+		for (int32 i = BeginLine; i < Lines.Num(); ++i)
+		{
+			if (Det(Lines[i].Direction, Lines[i].Point - Result) <= Distance) continue;
+
+			ProjectedLines.Reset();
+			for (int32 j = 0; j < i; ++j)
+			{
+				FOrcaLine Line;
+				const float Determinant = Det(Lines[i].Direction, Lines[j].Direction);
+				if (FMath::Abs(Determinant) <= UE_KINDA_SMALL_NUMBER)
+				{
+					if ((Lines[i].Direction | Lines[j].Direction) > 0.f) continue;
+					Line.Point = (Lines[i].Point + Lines[j].Point) * 0.5f;
+				}
+				else
+				{
+					Line.Point = Lines[i].Point + Lines[i].Direction * (Det(Lines[j].Direction, Lines[i].Point - Lines[j].Point) / Determinant);
+				}
+
+				Line.Direction = UE::MassTest::Deterministic::GetSafeNormal(Lines[j].Direction - Lines[i].Direction);
+				ProjectedLines.Add(Line);
+			}
+
+			const FVector2f TempResult = Result;
+			if (LinearProgram2(ProjectedLines, Radius, FVector2f{-Lines[i].Direction.Y, Lines[i].Direction.X}, true, Result) < ProjectedLines.Num())
+			{
+				Result = TempResult;
+			}
+
+			Distance = Det(Lines[i].Direction, Lines[i].Point - Result);
+		}
+	}
+}
+
+UCLASS()
+class MASSTEST_API UAvoidanceProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	explicit UAvoidanceProcessor();
+
+	static constexpr int32 MAX_NEIGHBORS = 16;
+
+protected:
+	//~ Begin UMassProcessor interface
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	//~ End UMassProcessor interface
+
+	// Gathers up to MAX_NEIGHBORS closest agents (padded to a multiple of 4 with far away dummies) and solves for a new velocity.
+	FVector2f SolveAgent(const int32 AgentIndex, const float NeighborDistance, const float InvTimeHorizon, const float InvDeltaTime) const;
+
+	FORCEINLINE uint32 HashCell(const int32 X, const int32 Y) const { return (uint32(X) * 73856093u ^ uint32(Y) * 19349663u) & (NumBuckets - 1); }
+
+private:
+	FMassEntityQuery CharacterQuery;
+
+	//~ Per frame agent snapshot in SoA, in query iteration order.
+	TArray<float> PositionX, PositionY, VelocityX, VelocityY, Radii;
+	// Orders neighbors at equal distance: the lockstep id when present so peers agree regardless of chunk layout, else the agent index.
+	TArray<uint32> TieBreakKeys;
+	TArray<FIntPoint> Cells;
+	TArray<FVector2f> PreferredVelocities;
+	TArray<FVector2f> NewVelocities;
+	TArray<TPair<int32, int32>> AvoidingChunkRanges;
+	//~
+
+	//~ Spatial hash, counting sorted into buckets.
+	TArray<int32> BucketStarts;
+	TArray<int32> SortedAgents;
+	uint32 NumBuckets = 0;
+	float CellSize = 1.f;
+	//~
+};
+
+inline UAvoidanceProcessor::UAvoidanceProcessor()
+{
+	bRequiresGameThreadExecution = false;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::AllNetModes;
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::Movement;
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::ProcessInput);
+	ExecutionOrder.ExecuteBefore.Add(UCharacterMovementProcessor::StaticClass()->GetFName());
+}
+
+inline void UAvoidanceProcessor::ConfigureQueries()
+{
+	CharacterQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	CharacterQuery.AddRequirement<FVelocityFragment>(EMassFragmentAccess::ReadOnly);
+	CharacterQuery.AddRequirement<FCapsuleFragment>(EMassFragmentAccess::ReadOnly);
+	CharacterQuery.AddRequirement<FMovementInputFragment>(EMassFragmentAccess::ReadWrite);
+	CharacterQuery.AddTagRequirement<FCharacterMovementTag>(EMassFragmentPresence::All);
+	CharacterQuery.AddRequirement<FLockstepIdFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	CharacterQuery.AddTagRequirement<FAvoidanceTag>(EMassFragmentPresence::Optional);
+	CharacterQuery.RegisterWithProcessor(*this);
+}
+
+inline void UAvoidanceProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	if (!UMassAsyncSimulationSubsystem::ShouldExecuteMovement(*this)) return;
+
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UAvoidanceProcessor::Execute"), STAT_AvoidanceProcessor, STATGROUP_MassTest);
+	MASSTEST_PROCESSOR_SPAN();
+
+	using namespace UE::MassTest::Avoidance;
+
+	const float NeighborDistance = FMath::Max(CVarMassTestAvoidanceNeighborDistance.GetValueOnAnyThread(), 1.f);
+	const float InvTimeHorizon = 1.f / FMath::Max(CVarMassTestAvoidanceTimeHorizon.GetValueOnAnyThread(), UE_KINDA_SMALL_NUMBER);
+	const float InvDeltaTime = 1.f / FMath::Max(Context.GetDeltaTimeSeconds(), UE_KINDA_SMALL_NUMBER);
+
+	//~ Snapshot every character. Agents without FAvoidanceTag are obstacles only.
+	const int32 NumAgents = CharacterQuery.GetNumMatchingEntities(EntityManager);
+	if (NumAgents == 0) return;
+
+	for (TArray<float>* Array : {&PositionX, &PositionY, &VelocityX, &VelocityY, &Radii})
+	{
+		Array->Reset(NumAgents);
+	}
+	TieBreakKeys.Reset(NumAgents);
+	Cells.Reset(NumAgents);
+	PreferredVelocities.Reset(NumAgents);
+	AvoidingChunkRanges.Reset();
+
+	CellSize = NeighborDistance;
+
+	CharacterQuery.ForEachEntityChunk(EntityManager, Context, [this](FMassExecutionContext& Context) -> void
+	{
+		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
+		const TConstArrayView<FVelocityFragment> Velocities = Context.GetFragmentView<FVelocityFragment>();
+		const TConstArrayView<FCapsuleFragment> Capsules = Context.GetFragmentView<FCapsuleFragment>();
+		const TConstArrayView<FMovementInputFragment> MovementInputs = Context.GetFragmentView<FMovementInputFragment>();
+		const TConstArrayView<FLockstepIdFragment> LockstepIds = Context.GetFragmentView<FLockstepIdFragment>();
+
+		if (Context.DoesArchetypeHaveTag<FAvoidanceTag>())
+		{
+			AvoidingChunkRanges.Emplace(PositionX.Num(), Context.GetNumEntities());
+		}
+
+		for (int32 i = 0; i < Context.GetNumEntities(); ++i)
+		{
+			const FTransform& Transform = Transforms[i].GetTransform();
+			const FVector Location = Transform.GetLocation();
+
+			PositionX.Add((float)Location.X);
+			PositionY.Add((float)Location.Y);
+			VelocityX.Add(Velocities[i].Velocity.X);
+			VelocityY.Add(Velocities[i].Velocity.Y);
+			Radii.Add(Capsules[i].Radius);
+			TieBreakKeys.Add(LockstepIds.IsEmpty() ? (uint32)TieBreakKeys.Num() : LockstepIds[i].Id);
+			Cells.Emplace(FMath::FloorToInt32(Location.X / CellSize), FMath::FloorToInt32(Location.Y / CellSize));
+
+			// Same yaw-relative mapping UCharacterMovementProcessor applies to movement input.
+			const FQuat YawRotation = UE::MassTest::Deterministic::GetYawRotation(Transform.GetRotation());
+			const FVector2f& Input = MovementInputs[i].MovementInput;
+			const FVector WorldInput = YawRotation.RotateVector(FVector{Input.X, Input.Y, 0.0});
+			PreferredVelocities.Emplace(FVector2f{(float)WorldInput.X, (float)WorldInput.Y} * UCharacterMovementProcessor::MAX_MOVE_SPEED);
+		}
+	});
+
+	if (AvoidingChunkRanges.IsEmpty()) return;
+	//~
+
+	//~ Counting sort agents into a power of two spatial hash. Bucket collisions are filtered out by cell when gathering.
+	NumBuckets = FMath::RoundUpToPowerOfTwo(FMath::Max(NumAgents * 2, 64));
+	BucketStarts.Reset(NumBuckets + 1);
+	BucketStarts.AddZeroed(NumBuckets + 1);
+	SortedAgents.SetNumUninitialized(NumAgents);
+
+	for (int32 i = 0; i < NumAgents; ++i)
+	{
+		++BucketStarts[HashCell(Cells[i].X, Cells[i].Y) + 1];
+	}
+	for (uint32 Bucket = 1; Bucket <= NumBuckets; ++Bucket)
+	{
+		BucketStarts[Bucket] += BucketStarts[Bucket - 1];
+	}
+	{
+		TArray<int32> Cursors{BucketStarts.GetData(), (int32)NumBuckets};
+		for (int32 i = 0; i < NumAgents; ++i)
+		{
+			SortedAgents[Cursors[HashCell(Cells[i].X, Cells[i].Y)]++] = i;
+		}
+	}
+	//~
+
+	//~ Solve each avoiding chunk in parallel. Results are written back in the same iteration order below.
+	NewVelocities.SetNumUninitialized(NumAgents);
+	ParallelFor(AvoidingChunkRanges.Num(), [&](const int32 ChunkIndex) -> void
+	{
+		const TPair<int32, int32>& Range = AvoidingChunkRanges[ChunkIndex];
+		for (int32 AgentIndex = Range.Key; AgentIndex < Range.Key + Range.Value; ++AgentIndex)
+		{
+			NewVelocities[AgentIndex] = SolveAgent(AgentIndex, NeighborDistance, InvTimeHorizon, InvDeltaTime);
+		}
+	});
+	//~
+
+	int32 AgentIndex = 0;
+	CharacterQuery.ForEachEntityChunk(EntityManager, Context, [this, &AgentIndex](FMassExecutionContext& Context) -> void
+	{
+		if (!Context.DoesArchetypeHaveTag<FAvoidanceTag>())
+		{
+			AgentIndex += Context.GetNumEntities();
+			return;
+		}
+
+		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
+		const TArrayView<FMovementInputFragment> MovementInputs = Context.GetMutableFragmentView<FMovementInputFragment>();
+
+		for (int32 i = 0; i < Context.GetNumEntities(); ++i, ++AgentIndex)
+		{
+			const FQuat YawRotation = UE::MassTest::Deterministic::GetYawRotation(Transforms[i].GetTransform().GetRotation());
+
+			const FVector2f NewInput = NewVelocities[AgentIndex] / UCharacterMovementProcessor::MAX_MOVE_SPEED;
+			const FVector LocalInput = YawRotation.UnrotateVector(FVector{NewInput.X, NewInput.Y, 0.f});
+			MovementInputs[i].MovementInput = FVector2f{(float)LocalInput.X, (float)LocalInput.Y}.GetClampedToMaxSize(1.f);
+		}
+	});
+}
+
+inline FVector2f UAvoidanceProcessor::SolveAgent(const int32 AgentIndex, const float NeighborDistance, const float InvTimeHorizon, const float InvDeltaTime) const
+{
+	using namespace UE::MassTest::Avoidance;
+
+	static constexpr int32 MAX_PADDED_NEIGHBORS = MAX_NEIGHBORS + 3;
+
+	//~ Gather the closest neighbors, kept sorted by distance.
+	int32 Neighbors[MAX_NEIGHBORS];
+	float NeighborDistancesSq[MAX_NEIGHBORS];
+	int32 NumNeighbors = 0;
+
+	const float PX = PositionX[AgentIndex];
+	const float PY = PositionY[AgentIndex];
+	const FIntPoint Cell = Cells[AgentIndex];
+	const float NeighborDistanceSq = FMath::Square(NeighborDistance);
+
+	// Strict ordering by distance then tie break key, so the gathered set doesn't depend on bucket iteration order.
+	const auto IsCloser = [this](const float DistanceSq, const int32 Agent, const float OtherDistanceSq, const int32 OtherAgent) -> bool
+	{
+		return DistanceSq < OtherDistanceSq || (DistanceSq == OtherDistanceSq && TieBreakKeys[Agent] < TieBreakKeys[OtherAgent]);
+	};
+
+	for (int32 Y = Cell.Y - 1; Y <= Cell.Y + 1; ++Y)
+	{
+		for (int32 X = Cell.X - 1; X <= Cell.X + 1; ++X)
+		{
+			const uint32 Bucket = HashCell(X, Y);
+			for (int32 s = BucketStarts[Bucket]; s < BucketStarts[Bucket + 1]; ++s)
+			{
+				const int32 Other = SortedAgents[s];
+				if (Other == AgentIndex || Cells[Other] != FIntPoint{X, Y}) continue;
+
+				const float DistanceSq = FMath::Square(PositionX[Other] - PX) + FMath::Square(PositionY[Other] - PY);
+				if (DistanceSq >= NeighborDistanceSq || (NumNeighbors == MAX_NEIGHBORS && !IsCloser(DistanceSq, Other, NeighborDistancesSq[NumNeighbors - 1], Neighbors[NumNeighbors - 1]))) continue;
+
+				int32 Insert = FMath::Min(NumNeighbors, MAX_NEIGHBORS - 1);
+				for (; Insert > 0 && IsCloser(DistanceSq, Other, NeighborDistancesSq[Insert - 1], Neighbors[Insert - 1]); --Insert)
+				{
+					Neighbors[Insert] = Neighbors[Insert - 1];
+					NeighborDistancesSq[Insert] = NeighborDistancesSq[Insert - 1];
+				}
+				Neighbors[Insert] = Other;
+				NeighborDistancesSq[Insert] = DistanceSq;
+				NumNeighbors = FMath::Min(NumNeighbors + 1, MAX_NEIGHBORS);
+			}
+		}
+	}
+
+	const FVector2f PreferredVelocity = PreferredVelocities[AgentIndex];
+	if (NumNeighbors == 0) return PreferredVelocity;
+	//~
+
+	//~ Relative state in SoA, padded with far away neighbors whose lines are discarded.
+	alignas(16) float RelPosX[MAX_PADDED_NEIGHBORS], RelPosY[MAX_PADDED_NEIGHBORS], RelVelX[MAX_PADDED_NEIGHBORS], RelVelY[MAX_PADDED_NEIGHBORS], CombinedRadii[MAX_PADDED_NEIGHBORS];
+	alignas(16) float PointX[MAX_PADDED_NEIGHBORS], PointY[MAX_PADDED_NEIGHBORS], DirectionX[MAX_PADDED_NEIGHBORS], DirectionY[MAX_PADDED_NEIGHBORS];
+
+	const float VX = VelocityX[AgentIndex];
+	const float VY = VelocityY[AgentIndex];
+	const float Radius = Radii[AgentIndex];
+	const int32 NumPadded = Align(NumNeighbors, 4);
+
+	for (int32 n = 0; n < NumPadded; ++n)
+	{
+		const bool bPadding = n >= NumNeighbors;
+		const int32 Other = bPadding ? AgentIndex : Neighbors[n];
+		RelPosX[n] = bPadding ? 1.e6f : PositionX[Other] - PX;
+		RelPosY[n] = bPadding ? 0.f : PositionY[Other] - PY;
+		RelVelX[n] = bPadding ? 0.f : VX - VelocityX[Other];
+		RelVelY[n] = bPadding ? 0.f : VY - VelocityY[Other];
+		CombinedRadii[n] = bPadding ? 1.f : Radius + Radii[Other];
+	}
+	//~
+
+	//~ Build ORCA lines 4 neighbors at a time. All three cases (cut-off circle, legs, already colliding) are evaluated and blended by mask.
+	const VectorRegister4Float Zero = VectorZeroFloat();
+	const VectorRegister4Float Half = VectorSetFloat1(0.5f);
+	const VectorRegister4Float Epsilon = VectorSetFloat1(UE_KINDA_SMALL_NUMBER);
+	const VectorRegister4Float VInvTimeHorizon = VectorSetFloat1(InvTimeHorizon);
+	const VectorRegister4Float VInvDeltaTime = VectorSetFloat1(InvDeltaTime);
+	const VectorRegister4Float VVelocityX = VectorSetFloat1(VX);
+	const VectorRegister4Float VVelocityY = VectorSetFloat1(VY);
+
+	for (int32 n = 0; n < NumPadded; n += 4)
+	{
+		const VectorRegister4Float RPX = VectorLoadAligned(&RelPosX[n]);
+		const VectorRegister4Float RPY = VectorLoadAligned(&RelPosY[n]);
+		const VectorRegister4Float RVX = VectorLoadAligned(&RelVelX[n]);
+		const VectorRegister4Float RVY = VectorLoadAligned(&RelVelY[n]);
+		const VectorRegister4Float CR = VectorLoadAligned(&CombinedRadii[n]);
+
+		const VectorRegister4Float DistSq = VectorMultiplyAdd(RPX, RPX, VectorMultiply(RPY, RPY));
+		const VectorRegister4Float CRSq = VectorMultiply(CR, CR);
+
+		//~ Cut-off circle.
+		const VectorRegister4Float WX = VectorSubtract(RVX, VectorMultiply(VInvTimeHorizon, RPX));
+		const VectorRegister4Float WY = VectorSubtract(RVY, VectorMultiply(VInvTimeHorizon, RPY));
+		const VectorRegister4Float WLengthSq = VectorMultiplyAdd(WX, WX, VectorMultiply(WY, WY));
+		const VectorRegister4Float WDotRelPos = VectorMultiplyAdd(WX, RPX, VectorMultiply(WY, RPY));
+		const VectorRegister4Float CutOffMask = VectorBitwiseAnd(
+			VectorCompareGT(Zero, WDotRelPos),
+			VectorCompareGT(VectorMultiply(WDotRelPos, WDotRelPos), VectorMultiply(CRSq, WLengthSq)));
+
+		const VectorRegister4Float WLength = VectorSqrt(VectorMax(WLengthSq, Epsilon));
+		const VectorRegister4Float UnitWX = VectorDivide(WX, WLength);
+		const VectorRegister4Float UnitWY = VectorDivide(WY, WLength);
+		const VectorRegister4Float CutOffScale = VectorSubtract(VectorMultiply(CR, VInvTimeHorizon), WLength);
+		//~
+
+		//~ Legs of the velocity obstacle cone.
+		const VectorRegister4Float Leg = VectorSqrt(VectorMax(VectorSubtract(DistSq, CRSq), Zero));
+		const VectorRegister4Float InvDistSq = VectorDivide(VectorOneFloat(), VectorMax(DistSq, Epsilon));
+		const VectorRegister4Float LeftLegMask = VectorCompareGT(VectorSubtract(VectorMultiply(RPX, WY), VectorMultiply(RPY, WX)), Zero);
+
+		const VectorRegister4Float LeftX = VectorMultiply(VectorSubtract(VectorMultiply(RPX, Leg), VectorMultiply(RPY, CR)), InvDistSq);
+		const VectorRegister4Float LeftY = VectorMultiply(VectorMultiplyAdd(RPX, CR, VectorMultiply(RPY, Leg)), InvDistSq);
+		const VectorRegister4Float RightX = VectorNegate(VectorMultiply(VectorMultiplyAdd(RPX, Leg, VectorMultiply(RPY, CR)), InvDistSq));
+		const VectorRegister4Float RightY = VectorNegate(VectorMultiply(VectorSubtract(VectorMultiply(RPY, Leg), VectorMultiply(RPX, CR)), InvDistSq));
+		const VectorRegister4Float LegX = VectorSelect(LeftLegMask, LeftX, RightX);
+		const VectorRegister4Float LegY = VectorSelect(LeftLegMask, LeftY, RightY);
+		const VectorRegister4Float LegDot = VectorMultiplyAdd(RVX, LegX, VectorMultiply(RVY, LegY));
+		//~
+
+		//~ Already colliding: resolve within one time step.
+		const VectorRegister4Float W2X = VectorSubtract(RVX, VectorMultiply(VInvDeltaTime, RPX));
+		const VectorRegister4Float W2Y = VectorSubtract(RVY, VectorMultiply(VInvDeltaTime, RPY));
+		const VectorRegister4Float W2Length = VectorSqrt(VectorMax(VectorMultiplyAdd(W2X, W2X, VectorMultiply(W2Y, W2Y)), Epsilon));
+		const VectorRegister4Float UnitW2X = VectorDivide(W2X, W2Length);
+		const VectorRegister4Float UnitW2Y = VectorDivide(W2Y, W2Length);
+		const VectorRegister4Float CollisionScale = VectorSubtract(VectorMultiply(CR, VInvDeltaTime), W2Length);
+		const VectorRegister4Float CollisionMask = VectorCompareGE(CRSq, DistSq);
+		//~
+
+		VectorRegister4Float DirX = VectorSelect(CutOffMask, UnitWY, LegX);
+		VectorRegister4Float DirY = VectorSelect(CutOffMask, VectorNegate(UnitWX), LegY);
+		VectorRegister4Float UX = VectorSelect(CutOffMask, VectorMultiply(CutOffScale, UnitWX), VectorSubtract(VectorMultiply(LegDot, LegX), RVX));
+		VectorRegister4Float UY = VectorSelect(CutOffMask, VectorMultiply(CutOffScale, UnitWY), VectorSubtract(VectorMultiply(LegDot, LegY), RVY));
+
+		DirX = VectorSelect(CollisionMask, UnitW2Y, DirX);
+		DirY = VectorSelect(CollisionMask, VectorNegate(UnitW2X), DirY);
+		UX = VectorSelect(CollisionMask, VectorMultiply(CollisionScale, UnitW2X), UX);
+		UY = VectorSelect(CollisionMask, VectorMultiply(CollisionScale, UnitW2Y), UY);
+
+		// Each agent takes half the responsibility for avoiding the collision.
+		VectorStoreAligned(VectorMultiplyAdd(Half, UX, VVelocityX), &PointX[n]);
+		VectorStoreAligned(VectorMultiplyAdd(Half, UY, VVelocityY), &PointY[n]);
+		VectorStoreAligned(DirX, &DirectionX[n]);
+		VectorStoreAligned(DirY, &DirectionY[n]);
+	}
+	//~
+
+	FOrcaLine Lines[MAX_NEIGHBORS];
+	for (int32 n = 0; n < NumNeighbors; ++n)
+	{
+		Lines[n] = FOrcaLine{FVector2f{PointX[n], PointY[n]}, FVector2f{DirectionX[n], DirectionY[n]}};
+	}
+
+	const TConstArrayView<FOrcaLine> LinesView{Lines, NumNeighbors};
+	const float MaxSpeed = UCharacterMovementProcessor::MAX_MOVE_SPEED;
+
+	FVector2f Result;
+	const int32 LineFail = LinearProgram2(LinesView, MaxSpeed, PreferredVelocity, false, Result);
+	if (LineFail < NumNeighbors)
+	{
+		LinearProgram3(LinesView, LineFail, MaxSpeed, Result);
+	}
+
+	return Result;
+}
+
+MASSTEST_DETERMINISTIC_FP_END
@@ -3,7 +3,16 @@
 
 #include "EnhancedInputComponent.h"
 #include "EntityCommon.h"
+#include "Lockstep/DeterministicMath.h"
+#include "Lockstep/LockstepSubsystem.h"
+#include "MovementEventSubsystem.h"
+#include "Scheduling/MassTimeSlicer.h"
+#include "Heightfield/HeightfieldSubsystem.h"
+#include "Representation/MassActorTableSubsystem.h"
+#include "Simulation/MassAsyncSimulationSubsystem.h"
+#include "TransformMirror/ActorTransformMirrorSubsystem.h"
 #include "MassProcessor.h"
+#include "Profiling/ProcessorGraphProfiler.h"
 #include "MassCommonFragments.h"
 #include "MassCommonTypes.h"
 #include "MassExecutionContext.h"
@@ -43,11 +52,14 @@ inline UInputVelocityProcessor::UInputVelocityProcessor()
 inline void UInputVelocityProcessor::ConfigureQueries()
 {
 	InputQuery.AddRequirement<FMovementInputFragment>(EMassFragmentAccess::ReadWrite);
+	InputQuery.AddRequirement<FFlowFieldGoalFragment>(EMassFragmentAccess::None, EMassFragmentPresence::None);
 	InputQuery.RegisterWithProcessor(*this);
 }
 
 inline void UInputVelocityProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
 {
+	MASSTEST_PROCESSOR_SPAN();
+
 	const ULocalPlayer* LocalPlayer = GetWorld()->GetFirstLocalPlayerFromController();
 	const APawn* Pawn = LIKELY(LocalPlayer) ? LocalPlayer->PlayerController->GetPawn() : nullptr;
 	if (UNLIKELY(!Pawn)) return;
@@ -78,22 +90,42 @@ class MASSTEST_API UCharacterMovementProcessor : public UMassProcessor
 public:
 	explicit UCharacterMovementProcessor();
 
+	static constexpr float MOVE_VELOCITY = 2500.f;
+	static constexpr float MAX_MOVE_SPEED = 900.f;
+	static constexpr float MAX_FALL_SPEED = 1500.f;
+	static constexpr float GROUND_FRICTION = 2000.f;
+	static constexpr uint8 MAX_SWEEP_BOUNCES = 5;
+	static constexpr float HEIGHTFIELD_SWEEP_LIFT = 20.f;
+	static constexpr float CONTACT_CACHE_LOCATION_TOLERANCE = 0.1f;
+	// Components thicker than this along the contact normal aren't assumed planar around the contact.
+	static constexpr float CONTACT_CACHE_MAX_PLANE_THICKNESS = 50.f;
+	// Hits slower than these into the surface aren't reported, so resting on the floor or sliding along a wall stays quiet.
+	static constexpr float MIN_LANDED_EVENT_SPEED = 200.f;
+	static constexpr float MIN_WALL_HIT_EVENT_SPEED = 100.f;
+	static constexpr float WALKABLE_FLOOR_Z = 0.71f;
+
 protected:
-	void PerformMovement(const FMassExecutionContext& Context, FTransform& InOutTransform, FVector3f& InOutVelocity, const float Radius, const float HalfHeight, const bool bDrawDebug = false) const;
+	using FSweepHitArray = TArray<FHitResult, TInlineAllocator<MAX_SWEEP_BOUNCES>>;
+
+	// Events of the move are appended to Events for Entity if given. MovementMode is updated with how the move ended if given, without it every move counts as starting to fall.
+	void PerformMovement(const float DeltaTime, FTransform& InOutTransform, FVector3f& InOutVelocity, const float Radius, const float HalfHeight, const UHeightfieldSubsystem* Heightfield, FContactCacheFragment* ContactCache, FMovementModeFragment* MovementMode, FMovementEventBuffer* Events, const FMassEntityHandle Entity, const bool bDrawDebug = false) const;
+
+	// Sweeps the capsule from InOutLocation towards ProjectedLocation, sliding along blocking hits. Blocking hits are appended to OutHits if given, and impacts to Events.
+	// Hitting walkable floor is only a Landed event when bFalling. Returns whether walkable floor was hit.
+	bool SweepAndSlide(const FQuat& Rotation, const FCollisionShape& CapsuleCollision, FVector& InOutLocation, FVector ProjectedLocation, FVector3f& InOutVelocity, const float Radius, const float HalfHeight, const bool bDrawDebug, FSweepHitArray* OutHits = nullptr, FMovementEventBuffer* Events = nullptr, const FMassEntityHandle Entity = {}, const bool bFalling = true) const;
+
+	// Caches the planes of Hits and validates that an inflated capsule at Location touches nothing but them. Invalidates the cache on failure.
+	void UpdateContactCache(FContactCacheFragment& ContactCache, const FQuat& Rotation, const float Radius, const float HalfHeight, const FVector& Location, const FSweepHitArray& Hits) const;
 	
 	//~ Begin UMassProcessor interface
 	virtual void ConfigureQueries() override;
 	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
 	//~ End UMassProcessor interface
 
-	static constexpr float MOVE_VELOCITY = 2500.f;
-	static constexpr float MAX_MOVE_SPEED = 900.f;
-	static constexpr float MAX_FALL_SPEED = 1500.f;
-	static constexpr float GROUND_FRICTION = 2000.f;
-	static constexpr uint8 MAX_SWEEP_BOUNCES = 5;
-
 private:
 	FMassEntityQuery GroundedCharacterQuery;
+
+	FMassTimeSlicer TimeSlicer{TEXT("UCharacterMovementProcessor")};
 };
 
 inline UCharacterMovementProcessor::UCharacterMovementProcessor()
@@ -110,6 +142,9 @@ inline void UCharacterMovementProcessor::ConfigureQueries()
 	GroundedCharacterQuery.AddRequirement<FVelocityFragment>(EMassFragmentAccess::ReadWrite);
 	GroundedCharacterQuery.AddRequirement<FCapsuleFragment>(EMassFragmentAccess::ReadOnly);
 	GroundedCharacterQuery.AddRequirement<FMovementInputFragment>(EMassFragmentAccess::ReadOnly);
+	GroundedCharacterQuery.AddRequirement<FContactCacheFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
+	GroundedCharacterQuery.AddRequirement<FMovementModeFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
+	GroundedCharacterQuery.AddRequirement<FTimeSlicedFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
 	GroundedCharacterQuery.AddTagRequirement<FCharacterMovementTag>(EMassFragmentPresence::All);
 	GroundedCharacterQuery.AddTagRequirement<FGroundedMovementTag>(EMassFragmentPresence::All);
 	GroundedCharacterQuery.AddTagRequirement<FGravityTag>(EMassFragmentPresence::Optional);
@@ -121,16 +156,44 @@ static TAutoConsoleVariable<bool> CVarMassTestDebugCMC{
 	false,
 	TEXT("")};
 
+static TAutoConsoleVariable<float> CVarMassTestContactCacheMargin{
+	TEXT("MassTest.ContactCacheMargin"),
+	15.f,
+	TEXT("Radius in cm of the region a character may move in without sweeping after its contacts were validated. 0 disables the contact cache.")};
+
+static TAutoConsoleVariable<float> CVarMassTestMovementBudgetMs{
+	TEXT("MassTest.TimeSlicing.MovementBudgetMs"),
+	0.f,
+	TEXT("Time in ms character movement may take per execution before the remaining chunks are left for the next one. 0 moves every character every frame. Ignored in lockstep mode.")};
+
+MASSTEST_DETERMINISTIC_FP_BEGIN
+
 inline void UCharacterMovementProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
 {
+	if (!UMassAsyncSimulationSubsystem::ShouldExecuteMovement(*this)) return;
+
 	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UCharacterMovementProcessor::Execute"), STAT_CharacterMovementProcessor, STATGROUP_MassTest);
+	MASSTEST_PROCESSOR_SPAN();
+
+	const UHeightfieldSubsystem* Heightfield = GetWorld()->GetSubsystem<UHeightfieldSubsystem>();
+
+	// Chunks are iterated on this thread only, one buffer covers the whole Execute.
+	UMovementEventSubsystem* MovementEvents = GetWorld()->GetSubsystem<UMovementEventSubsystem>();
+	FMovementEventBuffer* Events = MovementEvents ? MovementEvents->AcquireBuffer() : nullptr;
 
-	GroundedCharacterQuery.ForEachEntityChunk(EntityManager, Context, [&](FMassExecutionContext& Context) -> void
+	// Slicing depends on how long chunks took, which peers can't agree on.
+	const ULockstepSubsystem* Lockstep = GetWorld()->GetSubsystem<ULockstepSubsystem>();
+	const double BudgetSeconds = Lockstep && Lockstep->IsEnabled() ? 0.0 : CVarMassTestMovementBudgetMs.GetValueOnAnyThread() / 1000.0;
+
+	TimeSlicer.ForEachChunk(GroundedCharacterQuery, EntityManager, Context, BudgetSeconds, [&](FMassExecutionContext& Context) -> void
 	{
 		const TArrayView<FTransformFragment> Transforms = Context.GetMutableFragmentView<FTransformFragment>();
 		const TArrayView<FVelocityFragment> Velocities = Context.GetMutableFragmentView<FVelocityFragment>();
 		const TConstArrayView<FCapsuleFragment> Capsules = Context.GetFragmentView<FCapsuleFragment>();
 		const TConstArrayView<FMovementInputFragment> MovementInputs = Context.GetFragmentView<FMovementInputFragment>();
+		const TArrayView<FContactCacheFragment> ContactCaches = Context.GetMutableFragmentView<FContactCacheFragment>();
+		const TArrayView<FMovementModeFragment> MovementModes = Context.GetMutableFragmentView<FMovementModeFragment>();
+		const TArrayView<FTimeSlicedFragment> TimeSliced = Context.GetMutableFragmentView<FTimeSlicedFragment>();
 		const bool bApplyGravity = Context.DoesArchetypeHaveTag<FGravityTag>();
 
 		const float GravityZ = GetWorld()->GetGravityZ();
@@ -140,26 +203,25 @@ inline void UCharacterMovementProcessor::Execute(FMassEntityManager& EntityManag
 			FTransform& RESTRICT Transform = Transforms[i].GetMutableTransform();
 			FVector3f& RESTRICT Velocity = Velocities[i].Velocity;
 			const FCapsuleFragment& RESTRICT Capsule = Capsules[i];
+			const float DeltaTime = TimeSliced.IsEmpty() ? Context.GetDeltaTimeSeconds() : TimeSlicer.ConsumeDeltaTime(TimeSliced[i], Context.GetDeltaTimeSeconds());
 
 			//~ Apply gravity.
-			Velocity.Z += GravityZ * Context.GetDeltaTimeSeconds() * bApplyGravity;
+			Velocity.Z += GravityZ * DeltaTime * bApplyGravity;
 			//~
 
 			//~ Apply lateral damping
-			const FVector2D DampenedVelocity2D = FMath::Vector2DInterpConstantTo(FVector2D{Velocity.X, Velocity.Y}, FVector2D::ZeroVector, Context.GetDeltaTimeSeconds(), GROUND_FRICTION);
+			const FVector2D DampenedVelocity2D = FMath::Vector2DInterpConstantTo(FVector2D{Velocity.X, Velocity.Y}, FVector2D::ZeroVector, DeltaTime, GROUND_FRICTION);
 			Velocity.X = DampenedVelocity2D.X;
 			Velocity.Y = DampenedVelocity2D.Y;
 			//~
 
 			//~ Add movement input to velocity.
-			GEngine->AddOnScreenDebugMessage(-1, 0.f, FColor::Cyan, FString::Printf(TEXT("MovementInput == %s"), *MovementInputs[i].MovementInput.ToString()));
 			const FVector2f& RESTRICT MovementInput = MovementInputs[i].MovementInput;
 
-			FQuat YawRotation = Transform.GetRotation();
-			YawRotation = FQuat{0.0, 0.0, YawRotation.Z, YawRotation.W}.GetNormalized();
+			const FQuat YawRotation = UE::MassTest::Deterministic::GetYawRotation(Transform.GetRotation());
 			const FVector3f AddVelocity = (FVector3f)YawRotation.RotateVector(FVector{MovementInput.X, MovementInput.Y, 0.0}) * MOVE_VELOCITY;
 			
-			FVector3f NewVelocity = Velocity + AddVelocity * Context.GetDeltaTimeSeconds();
+			FVector3f NewVelocity = Velocity + AddVelocity * DeltaTime;
 
 			const FVector3f AddedVelocity = NewVelocity - Velocity;
 			Velocity = NewVelocity;
@@ -178,7 +240,7 @@ inline void UCharacterMovementProcessor::Execute(FMassEntityManager& EntityManag
 #if 0
 			//~ Perform movement.
 			uint8 NumSweepBounces = 0;
-			FVector ProjectedLocation = Transform.GetLocation() + Velocity * Context.GetDeltaTimeSeconds();
+			FVector ProjectedLocation = Transform.GetLocation() + Velocity * DeltaTime;
 
 			do
 			{
@@ -198,22 +260,18 @@ inline void UCharacterMovementProcessor::Execute(FMassEntityManager& EntityManag
 			Transform.SetLocation(ProjectedLocation);
 #endif
 
-#if UE_BUILD_DEVELOPMENT
-			FTransform TmpTransform = Transform;
-			FVector3f TmpVelocity = (FVector3f)Transform.GetUnitAxis(EAxis::X) * 50000.f;
-			PerformMovement(Context, TmpTransform, TmpVelocity, Capsule.Radius, Capsule.HalfHeight, true);
-#endif
-
-			PerformMovement(Context, Transform, Velocity, Capsule.Radius, Capsule.HalfHeight, false);
+			PerformMovement(DeltaTime, Transform, Velocity, Capsule.Radius, Capsule.HalfHeight, Heightfield, ContactCaches.IsEmpty() ? nullptr : &ContactCaches[i], MovementModes.IsEmpty() ? nullptr : &MovementModes[i], Events, Context.GetEntity(i), false);
 		}
 	});
 }
 
-inline void UCharacterMovementProcessor::PerformMovement(const FMassExecutionContext& Context, FTransform& InOutTransform, FVector3f& InOutVelocity, const float Radius, const float HalfHeight, const bool bDrawDebug) const
+inline void UCharacterMovementProcessor::PerformMovement(const float DeltaTime, FTransform& InOutTransform, FVector3f& InOutVelocity, const float Radius, const float HalfHeight, const UHeightfieldSubsystem* Heightfield, FContactCacheFragment* ContactCache, FMovementModeFragment* MovementMode, FMovementEventBuffer* Events, const FMassEntityHandle Entity, const bool bDrawDebug) const
 {
-	uint8 NumSweepBounces = 0;
+	// Walking over bumps and down steps hits the floor too, only a move starting off the floor can land.
+	const bool bWasFalling = !MovementMode || MovementMode->bFalling;
+
 	FVector CurrentLocation = InOutTransform.GetLocation();
-	FVector ProjectedLocation = InOutTransform.GetLocation() + InOutVelocity * Context.GetDeltaTimeSeconds();
+	const FVector ProjectedLocation = InOutTransform.GetLocation() + InOutVelocity * DeltaTime;
 	
 	const FCollisionShape CapsuleCollision = FCollisionShape::MakeCapsule(Radius, HalfHeight);
 
@@ -225,77 +283,243 @@ inline void UCharacterMovementProcessor::PerformMovement(const FMassExecutionCon
 	}
 #endif
 
-#if 0
-	const FVector3f VelocityDirection = InOutVelocity.GetSafeNormal();
-	do
+	//~ Reuse last frame's contact planes while the move stays inside the region validated free of anything else.
+	if (ContactCache && ContactCache->IsValid() && FVector::DistSquared(CurrentLocation, ContactCache->LastLocation) <= FMath::Square(CONTACT_CACHE_LOCATION_TOLERANCE))
 	{
-		FHitResult HitResult;
-		if (!GetWorld()->SweepSingleByChannel(HitResult, InOutTransform.GetLocation(), ProjectedLocation, InOutTransform.GetRotation(), ECC_WorldStatic, FCollisionShape::MakeCapsule(Radius, HalfHeight))) break;
-			
-		double TranslationProjection = (ProjectedLocation - HitResult.Location) | HitResult.Normal;
-		if (TranslationProjection >= 0.f) break;
+		FVector3f CachedVelocity = InOutVelocity;
+		for (uint8 i = 0; i < ContactCache->NumPlanes; ++i)
+		{
+			const FVector3f& Normal = ContactCache->PlaneNormals[i];
+			const float IntoPlane = CachedVelocity | Normal;
+			if (IntoPlane < 0.f) CachedVelocity -= Normal * IntoPlane;
+		}
 
-		#if 0
-		FVector NewProjectedLocation = ProjectedLocation - HitResult.Normal * (TranslationProjection - UE_DOUBLE_KINDA_SMALL_NUMBER);
-		for (uint8 i = 0; i < NumSweepBounces; ++i)
+		FVector CachedLocation = CurrentLocation + CachedVelocity * DeltaTime;
+		for (uint8 i = 0; i < ContactCache->NumPlanes; ++i)
 		{
-			
+			const FVector Normal{ContactCache->PlaneNormals[i]};
+			const double Penetration = (CachedLocation | Normal) - ContactCache->PlaneDistances[i];
+			if (Penetration < 0.0) CachedLocation -= Normal * Penetration;
 		}
-#endif
-		
-		FVector NewProjectedLocation = ProjectedLocation - HitResult.Normal * (TranslationProjection - UE_DOUBLE_KINDA_SMALL_NUMBER);
-		
 
+		if (FVector::DistSquared(CachedLocation, ContactCache->ValidatedLocation) <= FMath::Square(ContactCache->FreeRadius))
+		{
+			if (MovementMode)
+			{
+				bool bOnFloor = false;
+				for (uint8 i = 0; i < ContactCache->NumPlanes; ++i)
+				{
+					bOnFloor |= ContactCache->PlaneNormals[i].Z >= WALKABLE_FLOOR_Z;
+				}
+				MovementMode->bFalling = !bOnFloor;
+			}
 
-#if UE_BUILD_DEVELOPMENT
-		if (bDrawDebug)
+			InOutVelocity = CachedVelocity;
+			ContactCache->LastLocation = CachedLocation;
+			InOutTransform.SetLocation(CachedLocation);
+			return;
+		}
+	}
+	//~
+
+	//~ Resolve the vertical component against the baked heightfield when the move stays over simple walkable floor.
+	FHeightfieldFloor Floor;
+	if (Heightfield && Heightfield->QueryFloor(CurrentLocation, HalfHeight, Floor) && Heightfield->QueryFloor(ProjectedLocation, HalfHeight, Floor))
+	{
+		// Lift the lateral sweep so gentle slopes under the capsule don't register as blocking hits.
+		const FVector SweepLift{0.0, 0.0, HEIGHTFIELD_SWEEP_LIFT};
+		FVector3f LateralVelocity{InOutVelocity.X, InOutVelocity.Y, 0.f};
+		FVector LateralLocation = CurrentLocation + SweepLift;
+		SweepAndSlide(InOutTransform.GetRotation(), CapsuleCollision, LateralLocation, LateralLocation + LateralVelocity * DeltaTime, LateralVelocity, Radius, HalfHeight, bDrawDebug, nullptr, Events, Entity, bWasFalling);
+		LateralLocation -= SweepLift;
+
+		if (Heightfield->QueryFloor(LateralLocation, HalfHeight, Floor))
 		{
-			DrawDebugCapsule(GetWorld(), HitResult.Location, HalfHeight, Radius, InOutTransform.GetRotation(), FColor::Red, false, -1.f, 0, 1.f);
-			DrawDebugCapsule(GetWorld(), NewProjectedLocation, HalfHeight, Radius, InOutTransform.GetRotation(), FColor::Yellow, false, -1.f, 0, 1.f);
-			DrawDebugLine(GetWorld(), HitResult.Location, NewProjectedLocation, FColor::Yellow, false, -1.f, 0, 1.f);
+			// Height of the capsule center when its bottom hemisphere rests on the floor plane.
+			const double FloorZ = Floor.Height + (HalfHeight - Radius) + Radius / Floor.Normal.Z;
+
+			LateralLocation.Z = CurrentLocation.Z + InOutVelocity.Z * DeltaTime;
+			const bool bOnFloor = LateralLocation.Z <= FloorZ;
+			if (MovementMode) MovementMode->bFalling = !bOnFloor;
+			if (bOnFloor)
+			{
+				if (Events && bWasFalling && -InOutVelocity.Z >= MIN_LANDED_EVENT_SPEED)
+				{
+					Events->Add(FMovementEvent{Entity, Floor.Normal, -InOutVelocity.Z, EMovementEventType::Landed});
+				}
+
+				LateralLocation.Z = FloorZ;
+				InOutVelocity.Z = FMath::Max(InOutVelocity.Z, 0.f);
+			}
+
+			InOutVelocity.X = LateralVelocity.X;
+			InOutVelocity.Y = LateralVelocity.Y;
+			InOutTransform.SetLocation(LateralLocation);
+			if (ContactCache) ContactCache->Invalidate();
+			return;
 		}
-#endif
-		
-		ProjectedLocation = NewProjectedLocation;
+	}
+	//~
 
-		const float VelocityProjection = InOutVelocity | HitResult.Normal;
-		InOutVelocity -= HitResult.Normal * VelocityProjection;
-		
-		PlaneHits[NumSweepBounces][0] = HitResult.Location;
-		PlaneHits[NumSweepBounces][1] = HitResult.Normal;
-	} while (++NumSweepBounces < MAX_SWEEP_BOUNCES);
-#endif
+	FSweepHitArray Hits;
+	const bool bHitFloor = SweepAndSlide(InOutTransform.GetRotation(), CapsuleCollision, CurrentLocation, ProjectedLocation, InOutVelocity, Radius, HalfHeight, bDrawDebug, &Hits, Events, Entity, bWasFalling);
+	if (MovementMode) MovementMode->bFalling = !bHitFloor;
+
+	if (ContactCache)
+	{
+		UpdateContactCache(*ContactCache, InOutTransform.GetRotation(), Radius, HalfHeight, CurrentLocation, Hits);
+	}
+
+	InOutTransform.SetLocation(CurrentLocation);
+}
+
+inline bool UCharacterMovementProcessor::SweepAndSlide(const FQuat& Rotation, const FCollisionShape& CapsuleCollision, FVector& CurrentLocation, FVector ProjectedLocation, FVector3f& InOutVelocity, const float Radius, const float HalfHeight, const bool bDrawDebug, FSweepHitArray* OutHits, FMovementEventBuffer* Events, const FMassEntityHandle Entity, const bool bFalling) const
+{
+	uint8 NumSweepBounces = 0;
+	const float InitialSpeed = InOutVelocity.Size();
+	FVector3f LastHitNormal = FVector3f::ZeroVector;
+	bool bHitFloor = false;
 
 	do
 	{
 		FHitResult Hit;
-		if (!GetWorld()->SweepSingleByChannel(Hit, CurrentLocation, ProjectedLocation, InOutTransform.GetRotation(), ECC_WorldStatic, CapsuleCollision))
+		if (!GetWorld()->SweepSingleByChannel(Hit, CurrentLocation, ProjectedLocation, Rotation, ECC_WorldStatic, CapsuleCollision))
 		{
 			CurrentLocation = ProjectedLocation;
-			if (bDrawDebug) DrawDebugCapsule(GetWorld(), CurrentLocation, HalfHeight, Radius, InOutTransform.GetRotation(), FColor::Green);
-			GEngine->AddOnScreenDebugMessage(-1, 0.f, FColor::Green, FString::Printf(TEXT("Early outting at %i!"), NumSweepBounces));
+			if (bDrawDebug) DrawDebugCapsule(GetWorld(), CurrentLocation, HalfHeight, Radius, Rotation, FColor::Green);
 			break;
 		}
 
 		CurrentLocation = Hit.Location + Hit.Normal * UE_DOUBLE_KINDA_SMALL_NUMBER;
+		if (OutHits) OutHits->Add(Hit);
 
-		if ((InOutVelocity | Hit.Normal) < 0.f)
+		if (const float IntoSurface = InOutVelocity | Hit.Normal; IntoSurface < 0.f)
 		{
+			//~ Report the impact, from the velocity it had coming into the surface.
+			LastHitNormal = (FVector3f)Hit.Normal;
+			const bool bWalkable = Hit.Normal.Z >= WALKABLE_FLOOR_Z;
+			bHitFloor |= bWalkable;
+			if (Events && (bFalling || !bWalkable))
+			{
+				if (-IntoSurface >= (bWalkable ? MIN_LANDED_EVENT_SPEED : MIN_WALL_HIT_EVENT_SPEED))
+				{
+					Events->Add(FMovementEvent{Entity, LastHitNormal, -IntoSurface, bWalkable ? EMovementEventType::Landed : EMovementEventType::HitWall});
+				}
+			}
+			//~
+
 			InOutVelocity -= InOutVelocity.ProjectOnToNormal((FVector3f)Hit.Normal);
 			ProjectedLocation -= (ProjectedLocation - Hit.Location).ProjectOnToNormal(Hit.Normal) + Hit.Normal * UE_DOUBLE_KINDA_SMALL_NUMBER;
 		}
 		
 		if (bDrawDebug)
 		{
-			DrawDebugCapsule(GetWorld(), CurrentLocation, HalfHeight, Radius, InOutTransform.GetRotation(), FColor::Red, false, -1.f, 0, 1.f);
-			DrawDebugCapsule(GetWorld(), ProjectedLocation, HalfHeight, Radius, InOutTransform.GetRotation(), FColor::Orange, false, -1.f, 0, 1.f);
+			DrawDebugCapsule(GetWorld(), CurrentLocation, HalfHeight, Radius, Rotation, FColor::Red, false, -1.f, 0, 1.f);
+			DrawDebugCapsule(GetWorld(), ProjectedLocation, HalfHeight, Radius, Rotation, FColor::Orange, false, -1.f, 0, 1.f);
 			DrawDebugLine(GetWorld(), CurrentLocation, ProjectedLocation, FColor::Orange, false, -1.f, 0, 1.f);
 		}
 	} while (++NumSweepBounces < MAX_SWEEP_BOUNCES && !InOutVelocity.IsNearlyZero(0.1f));
 
-	InOutTransform.SetLocation(CurrentLocation);
+	// Hits took all of the velocity, typically wedged into a corner.
+	if (Events && !LastHitNormal.IsZero() && InOutVelocity.IsNearlyZero(0.1f) && InitialSpeed >= MIN_WALL_HIT_EVENT_SPEED)
+	{
+		Events->Add(FMovementEvent{Entity, LastHitNormal, InitialSpeed, EMovementEventType::Blocked});
+	}
+
+	return bHitFloor;
 }
 
+inline void UCharacterMovementProcessor::UpdateContactCache(FContactCacheFragment& ContactCache, const FQuat& Rotation, const float Radius, const float HalfHeight, const FVector& Location, const FSweepHitArray& Hits) const
+{
+	ContactCache.Invalidate();
+	ContactCache.LastLocation = Location;
+
+	const float Margin = CVarMassTestContactCacheMargin.GetValueOnAnyThread();
+	if (Margin <= 0.f) return;
+
+	FCollisionQueryParams QueryParams{SCENE_QUERY_STAT(ContactCacheValidate), false};
+	for (const FHitResult& Hit : Hits)
+	{
+		// Only slab-like components are modelled well by a single plane around the contact.
+		const UPrimitiveComponent* Component = Hit.GetComponent();
+		if (!Component) return;
+
+		const FVector Extent = Component->Bounds.BoxExtent;
+		if (FMath::Abs(Hit.Normal.X) * Extent.X + FMath::Abs(Hit.Normal.Y) * Extent.Y + FMath::Abs(Hit.Normal.Z) * Extent.Z > CONTACT_CACHE_MAX_PLANE_THICKNESS) return;
+
+		QueryParams.AddIgnoredComponent(Component);
+
+		const FVector3f Normal{Hit.Normal};
+		const double Distance = Hit.Location | Hit.Normal;
+
+		uint8 PlaneIndex = 0;
+		while (PlaneIndex < ContactCache.NumPlanes && (ContactCache.PlaneNormals[PlaneIndex] | Normal) < 0.99f) ++PlaneIndex;
+
+		if (PlaneIndex < ContactCache.NumPlanes)
+		{
+			ContactCache.PlaneDistances[PlaneIndex] = FMath::Max(ContactCache.PlaneDistances[PlaneIndex], Distance);
+		}
+		else if (ContactCache.NumPlanes < FContactCacheFragment::MAX_PLANES)
+		{
+			ContactCache.PlaneNormals[ContactCache.NumPlanes] = Normal;
+			ContactCache.PlaneDistances[ContactCache.NumPlanes] = Distance;
+			++ContactCache.NumPlanes;
+		}
+		else
+		{
+			ContactCache.NumPlanes = 0;
+			return;
+		}
+	}
+
+	// Any capsule whose center stays within Margin of Location is inside the inflated one, so it can only touch the cached planes.
+	if (GetWorld()->OverlapBlockingTestByChannel(Location, Rotation, ECC_WorldStatic, FCollisionShape::MakeCapsule(Radius + Margin, HalfHeight + Margin), QueryParams))
+	{
+		ContactCache.NumPlanes = 0;
+		return;
+	}
+
+	ContactCache.ValidatedLocation = Location;
+	ContactCache.FreeRadius = Margin;
+}
+
+MASSTEST_DETERMINISTIC_FP_END
+
+
+// Publishes the movement events recorded this frame as one stream, see UMovementEventSubsystem.
+UCLASS()
+class MASSTEST_API UMovementEventMergeProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	explicit UMovementEventMergeProcessor();
+
+protected:
+	//~ Begin UMassProcessor interface
+	virtual void ConfigureQueries() override {}
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	//~ End UMassProcessor interface
+};
+
+inline UMovementEventMergeProcessor::UMovementEventMergeProcessor()
+{
+	bRequiresGameThreadExecution = false;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::AllNetModes;
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::UpdateWorldFromMass;
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::Movement);
+}
+
+inline void UMovementEventMergeProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	MASSTEST_PROCESSOR_SPAN();
+
+	if (UMovementEventSubsystem* MovementEvents = GetWorld()->GetSubsystem<UMovementEventSubsystem>())
+	{
+		MovementEvents->MergeEvents();
+	}
+}
+
+
 
 UCLASS()
 class MASSTEST_API UCharacterToMassTranslatorProcessor : public UMassProcessor
@@ -325,7 +549,8 @@ inline UCharacterToMassTranslatorProcessor::UCharacterToMassTranslatorProcessor(
 inline void UCharacterToMassTranslatorProcessor::ConfigureQueries()
 {
 	CharacterQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
-	CharacterQuery.AddRequirement<FActorHandleFragment>(EMassFragmentAccess::ReadOnly);
+	CharacterQuery.AddRequirement<FTransformMirrorFragment>(EMassFragmentAccess::ReadOnly);
+	CharacterQuery.AddRequirement<FSimulationSnapshotFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
 	CharacterQuery.AddTagRequirement<FCharacterMovementTag>(EMassFragmentPresence::All);
 	CharacterQuery.RegisterWithProcessor(*this);
 }
@@ -333,15 +558,33 @@ inline void UCharacterToMassTranslatorProcessor::ConfigureQueries()
 inline void UCharacterToMassTranslatorProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
 {
 	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UCharacterToMassTranslatorProcessor::Execute"), STAT_CharacterToMassTranslator, STATGROUP_MassTest);
+	MASSTEST_PROCESSOR_SPAN();
+
+	const UActorTransformMirrorSubsystem* TransformMirror = GetWorld()->GetSubsystem<UActorTransformMirrorSubsystem>();
+	if (UNLIKELY(!TransformMirror)) return;
+
+	// Plain memory written by the game thread at the end of last frame, so this is safe from any worker.
+	const FActorTransformMirrorBuffer& Mirror = TransformMirror->GetFrontBuffer();
 
-	CharacterQuery.ForEachEntityChunk(EntityManager, Context, [this](FMassExecutionContext& Context) -> void
+	CharacterQuery.ForEachEntityChunk(EntityManager, Context, [&Mirror](FMassExecutionContext& Context) -> void
 	{
 		const TArrayView<FTransformFragment> Transforms = Context.GetMutableFragmentView<FTransformFragment>();
-		const TConstArrayView<FActorHandleFragment> Characters = Context.GetFragmentView<FActorHandleFragment>();
+		const TConstArrayView<FTransformMirrorFragment> MirrorSlots = Context.GetFragmentView<FTransformMirrorFragment>();
+		const TArrayView<FSimulationSnapshotFragment> Snapshots = Context.GetMutableFragmentView<FSimulationSnapshotFragment>();
 
 		for (int32 i = 0; i < Context.GetNumEntities(); ++i)
 		{
-			Transforms[i].GetMutableTransform() = Characters[i].Actor->GetActorTransform();
+			const int32 Slot = MirrorSlots[i].Slot;
+			if (Mirror.Dirty.IsValidIndex(Slot) && Mirror.Dirty[Slot])
+			{
+				Transforms[i].GetMutableTransform() = Mirror.Transforms[Slot];
+
+				// Teleport rather than blend from the last simulated transform.
+				if (!Snapshots.IsEmpty())
+				{
+					Snapshots[i].Reset(Mirror.Transforms[Slot]);
+				}
+			}
 		}
 	});
 }
@@ -362,6 +605,8 @@ protected:
 
 private:
 	FMassEntityQuery CharacterQuery;
+
+	TArray<AActor*> ResolvedActors;
 };
 
 inline UMassToCharacterTranslatorProcessor::UMassToCharacterTranslatorProcessor()
@@ -376,6 +621,8 @@ inline void UMassToCharacterTranslatorProcessor::ConfigureQueries()
 {
 	CharacterQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
 	CharacterQuery.AddRequirement<FActorHandleFragment>(EMassFragmentAccess::ReadOnly);
+	CharacterQuery.AddRequirement<FTransformMirrorFragment>(EMassFragmentAccess::ReadOnly);
+	CharacterQuery.AddRequirement<FSimulationSnapshotFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
 	CharacterQuery.AddTagRequirement<FCharacterMovementTag>(EMassFragmentPresence::All);
 	CharacterQuery.RegisterWithProcessor(*this);
 }
@@ -383,20 +630,42 @@ inline void UMassToCharacterTranslatorProcessor::ConfigureQueries()
 inline void UMassToCharacterTranslatorProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
 {
 	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UMassToCharacterTranslatorProcessor::Execute"), STAT_MassToCharacterTranslator, STATGROUP_MassTest);
+	MASSTEST_PROCESSOR_SPAN();
 	
-	CharacterQuery.ForEachEntityChunk(EntityManager, Context, [this](FMassExecutionContext& Context) -> void
+	UActorTransformMirrorSubsystem* TransformMirror = GetWorld()->GetSubsystem<UActorTransformMirrorSubsystem>();
+	const UMassActorTableSubsystem* ActorTable = GetWorld()->GetSubsystem<UMassActorTableSubsystem>();
+	if (UNLIKELY(!ActorTable)) return;
+
+	const UMassAsyncSimulationSubsystem* Simulation = GetWorld()->GetSubsystem<UMassAsyncSimulationSubsystem>();
+	const bool bInterpolate = Simulation && Simulation->IsEnabled();
+	const float InterpolationAlpha = bInterpolate ? Simulation->GetInterpolationAlpha() : 1.f;
+
+	CharacterQuery.ForEachEntityChunk(EntityManager, Context, [&](FMassExecutionContext& Context) -> void
 	{
 		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
-		const TConstArrayView<FActorHandleFragment> ActorHandles = Context.GetFragmentView<FActorHandleFragment>();
+		const TConstArrayView<FTransformMirrorFragment> MirrorSlots = Context.GetFragmentView<FTransformMirrorFragment>();
+		const TConstArrayView<FSimulationSnapshotFragment> Snapshots = Context.GetFragmentView<FSimulationSnapshotFragment>();
+		const bool bInterpolateChunk = bInterpolate && !Snapshots.IsEmpty();
+		ActorTable->ResolveBatch(Context.GetFragmentView<FActorHandleFragment>(), ResolvedActors);
 
 		for (int32 i = 0; i < Context.GetNumEntities(); ++i)
 		{
-			const FTransform& Transform = Transforms[i].GetTransform();
-			AActor* Actor = ActorHandles[i].Actor;
+			FTransform Transform = Transforms[i].GetTransform();
+			if (bInterpolateChunk)
+			{
+				Transform.Blend(Snapshots[i].Previous, Snapshots[i].Current, InterpolationAlpha);
+			}
+
+			AActor* Actor = ResolvedActors[i];
 			
-			if (!ensure(IsValid(ActorHandles[i].Actor))) continue;
+			if (!ensure(IsValid(Actor))) continue;
 
 			Actor->SetActorLocationAndRotation(Transform.GetLocation(), Transform.GetRotation(), false, nullptr, ETeleportType::TeleportPhysics);
+
+			if (TransformMirror && MirrorSlots[i].Slot != INDEX_NONE)
+			{
+				TransformMirror->NotifyWrittenByMass(MirrorSlots[i].Slot, Actor->GetActorTransform());
+			}
 		}
 	});
 }
@@ -5,6 +5,8 @@
 #include "MassCommonFragments.h"
 #include "MassEntityTemplateRegistry.h"
 #include "MassEntityTraitBase.h"
+#include "Lockstep/LockstepSubsystem.h"
+#include "Simulation/MassAsyncSimulationSubsystem.h"
 #include "CharacterMovementTrait.generated.h"
 
 UCLASS()
@@ -17,6 +19,9 @@ protected:
 
 	UPROPERTY(EditAnywhere)
 	float CapsuleRadius = 34.f;
+
+	UPROPERTY(EditAnywhere)
+	bool bAvoidOtherCharacters = false;
 	
 	virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const override;
 };
@@ -27,10 +32,30 @@ inline void UCharacterMovementTrait::BuildTemplate(FMassEntityTemplateBuildConte
 	BuildContext.AddFragment<FVelocityFragment>();
 	BuildContext.AddFragment<FMovementInputFragment>();
 	BuildContext.AddFragment<FActorHandleFragment>();
+	BuildContext.AddFragment<FTransformMirrorFragment>();
+	BuildContext.AddFragment<FVisualTickLODFragment>();
+	BuildContext.AddFragment<FContactCacheFragment>();
+	BuildContext.AddFragment<FMovementModeFragment>();
+	BuildContext.AddFragment<FTimeSlicedFragment>();
 	BuildContext.AddTag<FCharacterMovementTag>();
 	BuildContext.AddTag<FGravityTag>();
 	BuildContext.AddTag<FGroundedMovementTag>();
 
+	if (bAvoidOtherCharacters)
+	{
+		BuildContext.AddTag<FAvoidanceTag>();
+	}
+
+	if (const UMassAsyncSimulationSubsystem* Simulation = World.GetSubsystem<UMassAsyncSimulationSubsystem>(); Simulation && Simulation->IsEnabled())
+	{
+		BuildContext.AddFragment<FSimulationSnapshotFragment>();
+	}
+
+	if (const ULockstepSubsystem* Lockstep = World.GetSubsystem<ULockstepSubsystem>(); Lockstep && Lockstep->IsEnabled())
+	{
+		BuildContext.AddFragment<FLockstepIdFragment>();
+	}
+
 	FCapsuleFragment& CapsuleFragment = BuildContext.AddFragment_GetRef<FCapsuleFragment>();
 	CapsuleFragment.HalfHeight = CapsuleHalfHeight;
 	CapsuleFragment.Radius = CapsuleRadius;
@@ -0,0 +1,67 @@
+
+#pragma once
+
+#include "MassEntityTypes.h"
+#include "Compaction/MortonCompactionSubsystem.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MovementEventSubsystem.generated.h"
+
+enum class EMovementEventType : uint8
+{
+	// Hit walkable floor while falling.
+	Landed,
+	// Hit anything not walkable: walls, steep slopes, ceilings.
+	HitWall,
+	// Slid into a corner and lost all velocity this move.
+	Blocked,
+};
+
+struct FMovementEvent
+{
+	FMassEntityHandle Entity;
+	FVector3f Normal = FVector3f::ZeroVector;
+	// Speed into the surface for hits, speed lost for Blocked.
+	float ImpactSpeed = 0.f;
+	EMovementEventType Type = EMovementEventType::HitWall;
+};
+
+using FMovementEventBuffer = TArray<FMovementEvent>;
+
+/**
+ * Stream of movement impacts recorded by UCharacterMovementProcessor, for gameplay to iterate in bulk instead of redoing sweeps.
+ * Each movement Execute appends to its own buffer without locking, UMovementEventMergeProcessor concatenates them once per frame after movement.
+ */
+UCLASS()
+class MASSTEST_API UMovementEventSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	//~ Begin UWorldSubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	//~ End UWorldSubsystem interface
+
+	// Events merged by the last UMovementEventMergeProcessor run. Stable until it runs again.
+	FORCEINLINE TConstArrayView<FMovementEvent> GetEvents() const { return Events; }
+
+	//~ Begin UCharacterMovementProcessor interface
+	// Hands out a buffer nobody else writes to, valid until the next MergeEvents. Thread safe.
+	FMovementEventBuffer* AcquireBuffer();
+	//~ End UCharacterMovementProcessor interface
+
+	//~ Begin UMovementEventMergeProcessor interface
+	void MergeEvents();
+	//~ End UMovementEventMergeProcessor interface
+
+protected:
+	// Keeps merged and not yet merged events pointing at the data they were recorded for.
+	void OnEntitiesRemapped(const FMassEntityRemap& EntityRemap);
+
+	TArray<FMovementEvent> Events;
+
+	TArray<TUniquePtr<FMovementEventBuffer>> FreeBuffers;
+	TArray<TUniquePtr<FMovementEventBuffer>> FilledBuffers;
+	FCriticalSection BufferCriticalSection;
+
+	FDelegateHandle EntitiesRemappedHandle;
+};
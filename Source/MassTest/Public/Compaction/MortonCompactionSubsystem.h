@@ -0,0 +1,54 @@
+
+#pragma once
+
+#include "MassEntityQuery.h"
+#include "MassEntityTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MortonCompactionSubsystem.generated.h"
+
+// Old handle to the handle now holding its fragments. Entities missing from it kept their handle.
+using FMassEntityRemap = TMap<FMassEntityHandle, FMassEntityHandle>;
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnMassEntitiesRemapped, const FMassEntityRemap&);
+
+/**
+ * Periodically re-sorts character entities within their archetype by the Morton code of their location, so spatial neighbors share chunks and cache lines.
+ * Mass ties a handle to its slot, so sorting moves fragment data between the archetype's existing entities instead of moving entities.
+ * Whoever keeps entity handles across frames has to follow the data through OnEntitiesRemapped.
+ * One archetype is sorted per frame, before actors tick, every MassTest.Compaction.Interval seconds.
+ * Archetypes with shared or chunk fragments are skipped, their values are per chunk and can't follow the data.
+ */
+UCLASS()
+class MASSTEST_API UMortonCompactionSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	//~ Begin UWorldSubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	//~ End UWorldSubsystem interface
+
+	FORCEINLINE FOnMassEntitiesRemapped& OnEntitiesRemapped() { return EntitiesRemapped; }
+
+	static FORCEINLINE void Remap(const FMassEntityRemap& EntityRemap, FMassEntityHandle& InOutEntity)
+	{
+		if (const FMassEntityHandle* NewEntity = EntityRemap.Find(InOutEntity)) InOutEntity = *NewEntity;
+	}
+
+protected:
+	void OnPreActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+	// Gathers the archetypes to sort this pass.
+	void BeginPass();
+
+	// Sorts the entities of Archetype, returns whether any of them moved.
+	bool CompactArchetype(const FMassArchetypeHandle& Archetype, FMassEntityRemap& OutRemap);
+
+	FMassEntityQuery CharacterQuery;
+
+	TArray<FMassArchetypeHandle> PendingArchetypes;
+	double NextPassTime = 0.0;
+
+	FOnMassEntitiesRemapped EntitiesRemapped;
+	FDelegateHandle PreActorTickHandle;
+};
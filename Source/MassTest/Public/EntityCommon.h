@@ -35,13 +35,110 @@ struct MASSTEST_API FMovementInputFragment : public FMassFragment
 	FVector2f MovementInput = FVector2f::ZeroVector;
 };
 
+// Contacts from the last full movement resolve, reused while the character stays in the region validated free of anything else.
+USTRUCT()
+struct MASSTEST_API FContactCacheFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	static constexpr int32 MAX_PLANES = 4;
+
+	FORCEINLINE bool IsValid() const { return FreeRadius > 0.f; }
+	FORCEINLINE void Invalidate() { FreeRadius = 0.f; NumPlanes = 0; }
+
+	// Capsule center the free region was validated around, and where the last move ended.
+	FVector ValidatedLocation = FVector::ZeroVector;
+	FVector LastLocation = FVector::ZeroVector;
+	float FreeRadius = 0.f;
+
+	// The capsule center must stay on the positive side of these planes (Normal | Location >= Distance).
+	FVector3f PlaneNormals[MAX_PLANES];
+	double PlaneDistances[MAX_PLANES];
+	uint8 NumPlanes = 0;
+};
+
+// Whether the character's last move ended off walkable floor. Landed events are only reported for moves that start falling.
+USTRUCT()
+struct MASSTEST_API FMovementModeFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	bool bFalling = true;
+};
+
+// World space goal an AI entity walks towards through UFlowFieldSubsystem.
+USTRUCT()
+struct MASSTEST_API FFlowFieldGoalFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	FVector Goal = FVector::ZeroVector;
+};
+
+// Index and generation into UMassActorTableSubsystem, which holds the only GC visible reference to the actor.
+struct FMassActorHandle
+{
+	FORCEINLINE bool IsSet() const { return Generation != 0; }
+	FORCEINLINE bool operator==(const FMassActorHandle& Other) const { return Index == Other.Index && Generation == Other.Generation; }
+
+	uint32 Index = 0;
+	uint32 Generation = 0;
+};
+
 USTRUCT()
 struct MASSTEST_API FActorHandleFragment : public FMassFragment
 {
 	GENERATED_BODY()
 
-	UPROPERTY()
-	AActor* Actor = nullptr;
+	FMassActorHandle Handle;
+};
+
+// Visual LOD last applied to the entity's actor by UMassActorVisualTickProcessor.
+USTRUCT()
+struct MASSTEST_API FVisualTickLODFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	int32 LOD = INDEX_NONE;
+};
+
+// Slot of the entity's actor in UActorTransformMirrorSubsystem.
+USTRUCT()
+struct MASSTEST_API FTransformMirrorFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	int32 Slot = INDEX_NONE;
+};
+
+// Transforms published by the last two async simulation steps, interpolated by the game thread when updating actors.
+USTRUCT()
+struct MASSTEST_API FSimulationSnapshotFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	FORCEINLINE void Reset(const FTransform& Transform) { Previous = Transform; Current = Transform; }
+
+	FTransform Previous = FTransform::Identity;
+	FTransform Current = FTransform::Identity;
+};
+
+// Stable identity shared by lockstep peers, handed out in entity creation order. Zero until ULockstepIdInitializer ran.
+USTRUCT()
+struct MASSTEST_API FLockstepIdFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	uint32 Id = 0;
+};
+
+// Clock time of the FMassTimeSlicer running over the entity when it was last processed, negative before the first time.
+USTRUCT()
+struct MASSTEST_API FTimeSlicedFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	double LastProcessedTime = -1.0;
 };
 
 USTRUCT()
@@ -62,6 +159,13 @@ struct MASSTEST_API FGravityTag : public FMassTag
 	GENERATED_BODY()
 };
 
+// Character steers around other characters through UAvoidanceProcessor. Characters without it are still avoided.
+USTRUCT()
+struct MASSTEST_API FAvoidanceTag : public FMassTag
+{
+	GENERATED_BODY()
+};
+
 namespace UE::Mass::ProcessorGroupNames
 {
 	inline const FName ProcessInput{TEXT("ProcessInput")};
@@ -0,0 +1,129 @@
+
+#pragma once
+
+#include "EntityCommon.h"
+#include "FlowFieldSubsystem.h"
+#include "Lockstep/DeterministicMath.h"
+#include "Lockstep/LockstepSubsystem.h"
+#include "MassProcessor.h"
+#include "Profiling/ProcessorGraphProfiler.h"
+#include "MassCommonFragments.h"
+#include "MassCommonTypes.h"
+#include "MassEntityTemplateRegistry.h"
+#include "MassEntityTraitBase.h"
+#include "MassExecutionContext.h"
+#include "FlowFieldProcessor.generated.h"
+
+UCLASS()
+class MASSTEST_API UFlowFieldAgentTrait : public UMassEntityTraitBase
+{
+	GENERATED_BODY()
+protected:
+	UPROPERTY(EditAnywhere)
+	FVector Goal = FVector::ZeroVector;
+
+	virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const override;
+};
+
+inline void UFlowFieldAgentTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const
+{
+	BuildContext.RequireFragment<FMovementInputFragment>();
+	BuildContext.RequireFragment<FTransformFragment>();
+	BuildContext.AddFragment_GetRef<FFlowFieldGoalFragment>().Goal = Goal;
+}
+
+
+
+UCLASS()
+class MASSTEST_API UFlowFieldMovementProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	explicit UFlowFieldMovementProcessor();
+
+protected:
+	//~ Begin UMassProcessor interface
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	//~ End UMassProcessor interface
+
+	static constexpr float ACCEPTANCE_RADIUS = 50.f;
+
+private:
+	FMassEntityQuery AgentQuery;
+};
+
+inline UFlowFieldMovementProcessor::UFlowFieldMovementProcessor()
+{
+	// Fields are created and their expansion tasks are joined/kicked from the game thread.
+	bRequiresGameThreadExecution = true;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::AllNetModes;
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::ProcessInput;
+}
+
+inline void UFlowFieldMovementProcessor::ConfigureQueries()
+{
+	AgentQuery.AddRequirement<FMovementInputFragment>(EMassFragmentAccess::ReadWrite);
+	AgentQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	AgentQuery.AddRequirement<FFlowFieldGoalFragment>(EMassFragmentAccess::ReadOnly);
+	AgentQuery.RegisterWithProcessor(*this);
+}
+
+MASSTEST_DETERMINISTIC_FP_BEGIN
+
+inline void UFlowFieldMovementProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UFlowFieldMovementProcessor::Execute"), STAT_FlowFieldMovementProcessor, STATGROUP_MassTest);
+	MASSTEST_PROCESSOR_SPAN();
+
+	UFlowFieldSubsystem* FlowFields = GetWorld()->GetSubsystem<UFlowFieldSubsystem>();
+	if (UNLIKELY(!FlowFields)) return;
+
+	if (const ULockstepSubsystem* Lockstep = GetWorld()->GetSubsystem<ULockstepSubsystem>(); Lockstep && Lockstep->IsEnabled())
+	{
+		FlowFields->WaitForGrid();
+	}
+
+	FlowFields->WaitForPendingWork();
+
+	AgentQuery.ForEachEntityChunk(EntityManager, Context, [FlowFields](FMassExecutionContext& Context) -> void
+	{
+		const TArrayView<FMovementInputFragment> MovementInputs = Context.GetMutableFragmentView<FMovementInputFragment>();
+		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
+		const TConstArrayView<FFlowFieldGoalFragment> Goals = Context.GetFragmentView<FFlowFieldGoalFragment>();
+
+		// Entities sharing a goal are usually spawned together, so consecutive lookups mostly hit the same field.
+		const FFlowField* Field = nullptr;
+		FVector FieldGoal = FVector{TNumericLimits<double>::Max()};
+
+		for (int32 i = 0; i < Context.GetNumEntities(); ++i)
+		{
+			const FTransform& Transform = Transforms[i].GetTransform();
+			const FVector& Goal = Goals[i].Goal;
+			FVector2f& MovementInput = MovementInputs[i].MovementInput;
+
+			if (Goal != FieldGoal)
+			{
+				Field = FlowFields->FindOrAddField(Goal);
+				FieldGoal = Goal;
+			}
+
+			FVector2f Direction;
+			if (!Field || FVector::DistSquared2D(Transform.GetLocation(), Goal) <= FMath::Square(ACCEPTANCE_RADIUS) || !FlowFields->SampleDirection(*Field, Transform.GetLocation(), Direction))
+			{
+				MovementInput = FVector2f::ZeroVector;
+				continue;
+			}
+
+			//~ UCharacterMovementProcessor rotates movement input by the entity's yaw, so undo it here.
+			const FQuat YawRotation = UE::MassTest::Deterministic::GetYawRotation(Transform.GetRotation());
+			const FVector LocalDirection = YawRotation.UnrotateVector(FVector{Direction.X, Direction.Y, 0.f});
+			MovementInput = FVector2f{(float)LocalDirection.X, (float)LocalDirection.Y};
+			//~
+		}
+	});
+
+	FlowFields->KickPendingWork();
+}
+
+MASSTEST_DETERMINISTIC_FP_END
@@ -0,0 +1,93 @@
+
+#pragma once
+
+#include "Subsystems/WorldSubsystem.h"
+#include "Tasks/Task.h"
+#include "FlowFieldSubsystem.generated.h"
+
+// Walkable floor sampled on a regular XY grid. Built once on worker threads and immutable afterwards.
+struct MASSTEST_API FFlowFieldGrid
+{
+	FVector2D Origin = FVector2D::ZeroVector;
+	float CellSize = 100.f;
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+
+	TArray<float> FloorHeights;
+	TBitArray<> Walkable;
+
+	FORCEINLINE int32 Num() const { return SizeX * SizeY; }
+	FORCEINLINE bool IsValidCell(const FIntPoint& Cell) const { return Cell.X >= 0 && Cell.Y >= 0 && Cell.X < SizeX && Cell.Y < SizeY; }
+	FORCEINLINE int32 GetCellIndex(const FIntPoint& Cell) const { return Cell.Y * SizeX + Cell.X; }
+	FORCEINLINE FIntPoint GetCell(const FVector& Location) const
+	{
+		return FIntPoint{FMath::FloorToInt32((Location.X - Origin.X) / CellSize), FMath::FloorToInt32((Location.Y - Origin.Y) / CellSize)};
+	}
+	FORCEINLINE FVector2D GetCellCenter(const FIntPoint& Cell) const { return Origin + FVector2D{Cell.X + 0.5, Cell.Y + 0.5} * CellSize; }
+};
+
+// Integration field towards a single goal cell. Expanded incrementally (Dijkstra) so cells close to the goal become usable first.
+struct MASSTEST_API FFlowField
+{
+	static constexpr uint8 INVALID_DIRECTION = 0xFF;
+
+	// Offsets of the 8 neighbours, indexed by direction.
+	static const FIntPoint DirectionOffsets[8];
+	static const FVector2f DirectionVectors[8];
+
+	FIntPoint GoalCell = FIntPoint::NoneValue;
+	// Centre of GoalCell on its floor. Fields are shared by every goal within the cell, so none of them is steered to in particular.
+	FVector GoalLocation = FVector::ZeroVector;
+
+	TArray<float> Costs;
+	TArray<uint8> Directions;
+
+	// Open set of the incremental expansion. Empty once the field is complete.
+	TArray<TPair<float, int32>> OpenSet;
+
+	double LastUsedTime = 0.0;
+
+	FORCEINLINE bool IsComplete() const { return OpenSet.IsEmpty(); }
+};
+
+UCLASS()
+class MASSTEST_API UFlowFieldSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	//~ Begin UWorldSubsystem interface
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+	//~ End UWorldSubsystem interface
+
+	// Kicks an async grid build covering Bounds. Any cached fields are discarded.
+	void BuildGrid(const FBox& Bounds);
+
+	FORCEINLINE bool IsGridReady() const { return bGridReady; }
+
+	// Blocks until the grid build kicked by BuildGrid is done. Lockstep peers use this so the first frame fields exist on doesn't depend on thread timing.
+	FORCEINLINE void WaitForGrid() { GridTask.Wait(); }
+	FORCEINLINE const FFlowFieldGrid& GetGrid() const { return Grid; }
+
+	// Returns the (possibly still expanding) field for the cell of the goal, creating it if needed. Game thread only, outside of WaitForPendingWork/KickPendingWork.
+	const FFlowField* FindOrAddField(const FVector& GoalLocation);
+
+	// Writes the normalized movement direction at Location into OutDirection. Returns false if the cell hasn't been reached by the field yet.
+	bool SampleDirection(const FFlowField& Field, const FVector& Location, FVector2f& OutDirection) const;
+
+	// Joins the incremental expansion tasks kicked last frame. Must be called before fields are read.
+	void WaitForPendingWork();
+
+	// Launches one expansion slice per incomplete field and evicts fields that haven't been used in a while.
+	void KickPendingWork();
+
+protected:
+	static void ExpandField(const FFlowFieldGrid& Grid, FFlowField& Field, int32 MaxExpansions);
+
+	FFlowFieldGrid Grid;
+	TMap<FIntPoint, TUniquePtr<FFlowField>> Fields;
+
+	TArray<UE::Tasks::FTask> PendingTasks;
+	UE::Tasks::FTask GridTask;
+	std::atomic<bool> bGridReady = false;
+};
@@ -0,0 +1,115 @@
+
+#pragma once
+
+#include "Subsystems/WorldSubsystem.h"
+#include "Tasks/Task.h"
+#include "HeightfieldSubsystem.generated.h"
+
+// Per cell flags of a baked heightfield tile.
+enum class EHeightfieldCellFlags : uint8
+{
+	None = 0,
+	// A floor was found under the cell center.
+	HasFloor = 1 << 0,
+	// The floor is flat enough to stand on.
+	Walkable = 1 << 1,
+	// Room for a character between two surfaces of the column (bridges, ceilings, overhangs). Queries must fall back to sweeps.
+	Overhang = 1 << 2,
+};
+ENUM_CLASS_FLAGS(EHeightfieldCellFlags);
+
+// Square tile of TILE_CELLS^2 floor samples, stored SoA so batched lookups stay in a couple of cache lines per array.
+struct MASSTEST_API FHeightfieldTile
+{
+	static constexpr int32 TILE_CELLS = 64;
+
+	FIntPoint Coord = FIntPoint::ZeroValue;
+
+	// Floor height at the cell center and the XY part of the floor normal (Z is reconstructed).
+	TArray<float> Heights;
+	TArray<float> NormalsX;
+	TArray<float> NormalsY;
+	TArray<EHeightfieldCellFlags> Flags;
+
+	// Number of loaded levels whose bounds overlap this tile.
+	int32 NumOwningLevels = 0;
+
+	// Order in which the bake that produced this tile was requested, 0 until one is published.
+	uint32 BakeGeneration = 0;
+};
+
+struct FHeightfieldFloor
+{
+	float Height = 0.f;
+	FVector3f Normal = FVector3f::UpVector;
+};
+
+UCLASS()
+class MASSTEST_API UHeightfieldSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	//~ Begin UWorldSubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	//~ End UWorldSubsystem interface
+
+	// Floors higher than this above the bottom of the capsule are something the character is under, not standing on.
+	static constexpr float MAX_STEP_HEIGHT = 45.f;
+
+	// O(1) floor lookup below a capsule centered on Location. Returns false when there's no baked tile, the cell is steep, empty or has more
+	// than one surface, or its floor is more than a step above the capsule bottom, in which case the caller must resolve against real geometry.
+	// Safe to call from any thread while Mass processes.
+	FORCEINLINE bool QueryFloor(const FVector& Location, const float HalfHeight, FHeightfieldFloor& OutFloor) const
+	{
+		const int32 CellX = FMath::FloorToInt32(Location.X * InvCellSize);
+		const int32 CellY = FMath::FloorToInt32(Location.Y * InvCellSize);
+		const FIntPoint TileCoord{FMath::DivideAndRoundDown(CellX, FHeightfieldTile::TILE_CELLS), FMath::DivideAndRoundDown(CellY, FHeightfieldTile::TILE_CELLS)};
+
+		const TUniquePtr<FHeightfieldTile>* Tile = Tiles.Find(TileCoord);
+		if (!Tile) return false;
+
+		const int32 Index = (CellY - TileCoord.Y * FHeightfieldTile::TILE_CELLS) * FHeightfieldTile::TILE_CELLS + (CellX - TileCoord.X * FHeightfieldTile::TILE_CELLS);
+		if (((*Tile)->Flags[Index] & (EHeightfieldCellFlags::Walkable | EHeightfieldCellFlags::Overhang)) != EHeightfieldCellFlags::Walkable) return false;
+
+		const float NX = (*Tile)->NormalsX[Index];
+		const float NY = (*Tile)->NormalsY[Index];
+		const float NZ = FMath::Sqrt(FMath::Max(1.f - NX * NX - NY * NY, UE_KINDA_SMALL_NUMBER));
+
+		// Extrapolate along the cell's floor plane from its center.
+		const float OffsetX = (float)(Location.X - (CellX + 0.5) * CellSize);
+		const float OffsetY = (float)(Location.Y - (CellY + 0.5) * CellSize);
+		const float Height = (*Tile)->Heights[Index] - (OffsetX * NX + OffsetY * NY) / NZ;
+		if (Height > Location.Z - HalfHeight + MAX_STEP_HEIGHT) return false;
+
+		OutFloor.Height = Height;
+		OutFloor.Normal = FVector3f{NX, NY, NZ};
+		return true;
+	}
+
+	FORCEINLINE float GetCellSize() const { return CellSize; }
+
+protected:
+	void OnLevelAdded(ULevel* Level, UWorld* World);
+	void OnLevelRemoved(ULevel* Level, UWorld* World);
+	void OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+	void AddLevelTiles(ULevel* Level);
+	void RequestBake(const FIntPoint& TileCoord);
+	static void BakeTile(const UWorld* World, float CellSize, FHeightfieldTile& Tile);
+
+	TMap<FIntPoint, TUniquePtr<FHeightfieldTile>> Tiles;
+	TMap<TObjectKey<ULevel>, TArray<FIntPoint>> LevelTiles;
+
+	// Tiles being baked on worker threads. Published into Tiles on the game thread once complete, between Mass frames.
+	TArray<TPair<UE::Tasks::FTask, TUniquePtr<FHeightfieldTile>>> PendingBakes;
+	uint32 LastBakeGeneration = 0;
+
+	float CellSize = 50.f;
+	float InvCellSize = 1.f / 50.f;
+
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+	FDelegateHandle PostActorTickHandle;
+};
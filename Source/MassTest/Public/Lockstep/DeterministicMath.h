@@ -0,0 +1,40 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Wraps simulation kernels that must produce the same bits on every lockstep peer: no FMA contraction and no fast-math reassociation.
+// This is a compile time setting, so the wrapped kernels lose FMA and reassociation outside of lockstep mode as well.
+#if defined(__clang__)
+	#define MASSTEST_DETERMINISTIC_FP_BEGIN _Pragma("float_control(precise, on, push)") _Pragma("clang fp contract(off)")
+	#define MASSTEST_DETERMINISTIC_FP_END _Pragma("float_control(pop)")
+#elif defined(_MSC_VER)
+	#define MASSTEST_DETERMINISTIC_FP_BEGIN __pragma(float_control(precise, on, push)) __pragma(fp_contract(off))
+	#define MASSTEST_DETERMINISTIC_FP_END __pragma(float_control(pop))
+#else
+	#define MASSTEST_DETERMINISTIC_FP_BEGIN
+	#define MASSTEST_DETERMINISTIC_FP_END
+#endif
+
+/**
+ * Replacements for engine helpers normalizing through FMath::InvSqrt, whose SSE path refines a reciprocal square root estimate.
+ * The estimate differs between CPU vendors, a correctly rounded sqrt and divide doesn't.
+ */
+namespace UE::MassTest::Deterministic
+{
+	// Yaw only part of Rotation, what movement input is relative to.
+	FORCEINLINE FQuat GetYawRotation(const FQuat& Rotation)
+	{
+		const double Size = FMath::Sqrt(Rotation.Z * Rotation.Z + Rotation.W * Rotation.W);
+		return Size > UE_DOUBLE_SMALL_NUMBER ? FQuat{0.0, 0.0, Rotation.Z / Size, Rotation.W / Size} : FQuat::Identity;
+	}
+
+	FORCEINLINE FVector2f GetSafeNormal(const FVector2f& Vector)
+	{
+		const float SizeSquared = Vector.X * Vector.X + Vector.Y * Vector.Y;
+		if (SizeSquared <= UE_SMALL_NUMBER) return FVector2f::ZeroVector;
+
+		const float Size = FMath::Sqrt(SizeSquared);
+		return FVector2f{Vector.X / Size, Vector.Y / Size};
+	}
+}
@@ -0,0 +1,22 @@
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "LockstepHarnessCommandlet.generated.h"
+
+/**
+ * Desync check for lockstep mode. Runs the same map in two local game processes with -Lockstep, then compares their per-frame hashes.
+ * Usage: -run=MassLockstepHarness -Map=/Game/Maps/Test -Frames=600 [-ExtraArgs="..."]
+ * Returns 0 when every frame matched, 1 and the first mismatching frame otherwise.
+ */
+UCLASS()
+class MASSTEST_API UMassLockstepHarnessCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	explicit UMassLockstepHarnessCommandlet();
+
+	//~ Begin UCommandlet interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet interface
+};
@@ -0,0 +1,148 @@
+
+#pragma once
+
+#include "EntityCommon.h"
+#include "LockstepSubsystem.h"
+#include "MassObserverProcessor.h"
+#include "MassProcessor.h"
+#include "Profiling/ProcessorGraphProfiler.h"
+#include "MassCommonFragments.h"
+#include "MassCommonTypes.h"
+#include "MassExecutionContext.h"
+#include "Hash/xxhash.h"
+#include "LockstepProcessor.generated.h"
+
+// Hands out lockstep ids as entities are created. Creation order is the same on every peer, chunk layout may not be.
+// Entities created with an id already, e.g. restored ones, keep it.
+UCLASS()
+class MASSTEST_API ULockstepIdInitializer : public UMassObserverProcessor
+{
+	GENERATED_BODY()
+public:
+	explicit ULockstepIdInitializer();
+
+protected:
+	//~ Begin UMassProcessor interface
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	//~ End UMassProcessor interface
+
+private:
+	FMassEntityQuery IdQuery;
+};
+
+inline ULockstepIdInitializer::ULockstepIdInitializer()
+{
+	ObservedType = FLockstepIdFragment::StaticStruct();
+	Operation = EMassObservedOperation::Add;
+	bRequiresGameThreadExecution = true;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::AllNetModes;
+}
+
+inline void ULockstepIdInitializer::ConfigureQueries()
+{
+	IdQuery.AddRequirement<FLockstepIdFragment>(EMassFragmentAccess::ReadWrite);
+	IdQuery.RegisterWithProcessor(*this);
+}
+
+inline void ULockstepIdInitializer::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	ULockstepSubsystem* Lockstep = GetWorld()->GetSubsystem<ULockstepSubsystem>();
+	if (UNLIKELY(!Lockstep)) return;
+
+	IdQuery.ForEachEntityChunk(EntityManager, Context, [Lockstep](FMassExecutionContext& Context) -> void
+	{
+		const TArrayView<FLockstepIdFragment> Ids = Context.GetMutableFragmentView<FLockstepIdFragment>();
+		for (int32 i = 0; i < Context.GetNumEntities(); ++i)
+		{
+			if (Ids[i].Id == 0)
+			{
+				Ids[i].Id = Lockstep->AllocateId();
+			}
+		}
+	});
+}
+
+
+
+// Hashes the movement state of every lockstep entity once movement is done, in id order so chunk layout doesn't matter.
+UCLASS()
+class MASSTEST_API ULockstepHashProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	explicit ULockstepHashProcessor();
+
+protected:
+	//~ Begin UMassProcessor interface
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	//~ End UMassProcessor interface
+
+	// Hashed as raw bytes, laid out without padding.
+	struct FHashRecord
+	{
+		double Location[3];
+		double Rotation[4];
+		float Velocity[3];
+		uint32 Id;
+	};
+	static_assert(sizeof(FHashRecord) == 3 * sizeof(double) + 4 * sizeof(double) + 3 * sizeof(float) + sizeof(uint32));
+
+private:
+	FMassEntityQuery HashQuery;
+
+	TArray<FHashRecord> Records;
+};
+
+inline ULockstepHashProcessor::ULockstepHashProcessor()
+{
+	bRequiresGameThreadExecution = false;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::AllNetModes;
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::UpdateWorldFromMass;
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::Movement);
+}
+
+inline void ULockstepHashProcessor::ConfigureQueries()
+{
+	HashQuery.AddRequirement<FLockstepIdFragment>(EMassFragmentAccess::ReadOnly);
+	HashQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	HashQuery.AddRequirement<FVelocityFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	HashQuery.RegisterWithProcessor(*this);
+}
+
+inline void ULockstepHashProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	ULockstepSubsystem* Lockstep = GetWorld()->GetSubsystem<ULockstepSubsystem>();
+	if (!Lockstep || !Lockstep->IsEnabled()) return;
+
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("ULockstepHashProcessor::Execute"), STAT_LockstepHashProcessor, STATGROUP_MassTest);
+	MASSTEST_PROCESSOR_SPAN();
+
+	Records.Reset(HashQuery.GetNumMatchingEntities(EntityManager));
+
+	HashQuery.ForEachEntityChunk(EntityManager, Context, [this](FMassExecutionContext& Context) -> void
+	{
+		const TConstArrayView<FLockstepIdFragment> Ids = Context.GetFragmentView<FLockstepIdFragment>();
+		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
+		const TConstArrayView<FVelocityFragment> Velocities = Context.GetFragmentView<FVelocityFragment>();
+
+		for (int32 i = 0; i < Context.GetNumEntities(); ++i)
+		{
+			const FTransform& Transform = Transforms[i].GetTransform();
+			const FVector Location = Transform.GetLocation();
+			const FQuat Rotation = Transform.GetRotation();
+			const FVector3f Velocity = Velocities.IsEmpty() ? FVector3f::ZeroVector : Velocities[i].Velocity;
+
+			Records.Add(FHashRecord{
+				{Location.X, Location.Y, Location.Z},
+				{Rotation.X, Rotation.Y, Rotation.Z, Rotation.W},
+				{Velocity.X, Velocity.Y, Velocity.Z},
+				Ids[i].Id});
+		}
+	});
+
+	Records.Sort([](const FHashRecord& A, const FHashRecord& B) -> bool { return A.Id < B.Id; });
+
+	Lockstep->RecordFrameHash(FXxHash64::HashBuffer(Records.GetData(), Records.Num() * sizeof(FHashRecord)).Hash);
+}
@@ -0,0 +1,51 @@
+
+#pragma once
+
+#include "Subsystems/WorldSubsystem.h"
+#include "LockstepSubsystem.generated.h"
+
+/**
+ * Deterministic lockstep mode, enabled with MassTest.Lockstep or -Lockstep on the command line.
+ * Forces a fixed timestep, gives simulated entities a stable FLockstepIdFragment and records a hash of the movement state every frame.
+ * Peers that replay the same inputs must produce the same hashes, the first mismatching frame is where they desynced.
+ * -LockstepFrames=N quits after N frames and -LockstepHashLog=Path writes one "Frame Hash" line per frame on exit, see UMassLockstepHarnessCommandlet.
+ */
+UCLASS()
+class MASSTEST_API ULockstepSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	//~ Begin UWorldSubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	//~ End UWorldSubsystem interface
+
+	FORCEINLINE bool IsEnabled() const { return bEnabled; }
+
+	// Game thread only.
+	FORCEINLINE uint32 AllocateId() { return ++LastId; }
+
+	// Called once per frame by ULockstepHashProcessor, after movement.
+	FORCEINLINE void RecordFrameHash(const uint64 Hash) { PendingHash = Hash; }
+
+	FORCEINLINE int32 GetFrame() const { return FrameHashes.Num(); }
+	FORCEINLINE TConstArrayView<uint64> GetFrameHashes() const { return FrameHashes; }
+
+protected:
+	void OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void WriteHashLog() const;
+
+	TArray<uint64> FrameHashes;
+	uint64 PendingHash = 0;
+	uint32 LastId = 0;
+
+	FString HashLogPath;
+	int32 MaxFrames = 0;
+	bool bEnabled = false;
+
+	// Engine time step settings in place before lockstep forced its own.
+	bool bPreviousUseFixedTimeStep = false;
+	double PreviousFixedDeltaTime = 0.0;
+
+	FDelegateHandle PostActorTickHandle;
+};
@@ -3,9 +3,13 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "Compaction/MortonCompactionSubsystem.h"
 #include "GameFramework/Character.h"
 #include "MassCharacter.generated.h"
 
+class UMassEntityConfigAsset;
+
 UCLASS()
 class MASSTEST_API AMassCharacter : public ACharacter
 {
@@ -15,14 +19,30 @@ public:
 	// Sets default values for this character's properties
 	AMassCharacter();
 
+	// Sets how often the skeletal mesh ticks. Called by UMassActorVisualTickProcessor when the entity changes visual LOD.
+	void SetMassVisualTickInterval(float TickInterval);
+
+	FORCEINLINE bool IsMassDriven() const { return EntityHandle.IsValid(); }
+
 protected:
+	// Movement comes from Mass: an entity is created from MassEntityConfig at spawn, the actor and all components but
+	// the skeletal mesh stop ticking and the movement component is put to sleep. Without a config the character ticks as usual.
+	UPROPERTY(EditDefaultsOnly, Category = "Mass")
+	bool bMassDriven = true;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Mass")
+	UMassEntityConfigAsset* MassEntityConfig = nullptr;
+
+	FMassEntityHandle EntityHandle;
+	FDelegateHandle EntitiesRemappedHandle;
+
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
-public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	void OnEntitiesRemapped(const FMassEntityRemap& EntityRemap);
 
+public:	
 	// Called to bind functionality to input
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "MassEntityTypes.h"
+#include "Compaction/MortonCompactionSubsystem.h"
 #include "GameFramework/Pawn.h"
 #include "MassPawn.generated.h"
 
@@ -40,13 +41,15 @@ public:
 
 protected:
 	FMassEntityHandle EntityHandle;
+	FDelegateHandle EntitiesRemappedHandle;
 	
 	virtual void BeginPlay() override;
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
-	virtual void Tick(float DeltaSeconds) override;
 	virtual void SetupPlayerInputComponent(UInputComponent* PlayerInputComponent) override;
 
 	void OnMove(const FInputActionValue& Value);
 	void OnLook(const FInputActionValue& Value);
 	void OnJump();
+
+	void OnEntitiesRemapped(const FMassEntityRemap& EntityRemap);
 };
\ No newline at end of file
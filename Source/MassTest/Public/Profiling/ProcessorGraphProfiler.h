@@ -0,0 +1,111 @@
+
+#pragma once
+
+#include "MassProcessor.h"
+#include "Engine/World.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ProcessorGraphProfiler.generated.h"
+
+// One processor execution recorded during a capture. Times are in seconds since the capture began.
+struct FMassProcessorSpan
+{
+	FName Processor;
+	uint32 ThreadId;
+	int32 Frame;
+	double Start;
+	double End;
+	bool bGameThread;
+};
+
+/**
+ * Captures the resolved processor dependency graph along with per-frame execution spans, then computes the critical path,
+ * how long each processor waited once its dependencies finished and how many processors it could overlap with.
+ * Started with MassTest.ProcessorGraph.Capture [NumFrames], the report is written to Saved/Profiling/MassProcessorGraph.
+ * Only processors using MASSTEST_PROCESSOR_SPAN are timed, the others appear in the graph with no cost.
+ */
+UCLASS()
+class MASSTEST_API UProcessorGraphProfilerSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	//~ Begin UWorldSubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	//~ End UWorldSubsystem interface
+
+	// Game thread only.
+	void BeginCapture(const int32 NumFrames);
+
+	FORCEINLINE bool IsCapturing() const { return RemainingFrames.load(std::memory_order_relaxed) > 0; }
+
+	// Thread safe.
+	void RecordSpan(const UMassProcessor& Processor, const double StartSeconds, const double EndSeconds);
+
+	// Checked by span scopes before looking up the subsystem, so processors pay nothing outside of captures.
+	static std::atomic<int32> NumActiveCaptures;
+
+protected:
+	struct FProcessorNode
+	{
+		FName Name;
+		FName Group;
+		TArray<FName> ExecuteBefore;
+		TArray<FName> ExecuteAfter;
+		TArray<int32> Dependencies;
+		bool bGameThread;
+	};
+
+	void OnPreActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+	void BuildGraph();
+	void EndCapture();
+	FString WriteReport() const;
+
+	TArray<FProcessorNode> Nodes;
+	TMap<FName, int32> NodeIndices;
+
+	// Indices into Nodes, dependencies first.
+	TArray<int32> TopologicalOrder;
+
+	mutable FCriticalSection SpansCriticalSection;
+	TArray<FMassProcessorSpan> Spans;
+
+	double CaptureStartSeconds = 0.0;
+	TArray<double> FrameStartSeconds;
+	int32 CurrentFrame = INDEX_NONE;
+	// Read by span scopes on worker threads.
+	std::atomic<int32> RemainingFrames{0};
+
+	FDelegateHandle PreActorTickHandle;
+	FDelegateHandle PostActorTickHandle;
+};
+
+// Records the enclosing scope as a span of Processor while a capture is running.
+struct FMassProcessorSpanScope
+{
+	FORCEINLINE explicit FMassProcessorSpanScope(const UMassProcessor& InProcessor)
+		: Processor{InProcessor}
+	{
+		if (UNLIKELY(UProcessorGraphProfilerSubsystem::NumActiveCaptures.load(std::memory_order_relaxed) > 0))
+		{
+			Profiler = Processor.GetWorld() ? Processor.GetWorld()->GetSubsystem<UProcessorGraphProfilerSubsystem>() : nullptr;
+			StartSeconds = FPlatformTime::Seconds();
+		}
+	}
+
+	FORCEINLINE ~FMassProcessorSpanScope()
+	{
+		if (UNLIKELY(Profiler) && Profiler->IsCapturing())
+		{
+			Profiler->RecordSpan(Processor, StartSeconds, FPlatformTime::Seconds());
+		}
+	}
+
+private:
+	const UMassProcessor& Processor;
+	UProcessorGraphProfilerSubsystem* Profiler = nullptr;
+	double StartSeconds = 0.0;
+};
+
+#define MASSTEST_PROCESSOR_SPAN() const FMassProcessorSpanScope ANONYMOUS_VARIABLE(ProcessorSpan){*this}
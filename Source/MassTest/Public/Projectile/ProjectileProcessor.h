@@ -0,0 +1,233 @@
+
+#pragma once
+
+#include "EntityCommon.h"
+#include "ProjectileSubsystem.h"
+#include "MassProcessor.h"
+#include "Profiling/ProcessorGraphProfiler.h"
+#include "MassCommonFragments.h"
+#include "MassCommonTypes.h"
+#include "MassEntityTemplateRegistry.h"
+#include "MassEntityTraitBase.h"
+#include "MassExecutionContext.h"
+#include "Async/ParallelFor.h"
+#include "Math/VectorRegister.h"
+#include "ProjectileProcessor.generated.h"
+
+UCLASS()
+class MASSTEST_API UProjectileTrait : public UMassEntityTraitBase
+{
+	GENERATED_BODY()
+protected:
+	virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const override;
+};
+
+inline void UProjectileTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const
+{
+	BuildContext.AddFragment<FProjectileFragment>();
+	BuildContext.AddTag<FProjectileTag>();
+}
+
+
+
+UCLASS()
+class MASSTEST_API UProjectileProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	explicit UProjectileProcessor();
+
+	static constexpr ECollisionChannel TRACE_CHANNEL = ECC_Visibility;
+	static constexpr int32 TRACES_PER_TASK = 64;
+
+protected:
+	//~ Begin UMassProcessor interface
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	//~ End UMassProcessor interface
+
+	struct FProjectileTrace
+	{
+		FVector Start;
+		FVector End;
+		FProjectileFragment* Projectile;
+		FMassEntityHandle Entity;
+		int32 ArchetypeIndex;
+		bool bExpired;
+	};
+
+	struct FProjectileTraceResult
+	{
+		FVector Location;
+		FVector3f Normal;
+		TWeakObjectPtr<UPrimitiveComponent> Component;
+		bool bHit;
+	};
+
+private:
+	FMassEntityQuery ProjectileQuery;
+
+	TArray<FProjectileTrace> Traces;
+	TArray<FProjectileTraceResult> TraceResults;
+	TArray<FMassArchetypeHandle> Archetypes;
+};
+
+inline UProjectileProcessor::UProjectileProcessor()
+{
+	bRequiresGameThreadExecution = false;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::AllNetModes;
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::Movement;
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::SyncWorldToMass);
+}
+
+inline void UProjectileProcessor::ConfigureQueries()
+{
+	ProjectileQuery.AddRequirement<FProjectileFragment>(EMassFragmentAccess::ReadWrite);
+	ProjectileQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
+	ProjectileQuery.AddTagRequirement<FProjectileTag>(EMassFragmentPresence::All);
+	ProjectileQuery.AddTagRequirement<FProjectileInactiveTag>(EMassFragmentPresence::None);
+	ProjectileQuery.RegisterWithProcessor(*this);
+}
+
+inline void UProjectileProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UProjectileProcessor::Execute"), STAT_ProjectileProcessor, STATGROUP_MassTest);
+	MASSTEST_PROCESSOR_SPAN();
+
+	UProjectileSubsystem* ProjectileSubsystem = GetWorld()->GetSubsystem<UProjectileSubsystem>();
+	if (UNLIKELY(!ProjectileSubsystem)) return;
+
+	ProjectileSubsystem->BeginFrame();
+
+	Traces.Reset();
+	Archetypes.Reset();
+
+	//~ Integrate ballistic state four projectiles at a time: each component of four fragments is loaded into one register,
+	// so a lane is a projectile. Gravity only acts on Z, averaging the old and new velocity integrates it exactly.
+	const float DeltaTime = Context.GetDeltaTimeSeconds();
+	const float GravityZ = GetWorld()->GetGravityZ();
+	const VectorRegister4Float VDeltaTime = VectorSetFloat1(DeltaTime);
+	const VectorRegister4Float VHalfDeltaTime = VectorSetFloat1(0.5f * DeltaTime);
+	const VectorRegister4Float VGravityDeltaTime = VectorSetFloat1(GravityZ * DeltaTime);
+
+	ProjectileQuery.ForEachEntityChunk(EntityManager, Context, [&](FMassExecutionContext& Context) -> void
+	{
+		const TArrayView<FProjectileFragment> Projectiles = Context.GetMutableFragmentView<FProjectileFragment>();
+		const TArrayView<FTransformFragment> Transforms = Context.GetMutableFragmentView<FTransformFragment>();
+		const int32 ArchetypeIndex = Archetypes.AddUnique(Context.GetEntityCollection().GetArchetype());
+		const int32 NumEntities = Context.GetNumEntities();
+		const int32 FirstTrace = Traces.AddUninitialized(NumEntities);
+
+		for (int32 i = 0; i < NumEntities; ++i)
+		{
+			FProjectileTrace& Trace = Traces[FirstTrace + i];
+			Trace.Start = Projectiles[i].Location;
+			Trace.Projectile = &Projectiles[i];
+			Trace.Entity = Context.GetEntity(i);
+			Trace.ArchetypeIndex = ArchetypeIndex;
+		}
+
+		int32 i = 0;
+		for (; i + 4 <= NumEntities; i += 4)
+		{
+			FProjectileFragment* P = &Projectiles[i];
+
+			const VectorRegister4Float VelocityX = MakeVectorRegisterFloat(P[0].Velocity.X, P[1].Velocity.X, P[2].Velocity.X, P[3].Velocity.X);
+			const VectorRegister4Float VelocityY = MakeVectorRegisterFloat(P[0].Velocity.Y, P[1].Velocity.Y, P[2].Velocity.Y, P[3].Velocity.Y);
+			const VectorRegister4Float VelocityZ = MakeVectorRegisterFloat(P[0].Velocity.Z, P[1].Velocity.Z, P[2].Velocity.Z, P[3].Velocity.Z);
+			const VectorRegister4Float GravityScale = MakeVectorRegisterFloat(P[0].GravityScale, P[1].GravityScale, P[2].GravityScale, P[3].GravityScale);
+			const VectorRegister4Float Lifetime = MakeVectorRegisterFloat(P[0].RemainingLifetime, P[1].RemainingLifetime, P[2].RemainingLifetime, P[3].RemainingLifetime);
+
+			const VectorRegister4Float NewVelocityZ = VectorMultiplyAdd(GravityScale, VGravityDeltaTime, VelocityZ);
+			const VectorRegister4Double NewLocationX = VectorAdd(MakeVectorRegisterDouble(P[0].Location.X, P[1].Location.X, P[2].Location.X, P[3].Location.X),
+				VectorRegister4Double{VectorMultiply(VelocityX, VDeltaTime)});
+			const VectorRegister4Double NewLocationY = VectorAdd(MakeVectorRegisterDouble(P[0].Location.Y, P[1].Location.Y, P[2].Location.Y, P[3].Location.Y),
+				VectorRegister4Double{VectorMultiply(VelocityY, VDeltaTime)});
+			const VectorRegister4Double NewLocationZ = VectorAdd(MakeVectorRegisterDouble(P[0].Location.Z, P[1].Location.Z, P[2].Location.Z, P[3].Location.Z),
+				VectorRegister4Double{VectorMultiply(VectorAdd(VelocityZ, NewVelocityZ), VHalfDeltaTime)});
+
+			alignas(32) double OutLocationX[4], OutLocationY[4], OutLocationZ[4];
+			alignas(16) float OutVelocityZ[4], OutLifetime[4];
+			VectorStoreAligned(NewLocationX, OutLocationX);
+			VectorStoreAligned(NewLocationY, OutLocationY);
+			VectorStoreAligned(NewLocationZ, OutLocationZ);
+			VectorStoreAligned(NewVelocityZ, OutVelocityZ);
+			VectorStoreAligned(VectorSubtract(Lifetime, VDeltaTime), OutLifetime);
+
+			for (int32 Lane = 0; Lane < 4; ++Lane)
+			{
+				P[Lane].Location = FVector(OutLocationX[Lane], OutLocationY[Lane], OutLocationZ[Lane]);
+				P[Lane].Velocity.Z = OutVelocityZ[Lane];
+				P[Lane].RemainingLifetime = OutLifetime[Lane];
+			}
+		}
+		for (; i < NumEntities; ++i)
+		{
+			FProjectileFragment& Projectile = Projectiles[i];
+			const float NewVelocityZ = Projectile.Velocity.Z + Projectile.GravityScale * GravityZ * DeltaTime;
+			Projectile.Location += FVector(Projectile.Velocity.X * DeltaTime, Projectile.Velocity.Y * DeltaTime,
+				(Projectile.Velocity.Z + NewVelocityZ) * 0.5f * DeltaTime);
+			Projectile.Velocity.Z = NewVelocityZ;
+			Projectile.RemainingLifetime -= DeltaTime;
+		}
+
+		for (int32 j = 0; j < NumEntities; ++j)
+		{
+			FProjectileTrace& Trace = Traces[FirstTrace + j];
+			Trace.End = Projectiles[j].Location;
+			Trace.bExpired = Projectiles[j].RemainingLifetime <= 0.f;
+
+			if (!Transforms.IsEmpty())
+			{
+				Transforms[j].GetMutableTransform().SetLocation(Projectiles[j].Location);
+			}
+		}
+	});
+	//~
+
+	//~ Trace every segment in parallel batches. Each result slot is written by exactly one task.
+	TraceResults.SetNumUninitialized(Traces.Num());
+	ParallelFor(FMath::DivideAndRoundUp(Traces.Num(), TRACES_PER_TASK), [this](const int32 Batch) -> void
+	{
+		const UWorld* World = GetWorld();
+		const FCollisionQueryParams QueryParams{SCENE_QUERY_STAT(ProjectileTrace), false};
+
+		const int32 End = FMath::Min((Batch + 1) * TRACES_PER_TASK, Traces.Num());
+		for (int32 i = Batch * TRACES_PER_TASK; i < End; ++i)
+		{
+			FHitResult Hit;
+			FProjectileTraceResult& Result = TraceResults[i];
+			Result.bHit = World->LineTraceSingleByChannel(Hit, Traces[i].Start, Traces[i].End, TRACE_CHANNEL, QueryParams);
+			if (Result.bHit)
+			{
+				Result.Location = Hit.ImpactPoint;
+				Result.Normal = (FVector3f)Hit.ImpactNormal;
+				Result.Component = Hit.GetComponent();
+			}
+		}
+	});
+	//~
+
+	//~ Emit hit events and recycle hit or expired projectiles.
+	TArray<FProjectileHitEvent>& HitEvents = ProjectileSubsystem->GetWriteHitEvents();
+	for (int32 i = 0; i < Traces.Num(); ++i)
+	{
+		const FProjectileTrace& Trace = Traces[i];
+		const FProjectileTraceResult& Result = TraceResults[i];
+
+		if (Result.bHit)
+		{
+			Trace.Projectile->Location = Result.Location;
+			HitEvents.Add(FProjectileHitEvent{Trace.Entity, Result.Location, Result.Normal, Trace.Projectile->Velocity, Result.Component});
+		}
+
+		if (Result.bHit || Trace.bExpired)
+		{
+			Context.Defer().AddTag<FProjectileInactiveTag>(Trace.Entity);
+			ProjectileSubsystem->ReleaseToPool(Archetypes[Trace.ArchetypeIndex], Trace.Entity);
+		}
+	}
+
+	ProjectileSubsystem->EndFrame();
+	//~
+}
@@ -0,0 +1,79 @@
+
+#pragma once
+
+#include "MassEntityTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ProjectileSubsystem.generated.h"
+
+class UMassEntityConfigAsset;
+
+USTRUCT()
+struct MASSTEST_API FProjectileFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	FVector Location = FVector::ZeroVector;
+	FVector3f Velocity = FVector3f::ZeroVector;
+	float GravityScale = 1.f;
+	float RemainingLifetime = 0.f;
+};
+
+USTRUCT()
+struct MASSTEST_API FProjectileTag : public FMassTag
+{
+	GENERATED_BODY()
+};
+
+// Projectile hit something or expired and waits in UProjectileSubsystem's pool to be respawned.
+USTRUCT()
+struct MASSTEST_API FProjectileInactiveTag : public FMassTag
+{
+	GENERATED_BODY()
+};
+
+struct FProjectileSpawnParams
+{
+	FVector Location = FVector::ZeroVector;
+	FVector3f Velocity = FVector3f::ZeroVector;
+	float GravityScale = 1.f;
+	float Lifetime = 5.f;
+};
+
+struct FProjectileHitEvent
+{
+	FMassEntityHandle Projectile;
+	FVector Location = FVector::ZeroVector;
+	FVector3f Normal = FVector3f::ZeroVector;
+	FVector3f Velocity = FVector3f::ZeroVector;
+	TWeakObjectPtr<UPrimitiveComponent> Component;
+};
+
+UCLASS()
+class MASSTEST_API UProjectileSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	// Spawns projectiles from Config, reusing pooled entities of the same archetype before creating new ones. Game thread only, outside of Mass processing.
+	void SpawnProjectiles(const UMassEntityConfigAsset& Config, TConstArrayView<FProjectileSpawnParams> Params);
+
+	// Hits reported by the last UProjectileProcessor run. Stable until it runs again.
+	FORCEINLINE TConstArrayView<FProjectileHitEvent> GetHitEvents() const { return HitEvents[ReadIndex]; }
+
+	//~ Begin UProjectileProcessor interface
+	// Clears the event buffer being written and makes entities released last frame (whose tag change has been flushed since) available for reuse.
+	void BeginFrame();
+	FORCEINLINE TArray<FProjectileHitEvent>& GetWriteHitEvents() { return HitEvents[ReadIndex ^ 1]; }
+	// Publishes the hits written this run to GetHitEvents.
+	FORCEINLINE void EndFrame() { ReadIndex ^= 1; }
+	void ReleaseToPool(const FMassArchetypeHandle& Archetype, const FMassEntityHandle Entity);
+	//~ End UProjectileProcessor interface
+
+protected:
+	TArray<FProjectileHitEvent> HitEvents[2];
+	uint8 ReadIndex = 0;
+
+	// Keyed by the archetype of the active projectile, which is what a config's template creates.
+	TMap<FMassArchetypeHandle, TArray<FMassEntityHandle>> Pool;
+	TArray<TPair<FMassArchetypeHandle, FMassEntityHandle>> PendingRelease;
+	FCriticalSection PoolCriticalSection;
+};
@@ -0,0 +1,116 @@
+
+#pragma once
+
+#include "EntityCommon.h"
+#include "MassCharacter.h"
+#include "MassActorTableSubsystem.h"
+#include "MassProcessor.h"
+#include "Profiling/ProcessorGraphProfiler.h"
+#include "MassCommonFragments.h"
+#include "MassCommonTypes.h"
+#include "MassExecutionContext.h"
+#include "Camera/PlayerCameraManager.h"
+#include "GameFramework/PlayerController.h"
+#include "ActorVisualTickProcessor.generated.h"
+
+static TAutoConsoleVariable<float> CVarMassTestVisualTickLODScale{
+	TEXT("MassTest.VisualTickLODScale"),
+	1.f,
+	TEXT("Scales the viewer distances at which Mass-driven actor visuals drop to lower tick rates.")};
+
+UCLASS()
+class MASSTEST_API UMassActorVisualTickProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	explicit UMassActorVisualTickProcessor();
+
+	//~ Tick interval per LOD. Entities further than the last distance use the last interval.
+	static constexpr int32 NUM_LODS = 4;
+	static constexpr float LOD_DISTANCES[NUM_LODS - 1] = {1500.f, 4000.f, 10000.f};
+	static constexpr float LOD_TICK_INTERVALS[NUM_LODS] = {0.f, 1.f / 30.f, 1.f / 10.f, 1.f / 2.f};
+	//~
+
+protected:
+	//~ Begin UMassProcessor interface
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	//~ End UMassProcessor interface
+
+private:
+	FMassEntityQuery CharacterQuery;
+
+	TArray<AActor*> ResolvedActors;
+};
+
+inline UMassActorVisualTickProcessor::UMassActorVisualTickProcessor()
+{
+	bRequiresGameThreadExecution = true;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::Standalone | (int32)EProcessorExecutionFlags::Client;
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::UpdateWorldFromMass;
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::Movement);
+}
+
+inline void UMassActorVisualTickProcessor::ConfigureQueries()
+{
+	CharacterQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	CharacterQuery.AddRequirement<FActorHandleFragment>(EMassFragmentAccess::ReadOnly);
+	CharacterQuery.AddRequirement<FVisualTickLODFragment>(EMassFragmentAccess::ReadWrite);
+	CharacterQuery.RegisterWithProcessor(*this);
+}
+
+inline void UMassActorVisualTickProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UMassActorVisualTickProcessor::Execute"), STAT_MassActorVisualTick, STATGROUP_MassTest);
+	MASSTEST_PROCESSOR_SPAN();
+
+	const UMassActorTableSubsystem* ActorTable = GetWorld()->GetSubsystem<UMassActorTableSubsystem>();
+	if (UNLIKELY(!ActorTable)) return;
+
+	TArray<FVector, TInlineAllocator<4>> ViewerLocations;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APlayerController* PlayerController = It->Get(); PlayerController && PlayerController->PlayerCameraManager)
+		{
+			ViewerLocations.Add(PlayerController->PlayerCameraManager->GetCameraLocation());
+		}
+	}
+
+	float LODDistancesSq[NUM_LODS - 1];
+	const float LODScale = CVarMassTestVisualTickLODScale.GetValueOnGameThread();
+	for (int32 LOD = 0; LOD < NUM_LODS - 1; ++LOD)
+	{
+		LODDistancesSq[LOD] = FMath::Square(LOD_DISTANCES[LOD] * LODScale);
+	}
+
+	CharacterQuery.ForEachEntityChunk(EntityManager, Context, [&](FMassExecutionContext& Context) -> void
+	{
+		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
+		const TArrayView<FVisualTickLODFragment> TickLODs = Context.GetMutableFragmentView<FVisualTickLODFragment>();
+		ActorTable->ResolveBatch(Context.GetFragmentView<FActorHandleFragment>(), ResolvedActors);
+
+		for (int32 i = 0; i < Context.GetNumEntities(); ++i)
+		{
+			//~ Pick the tick interval from the closest viewer. No viewer means the lowest LOD.
+			double ClosestViewerDistanceSq = TNumericLimits<double>::Max();
+			for (const FVector& ViewerLocation : ViewerLocations)
+			{
+				ClosestViewerDistanceSq = FMath::Min(ClosestViewerDistanceSq, FVector::DistSquared(ViewerLocation, Transforms[i].GetTransform().GetLocation()));
+			}
+
+			int32 LOD = 0;
+			while (LOD < NUM_LODS - 1 && ClosestViewerDistanceSq > LODDistancesSq[LOD]) ++LOD;
+
+			if (TickLODs[i].LOD == LOD) continue;
+			//~
+
+			AMassCharacter* Character = Cast<AMassCharacter>(ResolvedActors[i]);
+			if (Character && Character->IsMassDriven())
+			{
+				Character->SetMassVisualTickInterval(LOD_TICK_INTERVALS[LOD]);
+			}
+
+			TickLODs[i].LOD = LOD;
+		}
+	});
+}
@@ -0,0 +1,40 @@
+
+#pragma once
+
+#include "EntityCommon.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MassActorTableSubsystem.generated.h"
+
+/**
+ * Owns the actors referenced by Mass entities. Fragments store a compact FMassActorHandle instead of a UObject pointer,
+ * so garbage collection walks this one array instead of every chunk holding an actor reference.
+ * Slots are recycled, the generation invalidates handles to a released slot. A destroyed actor resolves to null.
+ */
+UCLASS()
+class MASSTEST_API UMassActorTableSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	// Game thread only.
+	FMassActorHandle RegisterActor(AActor* Actor);
+	void UnregisterActor(const FMassActorHandle Handle);
+
+	// Safe to call from any thread while no actor is being registered or unregistered, i.e. during Mass processing.
+	FORCEINLINE AActor* Resolve(const FMassActorHandle Handle) const
+	{
+		return Generations.IsValidIndex(Handle.Index) && Generations[Handle.Index] == Handle.Generation ? Actors[Handle.Index].Get() : nullptr;
+	}
+
+	template<typename T>
+	FORCEINLINE T* Resolve(const FMassActorHandle Handle) const { return Cast<T>(Resolve(Handle)); }
+
+	// Resolves a whole chunk of handles at once. OutActors is resized to match, stale handles resolve to null.
+	void ResolveBatch(const TConstArrayView<FActorHandleFragment> Handles, TArray<AActor*>& OutActors) const;
+
+protected:
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AActor>> Actors;
+
+	TArray<uint32> Generations;
+	TArray<uint32> FreeIndices;
+};
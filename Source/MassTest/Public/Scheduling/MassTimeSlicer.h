@@ -0,0 +1,102 @@
+
+#pragma once
+
+#include "EntityCommon.h"
+#include "MassEntityQuery.h"
+
+/**
+ * Spreads a processor's chunks over several frames when they don't fit in its per frame budget.
+ * Chunks are visited in rounds: a chunk whose first entity was processed since the current round started waits for the next one, so every entity is reached eventually.
+ * Progress lives in the entities rather than in a chunk position, so it survives chunks being added, removed or reordered by streaming and compaction.
+ * Entities keep the slicer time they were last processed at in FTimeSlicedFragment and integrate everything since then once reached again.
+ * Frames that ran out of budget before covering every chunk are counted as misses, see MassTest.TimeSlicing.Report.
+ */
+class MASSTEST_API FMassTimeSlicer
+{
+public:
+	// Catch up delta time is clamped to this, an entity starved for longer loses the rest.
+	static constexpr float MAX_DELTA_TIME = 0.25f;
+
+	explicit FMassTimeSlicer(const TCHAR* InName);
+	~FMassTimeSlicer();
+	UE_NONCOPYABLE(FMassTimeSlicer);
+
+	// Runs Function over the chunks of Query until BudgetSeconds ran out, at least one chunk per call. A budget of zero or less processes every chunk.
+	// Query has to require FTimeSlicedFragment, and Function to stamp every entity through ConsumeDeltaTime. Chunks without the fragment can't catch up and run every call.
+	template <typename FunctionType>
+	void ForEachChunk(FMassEntityQuery& Query, FMassEntityManager& EntityManager, FMassExecutionContext& Context, const double BudgetSeconds, FunctionType&& Function);
+
+	// Time elapsed since the entity was last processed, FrameDeltaTime for entities processed for the first time or without a budget. Stamps the entity as processed now.
+	FORCEINLINE float ConsumeDeltaTime(FTimeSlicedFragment& TimeSliced, const float FrameDeltaTime) const
+	{
+		// Every chunk runs every frame without a budget, so there is nothing to catch up and no reason to clamp hitches.
+		const float DeltaTime = !bBudgeted || TimeSliced.LastProcessedTime < 0.0 ? FrameDeltaTime : (float)FMath::Min(Time - TimeSliced.LastProcessedTime, (double)MAX_DELTA_TIME);
+		TimeSliced.LastProcessedTime = Time;
+		return DeltaTime;
+	}
+
+	// Logs the budget misses of every slicer that ran so far.
+	static void LogReport();
+
+private:
+	const TCHAR* Name;
+
+	// Sum of the delta times of every ForEachChunk call, the clock FTimeSlicedFragment is stamped with.
+	double Time = 0.0;
+
+	// Slicer time the current round started at. Chunks stamped since are done for this round.
+	double RoundStartTime = 0.0;
+
+	// Whether the last ForEachChunk call had a budget.
+	bool bBudgeted = false;
+
+	//~ Budget statistics.
+	int64 NumFrames = 0;
+	int64 NumMissedFrames = 0;
+	int32 MaxSkippedChunks = 0;
+	//~
+};
+
+template <typename FunctionType>
+void FMassTimeSlicer::ForEachChunk(FMassEntityQuery& Query, FMassEntityManager& EntityManager, FMassExecutionContext& Context, const double BudgetSeconds, FunctionType&& Function)
+{
+	Time += Context.GetDeltaTimeSeconds();
+	++NumFrames;
+
+	bBudgeted = BudgetSeconds > 0.0;
+	const double EndTime = FPlatformTime::Seconds() + BudgetSeconds;
+	bool bOutOfBudget = false;
+	int32 NumSlicedChunks = 0;
+	int32 NumProcessedChunks = 0;
+
+	// The first pass finishes the current round. If that leaves budget, a new round starts and the second pass goes over the chunks
+	// the first one found done, the ones it just processed are stamped with the new round's start time.
+	for (int32 Pass = 0; Pass < 2 && !bOutOfBudget; ++Pass)
+	{
+		Query.ForEachEntityChunk(EntityManager, Context, [&](FMassExecutionContext& Context) -> void
+		{
+			const TConstArrayView<FTimeSlicedFragment> TimeSliced = Context.GetFragmentView<FTimeSlicedFragment>();
+			if (TimeSliced.IsEmpty())
+			{
+				if (Pass == 0) Function(Context);
+				return;
+			}
+
+			NumSlicedChunks += Pass == 0;
+			if (bOutOfBudget || TimeSliced[0].LastProcessedTime >= RoundStartTime) return;
+
+			Function(Context);
+			++NumProcessedChunks;
+			bOutOfBudget = bBudgeted && FPlatformTime::Seconds() >= EndTime;
+		});
+
+		if (!bOutOfBudget) RoundStartTime = Time;
+	}
+
+	const int32 NumSkippedChunks = NumSlicedChunks - NumProcessedChunks;
+	if (NumSkippedChunks > 0)
+	{
+		++NumMissedFrames;
+		MaxSkippedChunks = FMath::Max(MaxSkippedChunks, NumSkippedChunks);
+	}
+}
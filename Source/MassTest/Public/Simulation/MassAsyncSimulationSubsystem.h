@@ -0,0 +1,66 @@
+
+#pragma once
+
+#include "MassProcessingTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tasks/Task.h"
+#include "MassAsyncSimulationSubsystem.generated.h"
+
+class UMassProcessor;
+struct FMassCommandBuffer;
+
+/**
+ * Optional fixed rate character movement simulation, enabled with MassTest.AsyncSimulation.
+ * The movement processors are taken out of the Mass phases and stepped on a worker task launched at the end of the world tick
+ * and joined when the next world tick starts, so a heavy crowd step overlaps with rendering instead of stalling the frame.
+ * The step sweeps the world, so it is also joined before garbage collection and before a level is removed from the world.
+ * Each step publishes the previous and current transform of every entity, which the game thread interpolates when updating actors.
+ * Anything touching Mass entities outside of the Mass phases has to call WaitForSimulation first, or go through deferred commands.
+ */
+UCLASS()
+class MASSTEST_API UMassAsyncSimulationSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	// Steps past this are dropped, the simulation falls behind real time rather than spiralling.
+	static constexpr int32 MAX_STEPS_PER_FRAME = 4;
+
+	//~ Begin UWorldSubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	//~ End UWorldSubsystem interface
+
+	FORCEINLINE bool IsEnabled() const { return bEnabled; }
+
+	// Blend weight from the previous to the current snapshot for the time accumulated since the last step. Game thread only.
+	FORCEINLINE float GetInterpolationAlpha() const { return InterpolationAlpha; }
+
+	// Blocks until the in flight step finished and applies the commands it deferred. Game thread only.
+	void WaitForSimulation();
+
+	// While enabled, movement processors only run from the simulation step and skip their Mass phase execution.
+	static bool ShouldExecuteMovement(const UMassProcessor& Processor);
+
+protected:
+	void OnTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void OnTickEnd(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void OnPreGarbageCollect();
+	void OnPreLevelRemoved(ULevel* Level, UWorld* World);
+
+	UPROPERTY(Transient)
+	FMassRuntimePipeline SimulationPipeline;
+
+	TSharedPtr<FMassCommandBuffer> SimulationCommands;
+	UE::Tasks::FTask SimulationTask;
+
+	float FixedDeltaTime = 1.f / 60.f;
+	float Accumulator = 0.f;
+	float InterpolationAlpha = 1.f;
+	bool bEnabled = false;
+
+	FDelegateHandle TickStartHandle;
+	FDelegateHandle TickEndHandle;
+	FDelegateHandle PreGarbageCollectHandle;
+	FDelegateHandle PreLevelRemovedHandle;
+};
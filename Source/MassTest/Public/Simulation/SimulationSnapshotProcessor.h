@@ -0,0 +1,63 @@
+
+#pragma once
+
+#include "EntityCommon.h"
+#include "CharacterMovement/CharacterMovementProcessor.h"
+#include "MassProcessor.h"
+#include "Profiling/ProcessorGraphProfiler.h"
+#include "MassCommonFragments.h"
+#include "MassCommonTypes.h"
+#include "MassExecutionContext.h"
+#include "SimulationSnapshotProcessor.generated.h"
+
+// Publishes the transform of each simulated entity at the end of an async simulation step. Only run by UMassAsyncSimulationSubsystem.
+UCLASS()
+class MASSTEST_API USimulationSnapshotProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	explicit USimulationSnapshotProcessor();
+
+protected:
+	//~ Begin UMassProcessor interface
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	//~ End UMassProcessor interface
+
+private:
+	FMassEntityQuery SnapshotQuery;
+};
+
+inline USimulationSnapshotProcessor::USimulationSnapshotProcessor()
+{
+	bAutoRegisterWithProcessingPhases = false;
+	bRequiresGameThreadExecution = false;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::AllNetModes;
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::Movement;
+	ExecutionOrder.ExecuteAfter.Add(UCharacterMovementProcessor::StaticClass()->GetFName());
+}
+
+inline void USimulationSnapshotProcessor::ConfigureQueries()
+{
+	SnapshotQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	SnapshotQuery.AddRequirement<FSimulationSnapshotFragment>(EMassFragmentAccess::ReadWrite);
+	SnapshotQuery.RegisterWithProcessor(*this);
+}
+
+inline void USimulationSnapshotProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("USimulationSnapshotProcessor::Execute"), STAT_SimulationSnapshotProcessor, STATGROUP_MassTest);
+	MASSTEST_PROCESSOR_SPAN();
+
+	SnapshotQuery.ForEachEntityChunk(EntityManager, Context, [](FMassExecutionContext& Context) -> void
+	{
+		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
+		const TArrayView<FSimulationSnapshotFragment> Snapshots = Context.GetMutableFragmentView<FSimulationSnapshotFragment>();
+
+		for (int32 i = 0; i < Context.GetNumEntities(); ++i)
+		{
+			Snapshots[i].Previous = Snapshots[i].Current;
+			Snapshots[i].Current = Transforms[i].GetTransform();
+		}
+	});
+}
@@ -0,0 +1,87 @@
+
+#pragma once
+
+#include "CellStreamingSubsystem.h"
+#include "EntityCommon.h"
+#include "MassProcessor.h"
+#include "Profiling/ProcessorGraphProfiler.h"
+#include "MassCommonFragments.h"
+#include "MassCommonTypes.h"
+#include "MassEntityTemplateRegistry.h"
+#include "MassEntityTraitBase.h"
+#include "MassExecutionContext.h"
+#include "CellStreamingProcessor.generated.h"
+
+// Lets UCellStreamingSubsystem stream the entity out when its cell leaves the active area.
+UCLASS()
+class MASSTEST_API UCellStreamingTrait : public UMassEntityTraitBase
+{
+	GENERATED_BODY()
+protected:
+	virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const override;
+};
+
+inline void UCellStreamingTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const
+{
+	BuildContext.RequireFragment<FTransformFragment>();
+	BuildContext.AddFragment_GetRef<FCellStreamingFragment>().TemplateID = BuildContext.GetTemplateID();
+}
+
+
+
+// Buckets streamed entities by cell once they moved, for UCellStreamingSubsystem to pick whole cells from between frames.
+UCLASS()
+class MASSTEST_API UCellStreamingProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	explicit UCellStreamingProcessor();
+
+protected:
+	//~ Begin UMassProcessor interface
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	//~ End UMassProcessor interface
+
+private:
+	FMassEntityQuery StreamingQuery;
+};
+
+inline UCellStreamingProcessor::UCellStreamingProcessor()
+{
+	bRequiresGameThreadExecution = false;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::AllNetModes;
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::UpdateWorldFromMass;
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::Movement);
+}
+
+inline void UCellStreamingProcessor::ConfigureQueries()
+{
+	StreamingQuery.AddRequirement<FCellStreamingFragment>(EMassFragmentAccess::ReadWrite);
+	StreamingQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	StreamingQuery.RegisterWithProcessor(*this);
+}
+
+inline void UCellStreamingProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("UCellStreamingProcessor::Execute"), STAT_CellStreamingProcessor, STATGROUP_MassTest);
+	MASSTEST_PROCESSOR_SPAN();
+
+	UCellStreamingSubsystem* Streaming = GetWorld()->GetSubsystem<UCellStreamingSubsystem>();
+	if (UNLIKELY(!Streaming)) return;
+
+	Streaming->ResetLoadedCells();
+
+	StreamingQuery.ForEachEntityChunk(EntityManager, Context, [Streaming](FMassExecutionContext& Context) -> void
+	{
+		const TArrayView<FCellStreamingFragment> StreamingFragments = Context.GetMutableFragmentView<FCellStreamingFragment>();
+		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
+
+		for (int32 i = 0; i < Context.GetNumEntities(); ++i)
+		{
+			FIntPoint& Cell = StreamingFragments[i].Cell;
+			Cell = Streaming->GetCell(Transforms[i].GetTransform().GetLocation());
+			Streaming->AddToCell(Cell, Context.GetEntity(i));
+		}
+	});
+}
@@ -0,0 +1,85 @@
+
+#pragma once
+
+#include "MassEntityTemplate.h"
+#include "MassEntityTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CellStreamingSubsystem.generated.h"
+
+// Entity streamed with the world grid by UCellStreamingSubsystem. Added by UCellStreamingTrait.
+USTRUCT()
+struct MASSTEST_API FCellStreamingFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	// Cell the entity was in after the last UCellStreamingProcessor run.
+	FIntPoint Cell = FIntPoint::NoneValue;
+
+	// Template the entity was created from, whose shared fragment values it gets back when streamed in.
+	FMassEntityTemplateID TemplateID;
+};
+
+// Fragments of entities of one archetype, in column per fragment type like an archetype chunk.
+struct FStreamedEntityBlock
+{
+	FMassArchetypeHandle Archetype;
+	FMassEntityTemplateID TemplateID;
+
+	TArray<const UScriptStruct*> FragmentTypes;
+	TArray<int32> ColumnOffsets;
+	int32 NumEntities = 0;
+
+	TArray<uint8, TAlignedHeapAllocator<16>> Data;
+
+	FORCEINLINE uint8* GetElement(const int32 Column, const int32 Index) { return Data.GetData() + ColumnOffsets[Column] + Index * FragmentTypes[Column]->GetStructureSize(); }
+};
+
+/**
+ * Streams entities carrying FCellStreamingFragment in and out with the world grid around the player view points.
+ * Entities of a cell leaving MassTest.Streaming.LoadRadius are copied into compact per archetype blocks and destroyed,
+ * and batch created back into their archetype when the cell comes back in range, so memory follows the active area rather than the whole map.
+ * Cells are processed one at a time on the game thread between frames, as many as fit in MassTest.Streaming.BudgetMs.
+ * Entities owning anything outside of their fragments (actors, mirror slots...) are never streamed out, it wouldn't be released or restored.
+ * Nothing streams while lockstep is enabled, view points aren't lockstep inputs.
+ */
+UCLASS()
+class MASSTEST_API UCellStreamingSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	//~ Begin UWorldSubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	//~ End UWorldSubsystem interface
+
+	FORCEINLINE FIntPoint GetCell(const FVector& Location) const { return FIntPoint{FMath::FloorToInt32(Location.X / CellSize), FMath::FloorToInt32(Location.Y / CellSize)}; }
+
+	FORCEINLINE int32 GetNumStreamedOutEntities() const { return NumStreamedOutEntities; }
+	FORCEINLINE int64 GetStreamedOutBytes() const { return StreamedOutBytes; }
+
+	//~ Begin UCellStreamingProcessor interface
+	void ResetLoadedCells();
+	FORCEINLINE void AddToCell(const FIntPoint& Cell, const FMassEntityHandle Entity) { LoadedCells.FindOrAdd(Cell).Add(Entity); }
+	//~ End UCellStreamingProcessor interface
+
+protected:
+	void OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+	bool IsInRange(const FIntPoint& Cell, TConstArrayView<FVector> Sources, const double Radius) const;
+
+	void StreamOut(const FIntPoint& Cell, TConstArrayView<FMassEntityHandle> Entities);
+	void StreamIn(const FIntPoint& Cell);
+	static void DestroyBlock(FStreamedEntityBlock& Block);
+
+	// Live entities per cell, rebuilt by UCellStreamingProcessor every frame.
+	TMap<FIntPoint, TArray<FMassEntityHandle>> LoadedCells;
+
+	// Serialized entities of cells out of range.
+	TMap<FIntPoint, TArray<FStreamedEntityBlock>> UnloadedCells;
+
+	float CellSize = 5000.f;
+	int32 NumStreamedOutEntities = 0;
+	int64 StreamedOutBytes = 0;
+
+	FDelegateHandle PostActorTickHandle;
+};
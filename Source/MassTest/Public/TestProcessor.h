@@ -2,6 +2,7 @@
 
 #include "EntityCommon.h"
 #include "MassProcessor.h"
+#include "Profiling/ProcessorGraphProfiler.h"
 #include "MassCommonFragments.h"
 #include "MassCommonTypes.h"
 #include "MassEntitySubsystem.h"
@@ -44,6 +45,7 @@ inline void UTestProcessor::ConfigureQueries()
 inline void UTestProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
 {
 	DECLARE_SCOPE_CYCLE_COUNTER(TEXT("TestProcessor"), STAT_TestProcessor, STATGROUP_MassTest);
+	MASSTEST_PROCESSOR_SPAN();
 
 #if 0
 	Query.ForEachEntityChunk(EntityManager, Context, [](FMassExecutionContext& Context) -> void
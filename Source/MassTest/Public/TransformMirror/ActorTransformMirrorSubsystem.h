@@ -0,0 +1,54 @@
+
+#pragma once
+
+#include "Subsystems/WorldSubsystem.h"
+#include "ActorTransformMirrorSubsystem.generated.h"
+
+// One side of the mirror. Transforms are only meaningful for slots flagged dirty.
+struct FActorTransformMirrorBuffer
+{
+	TArray<FTransform> Transforms;
+	TBitArray<> Dirty;
+};
+
+/**
+ * Contiguous copy of registered actor transforms, so Mass can sync world transforms without touching UObjects.
+ * The game thread fills the back buffer at the end of each frame, flagging only actors that moved outside of Mass, then swaps.
+ * The front buffer is immutable until the next swap and can be read from any thread during Mass processing.
+ * Slots registered since the last swap aren't in it yet, readers have to check the slot is a valid index.
+ */
+UCLASS()
+class MASSTEST_API UActorTransformMirrorSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	//~ Begin UWorldSubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	//~ End UWorldSubsystem interface
+
+	// Game thread only.
+	int32 RegisterActor(AActor* Actor);
+	void UnregisterActor(const int32 Slot);
+
+	// Records the transform Mass just pushed to the slot's actor, so it isn't mirrored back as an outside move. Game thread only.
+	FORCEINLINE void NotifyWrittenByMass(const int32 Slot, const FTransform& Transform) { MassWrittenTransforms[Slot] = Transform; }
+
+	FORCEINLINE const FActorTransformMirrorBuffer& GetFrontBuffer() const { return Buffers[FrontIndex]; }
+
+protected:
+	void OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+	TArray<TWeakObjectPtr<AActor>> Actors;
+	TArray<FTransform> MassWrittenTransforms;
+	TArray<int32> FreeSlots;
+	// Registered since the last swap, seeded into the back buffer at the end of the frame.
+	TArray<int32> PendingSlots;
+	// Unregistered since the last swap, free once the front buffer no longer flags them.
+	TArray<int32> ReleasedSlots;
+
+	FActorTransformMirrorBuffer Buffers[2];
+	uint8 FrontIndex = 0;
+
+	FDelegateHandle PostActorTickHandle;
+};